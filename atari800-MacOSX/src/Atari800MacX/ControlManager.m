@@ -169,11 +169,38 @@ void ControlManagerMiniturize() {
     [[KeyMapper sharedInstance] releaseCmdKeys:@"m"];
 }
 
+/* Messages logged by the core thread, held for the main thread */
+static NSMutableData *pendingMessages = nil;
+
 void ControlManagerMessagePrint(char *string)
 {
+    if (![NSThread isMainThread]) {
+        @synchronized([ControlManager class]) {
+            if (pendingMessages == nil)
+                pendingMessages = [[NSMutableData alloc] init];
+            [pendingMessages appendBytes:string length:strlen(string)];
+        }
+        return;
+    }
 [[ControlManager sharedInstance] messagePrint:string];
 }
 
+/* Prints the messages held for the main thread, called on it */
+void ControlManagerMessageFlush(void)
+{
+    NSMutableData *messages;
+
+    @synchronized([ControlManager class]) {
+        messages = pendingMessages;
+        pendingMessages = nil;
+    }
+    if (messages == nil)
+        return;
+    [messages appendBytes:"" length:1];
+    [[ControlManager sharedInstance] messagePrint:(char *)[messages bytes]];
+    [messages release];
+}
+
 void ControlManagerMonitorPrintf(const char *format,...)
 {
 	static char string[512];
@@ -1711,7 +1738,7 @@ static int monitorRunFirstTime = 1;
 	p = find_user_label(label);
 	if (p != NULL) {
 		if (p->addr != addr) {
-			p->addr = addr;
+			set_user_label_addr(p, addr);
 		}
 	}
 	else
@@ -776,6 +776,7 @@ NSImage *disketteImage;
     if (Atari800_machine_type != Atari800_MACHINE_5200) {
         CARTRIDGE_Insert_BASIC();
         memset(Screen_atari, 0, (Screen_HEIGHT * Screen_WIDTH));
+        Screen_EntireDirty();
         Atari_DisplayScreen((UBYTE *) Screen_atari);
         Atari800_Coldstart();
         [self updateInfo];
@@ -792,6 +793,7 @@ NSImage *disketteImage;
     if (Atari800_machine_type == Atari800_MACHINE_XLXE) {
         CARTRIDGE_Insert_SIDE2();
         memset(Screen_atari, 0, (Screen_HEIGHT * Screen_WIDTH));
+        Screen_EntireDirty();
         Atari_DisplayScreen((UBYTE *) Screen_atari);
         Atari800_Coldstart();
         [self updateInfo];
@@ -826,6 +828,7 @@ NSImage *disketteImage;
         }
 
         memset(Screen_atari, 0, (Screen_HEIGHT * Screen_WIDTH));
+        Screen_EntireDirty();
         Atari_DisplayScreen((UBYTE *) Screen_atari);
         Atari800_Coldstart();
         }
@@ -882,6 +885,7 @@ NSImage *disketteImage;
             }
         }
 		memset(Screen_atari, 0, (Screen_HEIGHT * Screen_WIDTH));
+		Screen_EntireDirty();
 		Atari_DisplayScreen((UBYTE *) Screen_atari);
         Atari800_Coldstart();
         }
@@ -892,6 +896,7 @@ NSImage *disketteImage;
 {
     CARTRIDGE_Insert_Blank(type);
     memset(Screen_atari, 0, (Screen_HEIGHT * Screen_WIDTH));
+    Screen_EntireDirty();
     Atari_DisplayScreen((UBYTE *) Screen_atari);
     Atari800_Coldstart();
     [self updateInfo];
@@ -1337,6 +1342,7 @@ NSImage *disketteImage;
     else
         MEMORY_mosaic_num_banks = PREFS_mosaic_num_banks;
 	memset(Screen_atari, 0, (Screen_HEIGHT * Screen_WIDTH));
+	Screen_EntireDirty();
 	Atari_DisplayScreen((UBYTE *) Screen_atari);
     Atari800_InitialiseMachine();
     requestCaptionChange = 1;
@@ -3461,6 +3467,7 @@ NSImage *disketteImage;
         loaded = SIDE2_Change_Rom(cfilename, TRUE);
         if (loaded) {
             memset(Screen_atari, 0, (Screen_HEIGHT * Screen_WIDTH));
+            Screen_EntireDirty();
             Atari_DisplayScreen((UBYTE *) Screen_atari);
             Atari800_Coldstart();
         }
@@ -3480,6 +3487,7 @@ NSImage *disketteImage;
         loaded = ULTIMATE_Change_Rom(cfilename, TRUE);
         if (loaded) {
             memset(Screen_atari, 0, (Screen_HEIGHT * Screen_WIDTH));
+            Screen_EntireDirty();
             Atari_DisplayScreen((UBYTE *) Screen_atari);
             Atari800_Coldstart();
         }
@@ -3528,6 +3536,7 @@ NSImage *disketteImage;
     }
     SIDE2_SDX_Switch_Change(changeToValue);
     memset(Screen_atari, 0, (Screen_HEIGHT * Screen_WIDTH));
+    Screen_EntireDirty();
     Atari_DisplayScreen((UBYTE *) Screen_atari);
     Atari800_Coldstart();
     [self updateInfo];
@@ -295,6 +295,10 @@
 #define SaveCurrentMedia @"SaveCurrentMedia"
 #define ClearCurrentMedia @"ClearCurrentMedia"
 #define KeyjoyEnable @"KeyjoyEnable"
+#define RunAheadFrames @"RunAheadFrames"
+#define IdleSkip @"IdleSkip"
+#define ThreadedCore @"ThreadedCore"
+#define SoundRateControl @"SoundRateControl"
 #define UseAtariCursorKeys @"UseAtariCursorKeys"
 #define EscapeCopy @"EscapeCopy"
 #define StartupPasteEnable @"StartupPasteEnable"
@@ -592,6 +592,10 @@ static NSDictionary *defaultValues() {
                 [NSNumber numberWithBool:NO], SaveCurrentMedia,
                 [NSNumber numberWithBool:YES], ClearCurrentMedia,
                 [NSNumber numberWithBool:YES], KeyjoyEnable,
+                [NSNumber numberWithInt:0], RunAheadFrames,
+                [NSNumber numberWithBool:NO], IdleSkip,
+                [NSNumber numberWithBool:NO], ThreadedCore,
+                [NSNumber numberWithBool:NO], SoundRateControl,
                 [NSNumber numberWithBool:YES],
                     EscapeCopy,
                 [NSNumber numberWithBool:NO], StartupPasteEnable,
@@ -4054,6 +4058,10 @@ static Preferences *sharedInstance = nil;
   prefs->exeFileEnabled = [[curValues objectForKey:ExeFileEnabled] intValue];
   prefs->cassFileEnabled = [[curValues objectForKey:CassFileEnabled] intValue];
   prefs->keyjoyEnable = [[curValues objectForKey:KeyjoyEnable] intValue];
+  prefs->runAheadFrames = [[curValues objectForKey:RunAheadFrames] intValue];
+  prefs->idleSkip = [[curValues objectForKey:IdleSkip] intValue];
+  prefs->threadedCore = [[curValues objectForKey:ThreadedCore] intValue];
+  prefs->soundRateControl = [[curValues objectForKey:SoundRateControl] intValue];
   prefs->joystickMode[0] = [[curValues objectForKey:Joystick1Mode] intValue];
   prefs->joystickMode[1] = [[curValues objectForKey:Joystick2Mode] intValue];
   prefs->joystickMode[2] = [[curValues objectForKey:Joystick3Mode] intValue];
@@ -5550,6 +5558,10 @@ static Preferences *sharedInstance = nil;
     getBoolDefault(ExeFileEnabled);
     getBoolDefault(CassFileEnabled);
     getBoolDefault(KeyjoyEnable);
+    getIntDefault(RunAheadFrames);
+    getBoolDefault(IdleSkip);
+    getBoolDefault(ThreadedCore);
+    getBoolDefault(SoundRateControl);
     getBoolDefault(EscapeCopy);
     getBoolDefault(StartupPasteEnable);
     getStringDefault(StartupPasteString);
@@ -5863,6 +5875,10 @@ static Preferences *sharedInstance = nil;
     setBoolDefault(ExeFileEnabled);
     setBoolDefault(CassFileEnabled);
     setBoolDefault(KeyjoyEnable);
+    setIntDefault(RunAheadFrames);
+    setBoolDefault(IdleSkip);
+    setBoolDefault(ThreadedCore);
+    setBoolDefault(SoundRateControl);
     setBoolDefault(EscapeCopy);
     setBoolDefault(StartupPasteEnable);
     setStringDefault(StartupPasteString);
@@ -6161,6 +6177,10 @@ static Preferences *sharedInstance = nil;
     setConfig(ExeFileEnabled);
     setConfig(CassFileEnabled);
     setConfig(KeyjoyEnable);
+    setConfig(RunAheadFrames);
+    setConfig(IdleSkip);
+    setConfig(ThreadedCore);
+    setConfig(SoundRateControl);
     setConfig(EscapeCopy);
     setConfig(StartupPasteEnable);
     setConfig(StartupPasteString);
@@ -6557,6 +6577,10 @@ static Preferences *sharedInstance = nil;
     getConfig(ExeFileEnabled);
     getConfig(CassFileEnabled);
     getConfig(KeyjoyEnable);
+    getConfig(RunAheadFrames);
+    getConfig(IdleSkip);
+    getConfig(ThreadedCore);
+    getConfig(SoundRateControl);
     getConfig(EscapeCopy);
     getConfig(StartupPasteEnable);
     getConfig(StartupPasteString);
@@ -14,10 +14,38 @@
 extern int currPrinter;
 extern char atari_print_dir[FILENAME_MAX];
 
+// Characters printed by the core thread, held for the main thread
+static NSMutableData *pendingChars = nil;
+
 // 'C' routine that emulator core can call
 void PrintOutputControllerPrintChar(char character) {
+    if (![NSThread isMainThread]) {
+        @synchronized([PrintOutputController class]) {
+            if (pendingChars == nil)
+                pendingChars = [[NSMutableData alloc] init];
+            [pendingChars appendBytes:&character length:1];
+        }
+        return;
+    }
     [[PrintOutputController sharedInstance] printChar:character];
 }
+// Prints the characters held for the main thread, called on it
+void PrintOutputControllerFlush(void) {
+    NSData *chars;
+    const char *bytes;
+    NSUInteger i;
+
+    @synchronized([PrintOutputController class]) {
+        chars = pendingChars;
+        pendingChars = nil;
+    }
+    if (chars == nil)
+        return;
+    bytes = [chars bytes];
+    for (i = 0; i < [chars length]; i++)
+        [[PrintOutputController sharedInstance] printChar:bytes[i]];
+    [chars release];
+}
 void PrintOutputControllerSelectPrinter(int printer) {
     [[PrintOutputController sharedInstance] selectPrinter:printer];
 }
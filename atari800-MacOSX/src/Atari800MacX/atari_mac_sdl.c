@@ -39,6 +39,7 @@
 #include <IOKit/IOCFPlugIn.h>
 #include <IOKit/usb/IOUSBLib.h>
 #include <mach/mach.h>
+#include <math.h>
 #include <sys/time.h>
 
 
@@ -63,14 +64,18 @@
 #include "cpu.h"
 #include "memory.h"
 #include "pia.h"
+#include "pokey.h"
 #include "sndsave.h"
 #include "statesav.h"
+#include "rewind.h"
+#include "movie.h"
 #include "log.h"
 #include "cartridge.h"
 #include "sio.h"
 #include "mac_rdevice.h"
 #include "scalebit.h"
 #include "cassette.h"
+#include "binload.h"
 #include "xep80.h"
 #include "pbi_bb.h"
 #include "pbi_mio.h"
@@ -80,6 +85,8 @@
 #include "side2.h"
 #include "util.h"
 #include "capslock.h"
+#include "atari_ntsc.h"
+#include "ntsc_filter.h"
 #ifdef NETSIO
 #include "netsio.h"
 #endif
@@ -157,6 +164,120 @@ int speed_limit = 1;
 double emulationSpeed = 1.0;
 int pauseEmulator = 0;
 int currentFps;
+/* Frames emulated ahead of the real one, only the last of them is shown,
+   to hide the input latency of the game */
+int runahead_frames = 0;
+/* Set by -runahead, which then wins over the RunAheadFrames preference */
+int runahead_frames_arg = FALSE;
+#define RUNAHEAD_MAX_FRAMES 4
+static UBYTE *runahead_state = NULL;
+static ULONG runahead_state_capacity = 0;
+/* ESC_calls when run-ahead was last checked */
+static ULONG runahead_esc_calls = 0;
+/* Time spent in each stage of the main loop.  Cmd-Y shows the average and
+   the peak of each over the screen, Cmd-Shift-Y (or -frametimes <file>)
+   writes them to a CSV file, one line per frame. */
+enum {
+    STAGE_INPUT,
+    STAGE_ANTIC,
+    STAGE_POKEY,
+    STAGE_SOUND,
+    STAGE_SYNC,
+    STAGE_DISPLAY,
+    STAGE_PREFS,
+    STAGE_OTHER,
+    STAGE_TOTAL,
+    STAGE_COUNT
+};
+static const char * const stageNames[STAGE_COUNT] = {
+    "input", "antic", "pokey", "sound", "sync", "display", "prefs", "other", "total"
+};
+static const UBYTE stageColours[STAGE_COUNT] = {
+    0x1c, 0x86, 0x36, 0xc6, 0x08, 0x7a, 0xea, 0x04, 0x0f
+};
+/* Frames averaged for the overlay */
+#define FRAME_TIMES_WINDOW 30
+int showFrameTimes = FALSE;
+static char frameTimesFilename[FILENAME_MAX] = "frametimes.csv";
+static FILE *frameTimesFile = NULL;
+static Uint64 stageTicks[STAGE_COUNT];
+static Uint64 stageStart = 0;
+static Uint64 frameStart = 0;
+static Uint64 windowTicks[STAGE_COUNT];
+static Uint64 windowPeak[STAGE_COUNT];
+static int windowFrames = 0;
+static int frameTimesAverage[STAGE_COUNT];
+static int frameTimesPeak[STAGE_COUNT];
+static unsigned long frameTimesFrame = 0;
+static uint64_t frameTimesIdleCycles = 0;
+/* With -threaded, or the ThreadedCore preference, the emulation runs on a
+   thread of its own and the main thread only handles the events and shows
+   the frames, at the refresh rate of the display.  Finished frames go through a triple buffer and the
+   input of each frame through a queue, so neither side waits for the
+   other.  The menus, the preferences and the media windows still reach
+   into the emulator from Cocoa, so the main thread takes the core lock
+   while it handles the events, and the core lets go of it between frames
+   and while it sleeps. */
+int threadedCore = FALSE;
+static SDL_Thread *coreThread = NULL;
+static SDL_threadID coreThreadID;
+static SDL_mutex *coreMutex = NULL;
+static int mainLockDepth = 0;
+static SDL_atomic_t coreQuit;
+static SDL_atomic_t coreDone;       /* CoreThread has returned */
+static SDL_atomic_t mainWaiting;    /* main thread waits for the core lock */
+static SDL_atomic_t coreFrames;     /* frames emulated, for CountFPS */
+static SDL_atomic_t switch80ColPending;
+/* PLATFORM_Exit called by the core, run by the main thread */
+static SDL_atomic_t coreCallPending;
+static SDL_sem *coreCallDone = NULL;
+static int coreCallArg;
+static int coreCallResult;
+/* Input of one frame, as GatherInput left it */
+typedef struct {
+    int keycode;
+    int key_shift;
+    int key_consol;
+    int control;
+    UBYTE stick[4];
+    UBYTE trig[4];
+} InputSnapshot;
+#define INPUT_QUEUE_SIZE 16
+static InputSnapshot inputQueue[INPUT_QUEUE_SIZE];
+static SDL_atomic_t inputHead;      /* moved by the main thread only */
+static SDL_atomic_t inputTail;      /* moved by the core only */
+static InputSnapshot inputPushed;
+static InputSnapshot inputApplied;
+/* The core fills frameBack, frameMiddle holds the newest finished frame
+   and the main thread shows frameFront */
+typedef struct {
+    UBYTE pixels[Screen_HEIGHT * Screen_WIDTH];
+    UWORD dirty_left[Screen_HEIGHT];
+    UWORD dirty_right[Screen_HEIGHT];
+} FrameSlot;
+#define FRAME_FRESH 4               /* in frameMiddle: not taken yet */
+static FrameSlot *frameSlots = NULL;
+static SDL_atomic_t frameMiddle;
+static int frameBack;
+static int frameFront;
+/* Spans of the last frame, and of those before it the main thread
+   never took, for the next frame to redraw as well */
+static UWORD pendingLeft[Screen_HEIGHT];
+static UWORD pendingRight[Screen_HEIGHT];
+/* Define to log the spread of the intervals between presented frames, and
+   the frames dropped and shown twice, with -threaded */
+/* #define FRAME_PACING_STATS */
+#ifdef FRAME_PACING_STATS
+#define FRAME_PACING_STATS_FRAMES 300
+static SDL_atomic_t pacingDropped;
+static Uint64 pacingLast = 0;
+static double pacingSum = 0.0;
+static double pacingSumSquares = 0.0;
+static double pacingWorst = 0.0;
+static int pacingIntervals = 0;
+static int pacingFrames = 0;
+static int pacingDuplicated = 0;
+#endif
 /* Define the max frame rate when "speed limit" is off.  We can't let it run totally open
    loop, as with verison 3.x, and the updated timing loops for OSX 10.4, it may run too fast,
    and cause problems with key repeat kicking in on the atari much too fast.  5X normal spped
@@ -331,6 +452,7 @@ extern void ControlManagerMiniturize(void);
 extern void ControlManagerShowHelp(void);
 extern int ControlManagerMonitorRun(void);
 extern void ControlManagerFunctionKeysWindowShow(void);
+extern void ControlManagerMessageFlush(void);
 extern int PasteManagerGetScancode(unsigned char *code);
 extern void SetSoundManagerEnable(int soundEnabled);
 extern void SetSoundManagerStereo(int soundStereo);
@@ -352,6 +474,7 @@ extern void RunPreferences(void);
 extern void UpdatePreferencesJoysticks();
 extern void PreferencesIdentifyGamepadNew();
 extern void PrintOutputControllerSelectPrinter(int printer);
+extern void PrintOutputControllerFlush(void);
 extern void Devices_H_Init(void);
 extern void PreferencesSaveDefaults(void);
 extern void loadMacPrefs(int firstTime);
@@ -370,10 +493,17 @@ extern void init_mzpokeysnd_sync(void);
 
 /* Local Routines */
 void Atari_DisplayScreen(UBYTE * screen);
+static void PublishFrame(void);
+static void LockCore(void);
+static void UnlockCore(void);
+static void StopCoreThread(void);
+static void StopNtscFilter(void);
+static void ToggleNtscFilter(void);
 void SoundSetup(void); 
 void PauseAudio(int pause);
 void CreateWindowCaption(void);
 void ProcessCopySelection(int *first_row, int *last_row, int selectAll);
+static int SelectionWillBeDrawn(int selectAll);
 void HandleScreenChange(int requested_w, int requested_h, int new_renderer, int keep);
 void HandleDisplayOptionsChange();
 void HandleLinearFilterChange();
@@ -382,6 +512,7 @@ void HandlePixelAspectChange();
 int  GetAtariScreenWidth(void);
 void CalcWindowSize(int *width, int *height);
 static void SetRenderScale(void);
+static void FrameTimesToggleFile(void);
 void SelectionNormalize(int *startX, int *startY, int *endX, int* endY);
 void SetPixelAspectRatio(void);
 
@@ -565,12 +696,44 @@ static int sndspread = 7; /* TBD MDG - Should this vary with PAL vs NTSC? */;
 static int gap_est = 0;
 /* cumulative audio difference */
 static double avg_gap;
-/* dsp_write_pos, dsp_read_pos and callbacktick are accessed in two different threads: */
-static int dsp_write_pos;
-static int dsp_read_pos;
+/* dsp_buffer is a single producer (Sound_Update) single consumer
+   (SoundCallback) ring.  Each position lies in 0..dsp_buffer_bytes-1 and is
+   only stored by its own side, so no lock is needed.  One byte is always
+   left free so that a full ring can be told from an empty one. */
+static SDL_atomic_t dsp_write_pos;
+static SDL_atomic_t dsp_read_pos;
 /* tick at which callback occured */
-static int callbacktick = 0;
+static SDL_atomic_t callbacktick;
+/* set by Sound_Update while it waits on dsp_space_sem for room */
+static SDL_atomic_t dsp_producer_waiting;
+static SDL_sem *dsp_space_sem = NULL;
+/* Sound_Update stops waiting for room after this long without a callback,
+   much longer than any callback period, as the device must have stopped */
+#define DSP_STALL_MS 200
+/* With dynamic rate control a PI controller trims the POKEY output rate by
+   up to MZPOKEYSND_MAX_RATE_ADJUST, so the buffer settles at snddelay ms
+   and the emulation speed is left alone.  Otherwise PLATFORM_AdjustSpeed
+   steps the emulation speed when the buffer drifts out of its window.
+   The SoundRateControl preference, off by default, or -sndratecontrol
+   turns it on; the options win over the preference. */
+int sound_rate_control = FALSE;
+int sound_rate_control_arg = FALSE;
+#define RATE_CONTROL_KP 0.004
+#define RATE_CONTROL_KI 0.00005
+static double rate_integral = 0.0;
+static double rate_ratio = 1.0;
+/* Define to log the buffer fill and rate correction every few seconds */
+/* #define SOUND_RATE_STATS */
+#ifdef SOUND_RATE_STATS
+#define SOUND_RATE_STATS_FRAMES 300
+static double rate_stats_fill = 0.0;
+static int rate_stats_frames = 0;
+#endif
 #endif
+/* Times the callback ran out of samples, and times Sound_Update found the
+   buffer full and had to wait */
+int sound_underruns = 0;
+int sound_overruns = 0;
 
 // video
 SDL_Surface *MainScreen = NULL;
@@ -578,11 +741,45 @@ SDL_Window *MainWindow = NULL;
 SDL_Surface *MonitorGLScreen = NULL;
 SDL_Renderer *renderer = NULL;
 SDL_Texture *texture = NULL;
-int screenSwitchEnabled = 1;
+/* Convert the Atari screen straight into an ARGB8888 texture, instead of
+   into the 16 bit MainScreen surface that is then copied to the texture.
+   The 80 column displays always go through MainScreen. */
+int directScreenOutput = TRUE;
+static int textureDirect = FALSE;   /* texture is ARGB8888 for the direct path */
+static int textureFresh = FALSE;    /* texture contents are undefined */
+/* Where DrawSelectionRectangle draws: MainScreen, or the locked texture */
+static Uint8 *selectionPixels = NULL;
+static int selectionPitch = 0;
+static int selectionDirect = FALSE;
+/* With -ntsc_emu the Atari screen goes through the atari_ntsc composite
+   filter into a 5-6-5 texture 7/4 as wide, which is stretched over the same
+   rectangle.  Cmd-Shift-9 turns it on and off.  The -ntsc_* options set the
+   picture.  The 80 column displays never use it. */
+int ntscFilter = FALSE;
+static atari_ntsc_setup_t ntscSetup;
+static atari_ntsc_t *ntscEmu = NULL;
+static SDL_Texture *ntscTexture = NULL;
+static int ntscTextureWidth = 0;
+static int ntscTextureFresh = FALSE;  /* ntscTexture contents are undefined */
+/* Define to log the average cost of drawing and uploading the screen.
+   atari800-bench -bench-display times the same conversions headless. */
+/* #define DISPLAY_UPLOAD_STATS */
+static SDL_Texture *scanlineTexture = NULL;
+static int scanlineTextureHeight = 0;
+static double scanlineTextureScale = 0.0;
+static double scanlineTextureTransparency = 0.0;
+#ifdef DISPLAY_UPLOAD_STATS
+#define DISPLAY_UPLOAD_STATS_FRAMES 300
+static Uint64 uploadTicks = 0;
+static Uint32 uploadRows = 0;
+static Uint64 uploadPixels = 0;
+static int uploadFrames = 0;
+#endif
 
 SDL_Color colors[256];          // palette
 Uint16 Palette16[256];          // 16-bit palette
 Uint32 Palette32[256];          // 32-bit palette
+static Uint32 PaletteARGB[256]; // opaque ARGB8888 palette for the direct path
 static int our_width, our_height; // The variables for storing screen width
 char windowCaption[80];
 int selectionStartX = 0;
@@ -706,6 +903,10 @@ double PLATFORM_AdjustSpeed(void)
 		avg_gap = avg_gap + alpha * (gap_est - avg_gap);
 	}
 	
+	/* the buffer is kept in place by Sound_Update instead */
+	if (sound_rate_control && sound_enabled)
+		return 1.0;
+	
 	gap_too_small = (snddelay*dsprate*bytes_per_sample)/1000;
 	gap_too_large = ((snddelay+sndspread)*dsprate*bytes_per_sample)/1000;
 	if (avg_gap < gap_too_small) {
@@ -720,13 +921,59 @@ double PLATFORM_AdjustSpeed(void)
 }
 #endif /* SYNCHRONIZED_SOUND */
 
+#ifdef SYNCHRONIZED_SOUND
+/*------------------------------------------------------------------------------
+*  UpdateRateControl - Runs one step of the PI controller that trims the
+*    POKEY output rate so the buffered audio converges on snddelay ms.
+*    Called once a frame with the estimated fill of dsp_buffer.
+*-----------------------------------------------------------------------------*/
+static void UpdateRateControl(double fill_bytes, double bytes_per_ms)
+{
+	double target = snddelay * bytes_per_ms;
+	double error;
+	
+	if (target <= 0)
+		return;
+	/* positive when the buffer runs low and more samples are wanted */
+	error = (target - fill_bytes) / target;
+	if (error > 1.0)
+		error = 1.0;
+	else if (error < -1.0)
+		error = -1.0;
+	
+	rate_integral += RATE_CONTROL_KI * error;
+	if (rate_integral > MZPOKEYSND_MAX_RATE_ADJUST)
+		rate_integral = MZPOKEYSND_MAX_RATE_ADJUST;
+	else if (rate_integral < -MZPOKEYSND_MAX_RATE_ADJUST)
+		rate_integral = -MZPOKEYSND_MAX_RATE_ADJUST;
+	
+	rate_ratio = 1.0 + RATE_CONTROL_KP * error + rate_integral;
+	MZPOKEYSND_SetRateAdjust(rate_ratio);
+	
+#ifdef SOUND_RATE_STATS
+	rate_stats_fill += fill_bytes / bytes_per_ms;
+	if (++rate_stats_frames == SOUND_RATE_STATS_FRAMES) {
+		Log_print("Sound fill %.1f ms (target %d), ratio %.5f, underruns %d, overruns %d",
+				  rate_stats_fill / rate_stats_frames, snddelay, rate_ratio,
+				  sound_underruns, sound_overruns);
+		rate_stats_fill = 0.0;
+		rate_stats_frames = 0;
+	}
+#endif
+}
+#endif /* SYNCHRONIZED_SOUND */
+
+/* number of bytes waiting in dsp_buffer for the callback */
+#define DSP_BUFFER_FILL(w, r) ((w) >= (r) ? (w) - (r) : (w) + dsp_buffer_bytes - (r))
+
 void Sound_Update(void)
 {
 #ifdef SYNCHRONIZED_SOUND
 	int bytes_written = 0;
 	int samples_written;
 	int gap;
-	int newpos;
+	int write_pos;
+	int tick;
 	int bytes_per_sample;
 	double bytes_per_ms;
 	
@@ -736,49 +983,56 @@ void Sound_Update(void)
 	bytes_per_sample = (POKEYSND_stereo_enabled ? 2 : 1)*((sound_bits == 16) ? 2:1);
 	bytes_per_ms = (bytes_per_sample)*(dsprate/1000.0);
 	bytes_written = (sound_bits == 8 ? samples_written : samples_written*2);
-	SDL_LockAudio();
+	tick = SDL_AtomicGet(&callbacktick);
+	if (tick == 0) {
+		/* Sound callback has not yet been called, so keep the
+		   initial gap and drop the samples */
+		return;
+	}
+	write_pos = SDL_AtomicGet(&dsp_write_pos);
 	/* this is the gap as of the most recent callback */
-	gap = dsp_write_pos - dsp_read_pos;
+	gap = DSP_BUFFER_FILL(write_pos, SDL_AtomicGet(&dsp_read_pos));
 	/* an estimation of the current gap, adding time since then */
-	if (callbacktick != 0) {
-		gap_est = gap - (bytes_per_ms)*(SDL_GetTicks() - callbacktick);
+	gap_est = gap - (bytes_per_ms)*(SDL_GetTicks() - tick);
+	if (sound_rate_control)
+		UpdateRateControl(gap_est, bytes_per_ms);
+	else if (rate_ratio != 1.0) {
+		/* turned off in the preferences */
+		rate_integral = 0.0;
+		rate_ratio = 1.0;
+		MZPOKEYSND_SetRateAdjust(rate_ratio);
 	}
-	/* if there isn't enough room... */
-	while (gap + bytes_written > dsp_buffer_bytes) {
-		/* then we allow the callback to run.. */
-		SDL_UnlockAudio();
-		/* and delay until it runs and allows space. */
-		SDL_Delay(1);
-		SDL_LockAudio();
-		/*printf("sound buffer overflow:%d %d\n",gap, dsp_buffer_bytes);*/
-		gap = dsp_write_pos - dsp_read_pos;
+	/* if there isn't enough room, wait for the callback to make some */
+	if (gap + bytes_written >= dsp_buffer_bytes) {
+		sound_overruns++;
+		do {
+			SDL_AtomicSet(&dsp_producer_waiting, 1);
+			gap = DSP_BUFFER_FILL(write_pos, SDL_AtomicGet(&dsp_read_pos));
+			if (gap + bytes_written < dsp_buffer_bytes)
+				break;
+			/* an audio device that has stopped never makes room, so then
+			   drop the samples of this frame instead of waiting forever */
+			if (SDL_SemWaitTimeout(dsp_space_sem, 10) == SDL_MUTEX_TIMEDOUT &&
+			    SDL_GetTicks() - (Uint32) SDL_AtomicGet(&callbacktick) > DSP_STALL_MS) {
+				SDL_AtomicSet(&dsp_producer_waiting, 0);
+				return;
+			}
+			gap = DSP_BUFFER_FILL(write_pos, SDL_AtomicGet(&dsp_read_pos));
+		} while (gap + bytes_written >= dsp_buffer_bytes);
+		SDL_AtomicSet(&dsp_producer_waiting, 0);
 	}
-	/* now we copy the data into the buffer and adjust the positions */
-	newpos = dsp_write_pos + bytes_written;
-	if (newpos/dsp_buffer_bytes == dsp_write_pos/dsp_buffer_bytes) {
+	/* now we copy the data into the buffer and publish the new position */
+	if (write_pos + bytes_written <= dsp_buffer_bytes) {
 		/* no wrap */
-		memcpy(dsp_buffer+(dsp_write_pos%dsp_buffer_bytes), MZPOKEYSND_process_buffer, bytes_written);
+		memcpy(dsp_buffer+write_pos, MZPOKEYSND_process_buffer, bytes_written);
 	}
 	else {
 		/* wraps */
-		int first_part_size = dsp_buffer_bytes - (dsp_write_pos%dsp_buffer_bytes);
-		memcpy(dsp_buffer+(dsp_write_pos%dsp_buffer_bytes), MZPOKEYSND_process_buffer, first_part_size);
+		int first_part_size = dsp_buffer_bytes - write_pos;
+		memcpy(dsp_buffer+write_pos, MZPOKEYSND_process_buffer, first_part_size);
 		memcpy(dsp_buffer, MZPOKEYSND_process_buffer+first_part_size, bytes_written-first_part_size);
 	}
-	dsp_write_pos = newpos;
-	if (callbacktick == 0) {
-		/* Sound callback has not yet been called */
-		dsp_read_pos += bytes_written;
-	}
-	if (dsp_write_pos < dsp_read_pos) {
-		/* should not occur */
-		Log_print("Error: dsp_write_pos < dsp_read_pos\n");
-	}
-	while (dsp_read_pos > dsp_buffer_bytes) {
-		dsp_write_pos -= dsp_buffer_bytes;
-		dsp_read_pos -= dsp_buffer_bytes;
-	}
-	SDL_UnlockAudio();
+	SDL_AtomicSet(&dsp_write_pos, (write_pos + bytes_written) % dsp_buffer_bytes);
 #else /* SYNCHRONIZED_SOUND */
 	/* fake function */
 #endif /* SYNCHRONIZED_SOUND */
@@ -828,7 +1082,11 @@ void CalcPalette()
                 Palette32[i] = c; // Opaque
                 break;
             }
+        PaletteARGB[i] = 0xFF000000 | (colors[i].r << 16) |
+                         (colors[i].g << 8) | colors[i].b;
         }
+    /* Every pixel has to be converted again */
+    Screen_EntireDirty();
 }
 
 Uint32 power_of_two(Uint32 input)
@@ -839,6 +1097,70 @@ Uint32 power_of_two(Uint32 input)
       return value;
     }
 
+/*------------------------------------------------------------------------------
+*  DestroyScreenTextures - Releases the textures kept across frames.  Must be
+*    called before the renderer that owns them is destroyed.
+*-----------------------------------------------------------------------------*/
+static void DestroyScreenTextures(void)
+{
+    if (texture) {
+        SDL_DestroyTexture(texture);
+        texture = NULL;
+        }
+    textureDirect = FALSE;
+    if (ntscTexture) {
+        SDL_DestroyTexture(ntscTexture);
+        ntscTexture = NULL;
+        }
+    if (scanlineTexture) {
+        SDL_DestroyTexture(scanlineTexture);
+        scanlineTexture = NULL;
+        }
+}
+
+/*------------------------------------------------------------------------------
+*  UpdateScanlineTexture - Builds the scanline mask drawn over the screen in
+*    SCANLINE_SCALE mode.  The mask is one pixel wide, with a darkened row
+*    after every scaled Atari line, and is stretched across the screen with a
+*    single copy.  It is rebuilt only when the scale, the transparency or the
+*    surface height changes.  Returns FALSE if no mask could be made.
+*-----------------------------------------------------------------------------*/
+static int UpdateScanlineTexture(void)
+{
+    Uint32 *mask;
+    Uint32 shade;
+    int height, rows;
+
+    height = (int) (MainScreen->h*scaleFactorFloat + scaleFactorFloat) + 1;
+    if (scanlineTexture &&
+        scanlineTextureHeight == height &&
+        scanlineTextureScale == scaleFactorFloat &&
+        scanlineTextureTransparency == scanlineTransparency)
+        return TRUE;
+
+    if (scanlineTexture)
+        SDL_DestroyTexture(scanlineTexture);
+    scanlineTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
+                                        SDL_TEXTUREACCESS_STATIC, 1, height);
+    if (scanlineTexture == NULL)
+        return FALSE;
+    SDL_SetTextureBlendMode(scanlineTexture, SDL_BLENDMODE_BLEND);
+
+    /* Black, with the alpha in the low byte of RGBA8888 */
+    shade = (Uint32) ((1.0 - scanlineTransparency) * 255) & 0xFF;
+    mask = (Uint32 *) Util_malloc(height * sizeof(Uint32));
+    memset(mask, 0, height * sizeof(Uint32));
+    for (rows = 0; rows < MainScreen->h; rows++)
+        mask[(int) (rows*scaleFactorFloat + scaleFactorFloat)] = shade;
+    SDL_UpdateTexture(scanlineTexture, NULL, mask, sizeof(Uint32));
+    free(mask);
+
+    scanlineTextureHeight = height;
+    scanlineTextureScale = scaleFactorFloat;
+    scanlineTextureTransparency = scanlineTransparency;
+    return TRUE;
+}
+
 /*------------------------------------------------------------------------------
 *  InitializeWindow - Call to set new video mode, using SDL functions.
 *-----------------------------------------------------------------------------*/
@@ -850,6 +1172,7 @@ void InitializeWindow(int w, int h)
     Atari800OriginSave();
 
     // Get rid of old renderer
+    DestroyScreenTextures();
     if (renderer)
         SDL_DestroyRenderer(renderer);
     
@@ -924,9 +1247,8 @@ void InitializeVideo()
     else
         SDL_SetRelativeMouseMode(SDL_FALSE);
     
-    /* Clear the alternate page, so the first redraw is entire screen */
-    if (Screen_atari_b)
-        memset(Screen_atari_b, 0, (Screen_HEIGHT * Screen_WIDTH));
+    /* The first redraw is entire screen */
+    Screen_EntireDirty();
 }
 
 int GetAtariScreenWidth(void)
@@ -1021,7 +1343,11 @@ static void Switch80Col(void)
 void PLATFORM_Switch80Col(void)
 {
     PLATFORM_80col = 1 - PLATFORM_80col;
-    Switch80Col();
+    /* The core thread leaves the window to the main thread */
+    if (coreThread != NULL && SDL_ThreadID() == coreThreadID)
+        SDL_AtomicSet(&switch80ColPending, 1);
+    else
+        Switch80Col();
 }
 
 void PLATFORM_Switch80ColMode(void)
@@ -1164,26 +1490,27 @@ static void SoundCallback(void *userdata, Uint8 *stream, int len)
 	memcpy(stream, dsp_buffer, len);
 #else
 	int gap;
-	int newpos;
+	int read_pos;
 	int underflow_amount = 0;
 #define MAX_SAMPLE_SIZE 4
 	static char last_bytes[MAX_SAMPLE_SIZE];
 	int bytes_per_sample = (POKEYSND_stereo_enabled ? 2 : 1)*((sound_bits == 16) ? 2:1);
-	gap = dsp_write_pos - dsp_read_pos;
+	read_pos = SDL_AtomicGet(&dsp_read_pos);
+	gap = DSP_BUFFER_FILL(SDL_AtomicGet(&dsp_write_pos), read_pos);
 	if (gap < len) {
 		underflow_amount = len - gap;
 		len = gap;
+		sound_underruns++;
 		/*return;*/
 	}
-	newpos = dsp_read_pos + len;
-	if (newpos/dsp_buffer_bytes == dsp_read_pos/dsp_buffer_bytes) {
+	if (read_pos + len <= dsp_buffer_bytes) {
 		/* no wrap */
-		memcpy(stream, dsp_buffer + (dsp_read_pos%dsp_buffer_bytes), len);
+		memcpy(stream, dsp_buffer + read_pos, len);
 	}
 	else {
 		/* wraps */
-		int first_part_size = dsp_buffer_bytes - (dsp_read_pos%dsp_buffer_bytes);
-		memcpy(stream,  dsp_buffer + (dsp_read_pos%dsp_buffer_bytes), first_part_size);
+		int first_part_size = dsp_buffer_bytes - read_pos;
+		memcpy(stream,  dsp_buffer + read_pos, first_part_size);
 		memcpy(stream + first_part_size, dsp_buffer, len - first_part_size);
 	}
 	/* save the last sample as we may need it to fill underflow */
@@ -1197,8 +1524,11 @@ static void SoundCallback(void *userdata, Uint8 *stream, int len)
 			memcpy(stream + len +i*bytes_per_sample, last_bytes, bytes_per_sample);
 		}
 	}
-	dsp_read_pos = newpos;
-	callbacktick = SDL_GetTicks();
+	SDL_AtomicSet(&dsp_read_pos, (read_pos + len) % dsp_buffer_bytes);
+	SDL_AtomicSet(&callbacktick, SDL_GetTicks());
+	/* wake Sound_Update if it is waiting for room */
+	if (SDL_AtomicCAS(&dsp_producer_waiting, 1, 0))
+		SDL_SemPost(dsp_space_sem);
 #endif /* SYNCHRONIZED_SOUND */
 }
 
@@ -1254,8 +1584,17 @@ void SoundSetup()
 		int dsp_buffer_samps = frag_samps*DSP_BUFFER_FRAGS +specified_delay_samps;
 		int bytes_per_sample = (POKEYSND_stereo_enabled ? 2 : 1)*((sound_bits == 16) ? 2:1);
 		dsp_buffer_bytes = desired.channels*dsp_buffer_samps*(sound_bits == 8 ? 1 : 2);
-		dsp_read_pos = 0;
-		dsp_write_pos = (specified_delay_samps+frag_samps)*bytes_per_sample;
+		SDL_AtomicSet(&dsp_read_pos, 0);
+		SDL_AtomicSet(&dsp_write_pos, (specified_delay_samps+frag_samps)*bytes_per_sample);
+		SDL_AtomicSet(&callbacktick, 0);
+		SDL_AtomicSet(&dsp_producer_waiting, 0);
+		rate_integral = 0.0;
+		rate_ratio = 1.0;
+		MZPOKEYSND_SetRateAdjust(rate_ratio);
+		if (dsp_space_sem == NULL)
+			dsp_space_sem = SDL_CreateSemaphore(0);
+		while (SDL_SemTryWait(dsp_space_sem) == 0)
+			;
 		avg_gap = 0.0;
 	}
 #else
@@ -1288,11 +1627,28 @@ void SDL_Sound_Initialise(int *argc, char *argv[])
             sound_enabled = FALSE;
         else if (strcmp(argv[i], "-dsprate") == 0)
             sscanf(argv[++i], "%d", &dsprate);
+#ifdef SYNCHRONIZED_SOUND
+        else if (strcmp(argv[i], "-snddelay") == 0)
+            sscanf(argv[++i], "%d", &snddelay);
+        else if (strcmp(argv[i], "-sndratecontrol") == 0) {
+            sound_rate_control = TRUE;
+            sound_rate_control_arg = TRUE;
+            }
+        else if (strcmp(argv[i], "-nosndratecontrol") == 0) {
+            sound_rate_control = FALSE;
+            sound_rate_control_arg = TRUE;
+            }
+#endif
         else {
             if (strcmp(argv[i], "-help") == 0) {
                 Log_print("\t-sound           Enable sound\n"
                        "\t-nosound         Disable sound\n"
                        "\t-dsprate <rate>  Set DSP rate in Hz\n"
+#ifdef SYNCHRONIZED_SOUND
+                       "\t-snddelay <ms>   Set sound latency in ms\n"
+                       "\t-sndratecontrol  Trim the sound rate to hold the latency\n"
+                       "\t-nosndratecontrol Adjust emulation speed instead\n"
+#endif
                       );
             }
             argv[j++] = argv[i];
@@ -1901,6 +2257,8 @@ int Atari_Keyboard_International(void)
                 case SDLK_9:
                     if (key_option)
                         requestScaleModeChange = 2;
+                    else if (INPUT_key_shift)
+                        ToggleNtscFilter();
                     break;
                 case SDLK_q:
                     return AKEY_EXIT;
@@ -1921,6 +2279,23 @@ int Atari_Keyboard_International(void)
                 case SDLK_c:
                     requestCopy = 1;
                     break;
+                case SDLK_y:
+                    if (INPUT_key_shift)
+                        FrameTimesToggleFile();
+                    else
+                        showFrameTimes = !showFrameTimes;
+                    break;
+                case SDLK_BACKSPACE:
+                    /* stepping back would desync a movie */
+                    if (MOVIE_Recording() || MOVIE_Playingback())
+                        break;
+                    if (INPUT_key_shift) {
+                        REWIND_enabled = !REWIND_enabled;
+                        Log_print("Rewind %s", REWIND_enabled ? "enabled" : "disabled");
+                    }
+                    else
+                        REWIND_StepBack();
+                    break;
             }
         }
         
@@ -2801,15 +3176,37 @@ void PLATFORM_Initialise(int *argc, char *argv[])
             no_joystick = 1;
             i++;
         }
+        else if (strcmp(argv[i], "-frametimes") == 0 && i + 1 < *argc) {
+            strncpy(frameTimesFilename, argv[++i], sizeof(frameTimesFilename) - 1);
+            if (frameTimesFile == NULL)
+                FrameTimesToggleFile();
+        }
+        else if (strcmp(argv[i], "-runahead") == 0 && i + 1 < *argc) {
+            sscanf(argv[++i], "%d", &runahead_frames);
+            runahead_frames_arg = TRUE;
+            if (runahead_frames < 0)
+                runahead_frames = 0;
+            else if (runahead_frames > RUNAHEAD_MAX_FRAMES)
+                runahead_frames = RUNAHEAD_MAX_FRAMES;
+        }
+        else if (strcmp(argv[i], "-threaded") == 0)
+            threadedCore = TRUE;
+        else if (strcmp(argv[i], "-ntsc_emu") == 0)
+            ntscFilter = TRUE;
        else {
             if (strcmp(argv[i], "-help") == 0) {
                 help_only = TRUE;
                 Log_print("\t-nojoystick      Disable joystick");
+                Log_print("\t-runahead <n>    Show the frame n frames ahead (0-4)");
+                Log_print("\t-frametimes <f>  Write the time of each main loop stage to a CSV file");
+                Log_print("\t-threaded        Run the emulation on a thread of its own");
+                Log_print("\t-ntsc_emu        Show the screen through the NTSC composite filter");
             }
             argv[j++] = argv[i];
         }
     }
     *argc = j;
+    ATARI_NTSC_DEFAULTS_Initialise(argc, argv, &ntscSetup);
 
     i = SDL_INIT_VIDEO | SDL_INIT_JOYSTICK | SDL_INIT_AUDIO;
     if (SDL_Init(i) != 0) {
@@ -2840,7 +3237,7 @@ void PLATFORM_Initialise(int *argc, char *argv[])
 *     built in monitor.  Right now, if monitor is called for, displays fatal
 *     error dialog box.
 *-----------------------------------------------------------------------------*/
-int PLATFORM_Exit(int run_monitor)
+static int ExitOrMonitor(int run_monitor)
 {
     int restart;
     int action;
@@ -2901,6 +3298,25 @@ int PLATFORM_Exit(int run_monitor)
 		}
 }
 
+int PLATFORM_Exit(int run_monitor)
+{
+    if (coreThread != NULL && SDL_ThreadID() == coreThreadID) {
+        /* The dialogs run on the main thread, which does this for the core
+           at the top of its next pass, while the core waits */
+        coreCallArg = run_monitor;
+        SDL_AtomicSet(&coreCallPending, 1);
+        UnlockCore();
+        SDL_SemWait(coreCallDone);
+        LockCore();
+        return coreCallResult;
+        }
+    if (!run_monitor) {
+        StopCoreThread();
+        StopNtscFilter();
+        }
+    return ExitOrMonitor(run_monitor);
+}
+
 /*------------------------------------------------------------------------------
 *  DisplayWithoutScaling16bpp - Displays the emulated atari screen, in single
 *    size mode, with 16 bits per pixel.
@@ -2934,6 +3350,35 @@ void DisplayWithoutScaling16bpp(Uint8 * screen, int jumped, int width,
         }
 }
 
+/*------------------------------------------------------------------------------
+*  DisplayWithoutScalingARGB8888 - Displays the emulated atari screen, in
+*    single size mode, straight into PIXELS (the locked texture rows from
+*    first_row on) as opaque ARGB8888.
+*-----------------------------------------------------------------------------*/
+void DisplayWithoutScalingARGB8888(Uint8 * screen, int jumped, int width,
+                                   int first_row, int last_row,
+                                   Uint8 *pixels, int pitch)
+{
+    register Uint8 *fromPtr;
+    register Uint32 *toPtr;
+    register int i,j;
+
+    screen = screen + jumped + (first_row * Screen_WIDTH);
+    i = last_row - first_row + 1;
+    while (i > 0) {
+        j = width;
+        toPtr = (Uint32 *) pixels;
+        fromPtr = screen;
+        while (j > 0) {
+            *toPtr++ = PaletteARGB[*fromPtr++];
+            j--;
+            }
+        screen += Screen_WIDTH;
+        pixels += pitch;
+        i--;
+        }
+}
+
 void DisplayAF80WithoutScaling16bpp(int first_row, int last_row, int blink)
 {
     Uint32 const black = (Uint32)Palette16[0];
@@ -3003,46 +3448,127 @@ void DisplayBit3WithoutScaling16bpp(int first_line, int last_line, int blink)
     }
 }
 
+void PLATFORM_DisplayScreen(void)
+{
+	Atari_DisplayScreen((UBYTE *) Screen_atari);
+}	
+
 /*------------------------------------------------------------------------------
-*  Display_Line_Equal - Determines if two display lines are equal.  Used as a 
-*     test to determine which parts of the screen must be redrawn.
+*  StartNtscFilter - Builds the composite filter tables and starts a helper
+*    thread per extra core, up to 4 cores in all; a screen is too small to
+*    be worth splitting further.  Returns FALSE if the filter can't be used.
 *-----------------------------------------------------------------------------*/
-int Display_Line_Equal(ULONG *line1, ULONG *line2)
+static int StartNtscFilter(void)
 {
-    int i;
-    int equal = TRUE;
-    
-    i = Screen_WIDTH/4;
-    while (i>0) {
-        if (*line1++ != *line2++) {
-            equal = FALSE;
-            break;
-            }
-        i--;
-        }
-    
-    return(equal);      
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (cores > 4)
+        cores = 4;
+    else if (cores < 1)
+        cores = 1;
+    if (!NTSC_FILTER_Initialise((int) cores - 1))
+        return FALSE;
+    ntscEmu = (atari_ntsc_t *) Util_malloc(sizeof(atari_ntsc_t));
+    atari_ntsc_init(ntscEmu, &ntscSetup);
+    NTSC_FILTER_SetKernels(ntscEmu);
+    return TRUE;
 }
 
-void PLATFORM_DisplayScreen(void)
+static void StopNtscFilter(void)
 {
-	Atari_DisplayScreen((UBYTE *) Screen_atari);
-}	
+    if (ntscEmu == NULL)
+        return;
+    NTSC_FILTER_Exit();
+    free(ntscEmu);
+    ntscEmu = NULL;
+}
 
 /*------------------------------------------------------------------------------
-*  Atari_DisplayScreen - Displays the Atari screen, redrawing only lines in the
-*    middle of the screen that have changed.
+*  ToggleNtscFilter - Switches between the NTSC filter and the plain screen.
+*    The texture that was not shown meanwhile is redrawn whole.
 *-----------------------------------------------------------------------------*/
-void Atari_DisplayScreen(UBYTE * screen)
+static void ToggleNtscFilter(void)
+{
+    ntscFilter = !ntscFilter;
+    ntscTextureFresh = TRUE;
+    textureFresh = TRUE;
+    full_display = FULL_DISPLAY_COUNT;
+}
+
+/*------------------------------------------------------------------------------
+*  DrawNtscScreen - Brings the NTSC texture up to date with the changed rows
+*    of the Atari screen.  The filter spreads each pixel over its neighbours,
+*    so the rows are always redrawn whole.
+*-----------------------------------------------------------------------------*/
+static void DrawNtscScreen(UBYTE * screen, int jumped, int width,
+                           int first_row, int last_row)
+{
+    int out_width = NTSC_FILTER_OUT_WIDTH(width);
+    SDL_Rect lockRect;
+    void *pixels;
+    int pitch;
+
+    if (ntscEmu == NULL && !StartNtscFilter()) {
+        Log_print("Starting the NTSC filter FAILED");
+        ToggleNtscFilter();
+        return;
+        }
+    if (ntscTexture != NULL && ntscTextureWidth != out_width) {
+        SDL_DestroyTexture(ntscTexture);
+        ntscTexture = NULL;
+        }
+    if (ntscTexture == NULL) {
+        ntscTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB565,
+                                        SDL_TEXTUREACCESS_STREAMING,
+                                        out_width, Screen_HEIGHT);
+        if (ntscTexture == NULL) {
+            Log_print("Creating NTSC texture FAILED: %s", SDL_GetError());
+            Log_flushlog();
+            exit(-1);
+            }
+        ntscTextureWidth = out_width;
+        ntscTextureFresh = TRUE;
+        }
+    if (ntscTextureFresh) {
+        first_row = 0;
+        last_row = Screen_HEIGHT - 1;
+        ntscTextureFresh = FALSE;
+        }
+
+    lockRect.x = 0;
+    lockRect.y = first_row;
+    lockRect.w = out_width;
+    lockRect.h = last_row - first_row + 1;
+    if (SDL_LockTexture(ntscTexture, &lockRect, &pixels, &pitch) == 0) {
+        NTSC_FILTER_Blit(screen + jumped + first_row * Screen_WIDTH, Screen_WIDTH,
+                         width, last_row - first_row + 1, (UWORD *) pixels, pitch);
+        SDL_UnlockTexture(ntscTexture);
+        }
+}
+
+/*------------------------------------------------------------------------------
+*  DrawScreen - Brings the screen texture up to date with the Atari screen,
+*    redrawing only the spans of the rows that have changed.
+*-----------------------------------------------------------------------------*/
+static void DrawScreen(UBYTE * screen, const UWORD *dirty_left,
+                       const UWORD *dirty_right)
 {
     int width, jumped;
     int first_row = 0;
     int last_row = Screen_HEIGHT - 1;
-    ULONG *line_start1, *line_start2;
+    int span_left = 0;
+    int span_right = Screen_WIDTH;
     static int xep80Frame = 0;
     static int af80Frame = 0;
     static int bit3Frame = 0;
-    SDL_Rect rect;
+    int upload_first, upload_last;
+    int direct;
+    void *pixels = NULL;
+    int pitch = 0;
+    int row;
+#ifdef DISPLAY_UPLOAD_STATS
+    Uint64 uploadStart;
+#endif
 	
     switch (WIDTH_MODE) {
         case SHORT_WIDTH_MODE:
@@ -3111,61 +3637,209 @@ void Atari_DisplayScreen(UBYTE * screen)
             }
         }
 	else if (!full_display) {
-		line_start1 = Screen_atari + (Screen_WIDTH/4 * (Screen_HEIGHT-1));
-		line_start2 = Screen_atari_b + (Screen_WIDTH/4 * (Screen_HEIGHT-1));
+		/* ANTIC keeps the span of each row that changed since last redraw */
 		last_row = Screen_HEIGHT-1;
-		while((0 < last_row) && Display_Line_Equal(line_start1, line_start2)) {
+		while((0 < last_row) &&
+		      dirty_left[last_row] >= dirty_right[last_row])
 			last_row--;
-			line_start1 -= Screen_WIDTH/4;
-			line_start2 -= Screen_WIDTH/4;
-			}
-		/* Find the first row of the screen that changed since last redraw */
-		line_start1 = Screen_atari;
-		line_start2 = Screen_atari_b;
-		while((first_row < last_row) && Display_Line_Equal(line_start1, line_start2)) {
+		while((first_row < last_row) &&
+		      dirty_left[first_row] >= dirty_right[first_row])
 			first_row++;
-			line_start1 += Screen_WIDTH/4;
-			line_start2 += Screen_WIDTH/4;
+		/* The direct path redraws the bounding box of the spans */
+		span_left = Screen_WIDTH;
+		span_right = 0;
+		for (row = first_row; row <= last_row; row++) {
+			if (dirty_left[row] >= dirty_right[row])
+				continue;
+			if (dirty_left[row] < span_left)
+				span_left = dirty_left[row];
+			if (dirty_right[row] > span_right)
+				span_right = dirty_right[row];
 			}
 		}
 	else
 		full_display--;
+    /* From Screen_atari columns to texture columns */
+    span_left = span_left > jumped ? span_left - jumped : 0;
+    span_right = span_right - jumped < width ? span_right - jumped : width;
+    /* Nothing changed, or only outside of the visible columns */
+    if (span_left >= span_right) {
+        span_left = 0;
+        span_right = width;
+        }
+
+    if (ntscFilter && !PLATFORM_80col) {
+        DrawNtscScreen(screen, jumped, width, first_row, last_row);
+        /* The selection is still made and copied, but its box not drawn */
+        selectionPixels = NULL;
+        if (INPUT_mouse_mode == INPUT_MOUSE_OFF)
+            ProcessCopySelection(&first_row, &last_row, requestSelectAll);
+        requestSelectAll = 0;
+        return;
+        }
 		
+    /* Keep one streaming texture across frames.  On the direct path the
+       changed rows are converted straight into it as ARGB8888; otherwise
+       they are drawn into MainScreen and only those rows are sent to it.
+       The format follows the path, so switching paths needs a new one,
+       and a new texture starts out undefined, so it is filled whole. */
+    direct = directScreenOutput && !PLATFORM_80col;
+    if (texture != NULL && textureDirect != direct) {
+        SDL_DestroyTexture(texture);
+        texture = NULL;
+        }
+    if (texture == NULL) {
+        texture = SDL_CreateTexture(renderer,
+                                    direct ? SDL_PIXELFORMAT_ARGB8888 :
+                                             MainScreen->format->format,
+                                    SDL_TEXTUREACCESS_STREAMING,
+                                    MainScreen->w, MainScreen->h);
+        if (texture == NULL) {
+            Log_print("Creating screen texture FAILED: %s", SDL_GetError());
+            Log_flushlog();
+            exit(-1);
+            }
+        textureDirect = direct;
+        textureFresh = TRUE;
+        }
+
+#ifdef DISPLAY_UPLOAD_STATS
+    uploadStart = SDL_GetPerformanceCounter();
+#endif
     if (PLATFORM_80col && AF80_enabled) {
         DisplayAF80WithoutScaling16bpp(first_row, last_row, af80Frame >= 30);
     } else if (PLATFORM_80col && BIT3_enabled) {
             DisplayBit3WithoutScaling16bpp(first_row, last_row, bit3Frame / 30);
+    } else if (direct) {
+        /* A selection box may be drawn anywhere, so then lock it all */
+        if (textureFresh ||
+            (INPUT_mouse_mode == INPUT_MOUSE_OFF &&
+             SelectionWillBeDrawn(requestSelectAll))) {
+            if (SDL_LockTexture(texture, NULL, &pixels, &pitch) == 0) {
+                for (row = 0; row < MainScreen->h; row++) {
+                    Uint32 *toPtr = (Uint32 *) ((Uint8 *) pixels + row * pitch);
+                    int j;
+
+                    for (j = 0; j < MainScreen->w; j++)
+                        *toPtr++ = 0xFF000000;
+                    }
+                first_row = 0;
+                last_row = Screen_HEIGHT - 1;
+                span_left = 0;
+                span_right = width;
+                DisplayWithoutScalingARGB8888(screen, jumped, width,
+                                              first_row, last_row,
+                                              (Uint8 *) pixels, pitch);
+                selectionPixels = (Uint8 *) pixels;
+                textureFresh = FALSE;
+                }
+            else
+                pixels = NULL;
+            }
+        else {
+            SDL_Rect lockRect;
+
+            lockRect.x = span_left;
+            lockRect.y = first_row;
+            lockRect.w = span_right - span_left;
+            lockRect.h = last_row - first_row + 1;
+            if (SDL_LockTexture(texture, &lockRect, &pixels, &pitch) == 0)
+                DisplayWithoutScalingARGB8888(screen, jumped + span_left,
+                                              span_right - span_left,
+                                              first_row, last_row,
+                                              (Uint8 *) pixels, pitch);
+            else
+                pixels = NULL;
+            selectionPixels = NULL;
+            }
+        selectionPitch = pitch;
+        selectionDirect = TRUE;
     } else {
         DisplayWithoutScaling16bpp(screen, jumped, width, first_row, last_row);
     }
+    if (!direct) {
+        selectionPixels = (Uint8 *) MainScreen->pixels;
+        selectionPitch = MainScreen->pitch;
+        selectionDirect = FALSE;
+        }
     
     // If not in mouse emulation or Fullscreen, check for copy selection
+    upload_first = first_row;
+    upload_last = last_row;
 	if (INPUT_mouse_mode == INPUT_MOUSE_OFF)
 		ProcessCopySelection(&first_row, &last_row, requestSelectAll);
 	requestSelectAll = 0;
+    /* The selection box may be drawn anywhere, so send the whole surface */
+    if (first_row != upload_first || last_row != upload_last) {
+        upload_first = 0;
+        upload_last = MainScreen->h - 1;
+        }
 	
-    Uint32 scaledWidth, scaledHeight;
-    int screen_height, screen_width;
+    if (direct) {
+        if (pixels != NULL)
+            SDL_UnlockTexture(texture);
+        selectionPixels = NULL;
+        }
+    else {
+        if (textureFresh) {
+            upload_first = 0;
+            upload_last = MainScreen->h - 1;
+            textureFresh = FALSE;
+            }
+        if (upload_last >= MainScreen->h)
+            upload_last = MainScreen->h - 1;
+        if (upload_first <= upload_last) {
+            SDL_Rect uploadRect;
+
+            uploadRect.x = 0;
+            uploadRect.y = upload_first;
+            uploadRect.w = MainScreen->w;
+            uploadRect.h = upload_last - upload_first + 1;
+            SDL_UpdateTexture(texture, &uploadRect,
+                              (Uint8 *) MainScreen->pixels +
+                              upload_first * MainScreen->pitch,
+                              MainScreen->pitch);
+            }
+        }
+#ifdef DISPLAY_UPLOAD_STATS
+    uploadTicks += SDL_GetPerformanceCounter() - uploadStart;
+    uploadRows += upload_last - upload_first + 1;
+    uploadPixels += (Uint64) (upload_last - upload_first + 1) *
+                    (direct ? span_right - span_left : width);
+    if (++uploadFrames == DISPLAY_UPLOAD_STATS_FRAMES) {
+        Log_print("Screen update (%s): %.1f us/frame, %.1f rows/frame, "
+                  "%.0f pixels/frame",
+                  direct ? "direct ARGB8888" : "16 bpp surface",
+                  (double) uploadTicks * 1000000.0 /
+                  SDL_GetPerformanceFrequency() / uploadFrames,
+                  (double) uploadRows / uploadFrames,
+                  (double) uploadPixels / uploadFrames);
+        uploadTicks = 0;
+        uploadRows = 0;
+        uploadPixels = 0;
+        uploadFrames = 0;
+        }
+#endif
+}
+
+/*------------------------------------------------------------------------------
+*  RenderScreen - Copies the screen texture, and the scanlines over it, to the
+*    window.
+*-----------------------------------------------------------------------------*/
+static void RenderScreen(void)
+{
+    int screen_width;
+    SDL_Rect rect;
+
     if (PLATFORM_80col) {
-        if (XEP80_enabled) {
-            screen_height = XEP80_SCRN_HEIGHT;
+        if (XEP80_enabled)
             screen_width = XEP80_SCRN_WIDTH;
-        } else if (AF80_enabled) {
-            screen_height = AF80_SCRN_HEIGHT;
+        else if (AF80_enabled)
             screen_width = AF80_SCRN_WIDTH;
-        } else {
-            screen_height = BIT3_SCRN_HEIGHT;
+        else
             screen_width = BIT3_SCRN_WIDTH;
-        }
-    } else {
-        screen_height = Screen_HEIGHT;
+    } else
         screen_width = Screen_WIDTH;
-    }
-    
-    scaledWidth = width;
-    scaledHeight = screen_height;
-    
-    texture = SDL_CreateTextureFromSurface(renderer, MainScreen);
 
     //Copying the texture on to the window using renderer and rectangle
     rect.x = screen_x_offset;
@@ -3173,55 +3847,45 @@ void Atari_DisplayScreen(UBYTE * screen)
     rect.w = MainScreen->w;
     rect.h = MainScreen->h;
     SDL_RenderClear(renderer);
-    SDL_RenderCopy(renderer, texture, NULL, &rect);
-    SDL_Texture* scanlinesTexture;
+    if (ntscFilter && !PLATFORM_80col && ntscTexture != NULL)
+        SDL_RenderCopy(renderer, ntscTexture, NULL, &rect);
+    else
+        SDL_RenderCopy(renderer, texture, NULL, &rect);
     // Add the scanlines if we are in that mode
     if (SCALE_MODE == SCANLINE_SCALE)
         {
-#if 0
-        scanlinesTexture = SDL_CreateTexture(renderer,
-            SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, MainScreen->w, MainScreen->h);
-        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
-        SDL_SetTextureBlendMode(scanlinesTexture, SDL_BLENDMODE_BLEND);
-        int alpha = (1.0 - scanlineTransparency) * 255;
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, alpha);
-        for (int i = 0; i < MainScreen->h; i += 4) {
-            SDL_RenderDrawLine(renderer, 0, i, MainScreen->w, i);
-            SDL_RenderDrawLine(renderer, 0, i+1, MainScreen->w, i+1);
-            }
-        SDL_RenderCopy(renderer, scanlinesTexture, NULL, NULL);
-#else
-        int rows = 0;
-        SDL_Rect scanlineRect;
         float oldScaleX, oldScaleY;
-        scanlinesTexture = SDL_CreateTexture(renderer,
-            SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
-            MainScreen->w, MainScreen->h);
-        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
-        SDL_SetTextureBlendMode(scanlinesTexture, SDL_BLENDMODE_BLEND);
-        int alpha = (1.0 - scanlineTransparency) * 255;
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, alpha);
-        
-        SDL_RenderGetScale(renderer, &oldScaleX, &oldScaleY);
-        SDL_RenderSetScale(renderer, scaleFactorFloat, 1);
+        SDL_Rect scanlineRect;
 
-        for (rows = 0; rows < MainScreen->h; rows ++)
-            {
+        if (UpdateScanlineTexture()) {
+            SDL_RenderGetScale(renderer, &oldScaleX, &oldScaleY);
+            SDL_RenderSetScale(renderer, scaleFactorFloat, 1);
             scanlineRect.x = 0;
+            scanlineRect.y = 0;
             scanlineRect.w = (screen_width*3)/2;
-            scanlineRect.y = rows*scaleFactorFloat+scaleFactorFloat;
-            scanlineRect.h = 1;
-            SDL_RenderFillRect(renderer, &scanlineRect);
+            scanlineRect.h = scanlineTextureHeight;
+            SDL_RenderCopy(renderer, scanlineTexture, NULL, &scanlineRect);
+            SDL_RenderSetScale(renderer, oldScaleX, oldScaleY);
             }
-        SDL_RenderCopy(renderer, scanlinesTexture, NULL, NULL);
-        SDL_RenderSetScale(renderer, oldScaleX, oldScaleY);
-#endif
         }
 
     SDL_RenderPresent(renderer);
-    SDL_DestroyTexture(texture);
-    if (SCALE_MODE == SCANLINE_SCALE)
-        SDL_DestroyTexture(scanlinesTexture);
+}
+
+/*------------------------------------------------------------------------------
+*  Atari_DisplayScreen - Displays the Atari screen.  With -threaded it only
+*    hands it to the main thread, which shows it at the next refresh.
+*-----------------------------------------------------------------------------*/
+void Atari_DisplayScreen(UBYTE * screen)
+{
+    if (coreThread != NULL) {
+        PublishFrame();
+        return;
+        }
+    DrawScreen(screen, Screen_dirty_left, Screen_dirty_right);
+    if (!PLATFORM_80col)
+        Screen_ClearDirtySpans();
+    RenderScreen();
 }
 
 // two empty functions, needed by input.c and platform.h
@@ -4323,6 +4987,7 @@ void SDL_DrawMousePointer(void)
     if ((INPUT_mouse_mode == INPUT_MOUSE_PEN || INPUT_mouse_mode == INPUT_MOUSE_GUN) && mouse_pen_show_pointer) {
         int x = mouse_x >> MOUSE_SHIFT;
         int y = mouse_y >> MOUSE_SHIFT;
+        int row;
         if (x >= 0 && x <= 167 && y >= 0 && y <= 119) {
             UWORD *ptr = & ((UWORD *) Screen_atari)[12 + x + Screen_WIDTH * y];
                         if (x >= 1) {
@@ -4345,6 +5010,10 @@ void SDL_DrawMousePointer(void)
                 if (y <= 117)
                     PLOT(0, 2);
             }
+            /* Drawn after ANTIC found the dirty spans */
+            for (row = 2 * y - 4; row <= 2 * y + 5; row++)
+                if (row >= 0 && row < Screen_HEIGHT)
+                    Screen_MarkDirtySpan(row, 2 * x + 20, 2 * x + 30);
         }
     }
 }
@@ -4353,6 +5022,94 @@ void SDL_DrawMousePointer(void)
 #define SPEEDLED_FONT_HEIGHT		7
 #define SPEEDLED_COLOR		0xAC
 
+/*------------------------------------------------------------------------------
+*  StageBegin/StageEnd - Time the stages of the main loop.
+*-----------------------------------------------------------------------------*/
+static void StageBegin(void)
+{
+    stageStart = SDL_GetPerformanceCounter();
+}
+
+static void StageEnd(int stage)
+{
+    stageTicks[stage] += SDL_GetPerformanceCounter() - stageStart;
+}
+
+/*------------------------------------------------------------------------------
+*  FrameTimesToggleFile - Starts or stops writing the stage times to the
+*    CSV file.
+*-----------------------------------------------------------------------------*/
+static void FrameTimesToggleFile(void)
+{
+    int i;
+
+    if (frameTimesFile != NULL) {
+        fclose(frameTimesFile);
+        frameTimesFile = NULL;
+        Log_print("Stopped writing frame times to %s", frameTimesFilename);
+        return;
+    }
+    frameTimesFile = fopen(frameTimesFilename, "w");
+    if (frameTimesFile == NULL) {
+        Log_print("Cannot open %s", frameTimesFilename);
+        return;
+    }
+    fprintf(frameTimesFile, "frame");
+    for (i = 0; i < STAGE_COUNT; i++)
+        fprintf(frameTimesFile, ",%s_us", stageNames[i]);
+    fprintf(frameTimesFile, ",idle_skipped_cycles\n");
+    frameTimesFrame = 0;
+    frameTimesIdleCycles = CPU_idle_skipped_cycles;
+    Log_print("Writing frame times to %s", frameTimesFilename);
+}
+
+/*------------------------------------------------------------------------------
+*  FrameTimesUpdate - Called at the end of each pass of the main loop.
+*    Writes the CSV line and updates the numbers shown in the overlay.
+*-----------------------------------------------------------------------------*/
+static void FrameTimesUpdate(void)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    double usPerTick = 1000000.0 / SDL_GetPerformanceFrequency();
+    Uint64 measured = 0;
+    int i;
+
+    if (frameStart == 0) {
+        frameStart = now;
+        memset(stageTicks, 0, sizeof(stageTicks));
+        return;
+    }
+    stageTicks[STAGE_TOTAL] = now - frameStart;
+    frameStart = now;
+    for (i = 0; i < STAGE_OTHER; i++)
+        measured += stageTicks[i];
+    stageTicks[STAGE_OTHER] = stageTicks[STAGE_TOTAL] > measured ? stageTicks[STAGE_TOTAL] - measured : 0;
+
+    if (frameTimesFile != NULL) {
+        fprintf(frameTimesFile, "%lu", frameTimesFrame++);
+        for (i = 0; i < STAGE_COUNT; i++)
+            fprintf(frameTimesFile, ",%d", (int) (stageTicks[i] * usPerTick));
+        fprintf(frameTimesFile, ",%d\n", (int) (CPU_idle_skipped_cycles - frameTimesIdleCycles));
+        frameTimesIdleCycles = CPU_idle_skipped_cycles;
+    }
+
+    for (i = 0; i < STAGE_COUNT; i++) {
+        windowTicks[i] += stageTicks[i];
+        if (stageTicks[i] > windowPeak[i])
+            windowPeak[i] = stageTicks[i];
+        stageTicks[i] = 0;
+    }
+    if (++windowFrames == FRAME_TIMES_WINDOW) {
+        for (i = 0; i < STAGE_COUNT; i++) {
+            frameTimesAverage[i] = (int) (windowTicks[i] * usPerTick / FRAME_TIMES_WINDOW);
+            frameTimesPeak[i] = (int) (windowPeak[i] * usPerTick);
+            windowTicks[i] = 0;
+            windowPeak[i] = 0;
+        }
+        windowFrames = 0;
+    }
+}
+
 /*------------------------------------------------------------------------------
 *  CountFPS - Displays the Frames per second in windowed or fullscreen mode.
 *-----------------------------------------------------------------------------*/
@@ -4390,6 +5147,7 @@ void HandleScreenChange(int requested_w, int requested_h, int new_renderer, int
            The screen clearing at the end of this function doesn't fix
            it, and I don't know why.  I think it's a Metal or libSDL
            issue */
+        DestroyScreenTextures();
         SDL_DestroyRenderer(renderer);
         SDL_SetHint(SDL_HINT_RENDER_DRIVER, "metal");
         SDL_SetHint(SDL_HINT_RENDER_VSYNC, vsyncEnabled ? "1" : "0");
@@ -4464,6 +5222,7 @@ void HandleScreenChange(int requested_w, int requested_h, int new_renderer, int
     else {
         int new_w, new_h;
         if (new_renderer) {
+            DestroyScreenTextures();
             SDL_DestroyRenderer(renderer);
             SDL_SetHint(SDL_HINT_RENDER_DRIVER, "metal");
             SDL_SetHint(SDL_HINT_RENDER_VSYNC, vsyncEnabled ? "1" : "0");
@@ -4529,11 +5288,13 @@ void HandleScreenChange(int requested_w, int requested_h, int new_renderer, int
         screen_y_offset = 0;
         }
     // Make sure the full display is shown and clear
-    memset(Screen_atari1, 0, (Screen_HEIGHT * Screen_WIDTH));
-    memset(Screen_atari2, 0, (Screen_HEIGHT * Screen_WIDTH));
+    memset(Screen_atari, 0, (Screen_HEIGHT * Screen_WIDTH));
+    Screen_EntireDirty();
     full_display = FULL_DISPLAY_COUNT;
     Atari_DisplayScreen((UBYTE *) Screen_atari);
     SDL_FillRect(MainScreen, NULL, SDL_MapRGB(MainScreen->format, 0, 0, 0));
+    // The cleared surface is sent in full with the next frame
+    DestroyScreenTextures();
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
     SDL_RenderClear(renderer);
     SDL_RenderPresent(renderer);
@@ -4621,14 +5382,12 @@ void ProcessMacMenus()
 #ifdef SYNCHRONIZED_SOUND			 
 			init_mzpokeysnd_sync();
 #endif			 
-			screenSwitchEnabled = FALSE;
 			}
          else {
             deltatime = real_deltatime;
 #ifdef SYNCHRONIZED_SOUND			 
 			 init_mzpokeysnd_sync();
 #endif			 
-			 screenSwitchEnabled = TRUE;
 			}
          speed_limit = 1 - speed_limit;
          requestLimitChange = 0;
@@ -4718,6 +5477,7 @@ void ProcessMacMenus()
             if (CARTRIDGE_main.type != CARTRIDGE_NONE)
                 CARTRIDGE_Remove();
         memset(Screen_atari, 0, (Screen_HEIGHT * Screen_WIDTH));
+        Screen_EntireDirty();
         Atari800_InitialiseMachine();
 		Atari800_Coldstart();
         CreateWindowCaption();
@@ -4937,18 +5697,20 @@ void ProcessMacPrefsChange()
                 }
             CalcPalette();
             SetPalette();
-            /* Clear the alternate page, so the first redraw is entire screen */
+            /* Clear the screen, so the first redraw is entire screen */
             if (Screen_atari)
                 memset(Screen_atari, 0, (Screen_HEIGHT * Screen_WIDTH));
+            Screen_EntireDirty();
             }
         if (machineTypeChanged || osRomsChanged)
             {
-            memset(Screen_atari_b, 0, (Screen_HEIGHT * Screen_WIDTH));
+            memset(Screen_atari, 0, (Screen_HEIGHT * Screen_WIDTH));
+            Screen_EntireDirty();
             Atari800_InitialiseMachine();
             CreateWindowCaption();
             SDL_SetWindowTitle(MainWindow, windowCaption);
             if (Atari800_machine_type == Atari800_MACHINE_5200)
-                Atari_DisplayScreen((UBYTE *) Screen_atari_b);
+                Atari_DisplayScreen((UBYTE *) Screen_atari);
             }
         if (patchFlagsChanged)
             {
@@ -5027,6 +5789,7 @@ void ProcessMacPrefsChange()
             loaded = ULTIMATE_Change_Rom(ultimate_rom_filename, FALSE);
             if (loaded) {
                 memset(Screen_atari, 0, (Screen_HEIGHT * Screen_WIDTH));
+                Screen_EntireDirty();
                 Atari_DisplayScreen((UBYTE *) Screen_atari);
                 Atari800_Coldstart();
             }
@@ -5036,6 +5799,7 @@ void ProcessMacPrefsChange()
             loaded = SIDE2_Change_Rom(side2_rom_filename, FALSE);
             if (loaded) {
                 memset(Screen_atari, 0, (Screen_HEIGHT * Screen_WIDTH));
+                Screen_EntireDirty();
                 Atari_DisplayScreen((UBYTE *) Screen_atari);
                 Atari800_Coldstart();
             }
@@ -5094,14 +5858,12 @@ void ProcessMacPrefsChange()
 #ifdef SYNCHRONIZED_SOUND			 
 		init_mzpokeysnd_sync();
 #endif			 
-		screenSwitchEnabled = FALSE;
 		}
 	else {
         deltatime = real_deltatime;
 #ifdef SYNCHRONIZED_SOUND			 
 		init_mzpokeysnd_sync();
 #endif			 
-		screenSwitchEnabled = TRUE;
 		}
 
     Atari800_UpdateKeyboardDetached();
@@ -5340,6 +6102,16 @@ void SelectionNormalize(int *startX, int *startY, int *endX, int* endY)
     }
 }
 
+static void InvertSelectionPixel(int x, int y)
+{
+    Uint8 *line = selectionPixels + y * selectionPitch;
+
+    if (selectionDirect)
+        ((Uint32 *) line)[x] ^= 0x00FFFFFF;
+    else
+        ((Uint16 *) line)[x] ^= 0xFFFF;
+}
+
 void DrawSelectionRectangle(int orig_x, int orig_y, int copy_x, int copy_y)
 {
     int i,y;
@@ -5363,12 +6135,8 @@ void DrawSelectionRectangle(int orig_x, int orig_y, int copy_x, int copy_y)
     scaleX = scaleFactorRenderX;
     scaleY = scaleFactorRenderY;
 	
-	if (SCALE_MODE==NORMAL_SCALE || SCALE_MODE == SCANLINE_SCALE) {
-		register int pitch2;
-		register Uint16 *start16;
-		
-		pitch2 = MainScreen->pitch / 2;
-
+	if ((SCALE_MODE==NORMAL_SCALE || SCALE_MODE == SCANLINE_SCALE) &&
+	    selectionPixels != NULL) {
 		orig_x = (double) orig_x/scaleX;
 		orig_y = (double) orig_y/scaleY;
 		copy_x = (double) copy_x/scaleX;
@@ -5381,31 +6149,35 @@ void DrawSelectionRectangle(int orig_x, int orig_y, int copy_x, int copy_y)
             copy_y -= screen_y_offset;
         }
         
-		start16 = (Uint16 *) MainScreen->pixels +
-		(orig_y * pitch2) + orig_x;
-		for (i=0;i<(copy_x-orig_x+1);i++,start16++)
-			*start16 ^= 0xFFFF;
+		for (i=orig_x;i<=copy_x;i++)
+			InvertSelectionPixel(i, orig_y);
 		if (copy_y > orig_y) {
-			start16 = (Uint16 *) MainScreen->pixels + 
-			(copy_y * pitch2) + orig_x;
-			for (i=0;i<(copy_x-orig_x+1);i++,start16++)
-				*start16 ^= 0xFFFF;
-		}
-		for (y=orig_y+1;y < copy_y;y++) {
-			start16 = (Uint16 *) MainScreen->pixels + 
-				(y * pitch2) + orig_x;
-			*start16 ^= 0xFFFF;
+			for (i=orig_x;i<=copy_x;i++)
+				InvertSelectionPixel(i, copy_y);
 		}
+		for (y=orig_y+1;y < copy_y;y++)
+			InvertSelectionPixel(orig_x, y);
 		if (copy_x > orig_x) {
-			for (y=orig_y+1;y < copy_y;y++) {
-				start16 = (Uint16 *) MainScreen->pixels + 
-					(y * pitch2) + copy_x;
-				*start16 ^= 0xFFFF;
-			}
+			for (y=orig_y+1;y < copy_y;y++)
+				InvertSelectionPixel(copy_x, y);
 		}
 	}
 }
 
+/*------------------------------------------------------------------------------
+*  SelectionWillBeDrawn - Tells if ProcessCopySelection is going to draw the
+*    selection box this frame, so the direct path can lock the whole texture.
+*-----------------------------------------------------------------------------*/
+static int SelectionWillBeDrawn(int selectAll)
+{
+	if (selectAll)
+		return TRUE;
+	if (!Atari800IsKeyWindow())
+		return FALSE;
+	return copyStatus != COPY_IDLE ||
+	       (SDL_GetMouseState(NULL, NULL) & SDL_BUTTON(1)) != 0;
+}
+
 void ProcessCopySelection(int *first_row, int *last_row, int selectAll)
 {
 	static int orig_x = 0;
@@ -5507,30 +6279,776 @@ int IsCopyDefined(void)
 }
 
 /*------------------------------------------------------------------------------
-* main - main function of emulator with main execution loop.
+*  RunAheadPossible - Frames run ahead are thrown away, so they must not
+*    have effects outside of the machine state.  Skip run-ahead while a
+*    disk, the tape or the network is busy, a host file is open through
+*    H: or P:, or a movie is recorded or played, and for one frame after
+*    the emulated code called the host through an escape sequence.  The
+*    devices whose state is not in the snapshot also rule it out.
 *-----------------------------------------------------------------------------*/
-int SDL_main(int argc, char **argv)
+static int RunAheadPossible(void)
 {
-    int keycode;
-    int done = 0;
+    int esc_called = ESC_calls != runahead_esc_calls;
+
+    runahead_esc_calls = ESC_calls;
+    if (runahead_frames <= 0 || SIO_last_op_time > 0 || esc_called)
+        return FALSE;
+    if (MOVIE_Recording() || MOVIE_Playingback())
+        return FALSE;
+    if (CASSETTE_readable || CASSETTE_writable)
+        return FALSE;
+    if (Devices_HostFilesOpen() || BINLOAD_bin_file != NULL || Devices_enable_r_patch)
+        return FALSE;
+    if (AF80_enabled || BIT3_enabled || ULTIMATE_enabled || SIDE2_enabled)
+        return FALSE;
+#ifdef NETSIO
+    if (netsio_enabled)
+        return FALSE;
+#endif
+    return TRUE;
+}
+
+/*------------------------------------------------------------------------------
+*  RunAhead - Called after the real frame.  Snapshots the machine, runs
+*    runahead_frames more frames with the current input so that the last
+*    one is left in the screen buffer, then goes back to the snapshot.
+*    The sound of the frames run ahead is thrown away, and their calls to
+*    the host are held, which also skips run-ahead for the next frame.
+*-----------------------------------------------------------------------------*/
+static void RunAhead(void)
+{
+    ULONG size;
+    ULONG random_counter;
+    int frames = runahead_frames > RUNAHEAD_MAX_FRAMES ? RUNAHEAD_MAX_FRAMES : runahead_frames;
     int i;
-    int retVal;
-	double last_time = 0.0;
 
-    POKEYSND_stereo_enabled = FALSE; /* Turn this off here....otherwise games only come
-                             from one channel...you only want this for demos mainly
-                             anyway */
-    SDL_version v;
-	SDL_GetVersion(&v);
-	Log_print("SDL Version: %u.%u.%u", v.major, v.minor, v.patch);
-	SDLMainActivate();
-	
-    if (!fileToLoad) {
-	  argc = prefsArgc;
-      argv = prefsArgv;
-	  }
+    size = StateSav_SaveMem(&runahead_state, &runahead_state_capacity);
+    if (size == 0)
+        return;
+    random_counter = POKEY_GetRandomCounter();
+#ifdef SYNCHRONIZED_SOUND
+    MZPOKEYSND_SaveSoundState();
+#endif
 
-    if (!Atari800_Initialise(&argc, argv))
+    ESC_hold = TRUE;
+    for (i = 1; i <= frames; i++) {
+        Devices_Frame();
+        GTIA_Frame();
+        ANTIC_Frame(i == frames || Atari800_collisions_in_skipped_frames);
+        POKEY_Frame();
+#ifdef SYNCHRONIZED_SOUND
+        if (sound_enabled && !pauseCount)
+            MZPOKEYSND_DiscardProcessBuffer();
+#endif
+    }
+    ESC_hold = FALSE;
+
+    StateSav_ReadMem(runahead_state, size);
+    POKEY_SetRandomCounter(random_counter);
+#ifdef SYNCHRONIZED_SOUND
+    MZPOKEYSND_RestoreSoundState();
+#endif
+}
+
+/*------------------------------------------------------------------------------
+*  GatherInput - Reads the joysticks, paddles, mouse and keyboard, and handles
+*    the pending events.  Returns the key code for ApplyInput.
+*-----------------------------------------------------------------------------*/
+static int GatherInput(void)
+{
+    int keycode;
+    int i;
+
+    /* Handle joysticks and paddles */
+    SDL_Atari_PORT(&STICK[0], &STICK[1], &STICK[2], &STICK[3]);
+    keycode = SDL_Atari_TRIG(&TRIG_input[0], &TRIG_input[1], &TRIG_input[2], &TRIG_input[3],
+                             &pad_key_shift, &pad_key_control, &pad_key_consol);
+    for (i=0;i<4;i++) {
+        if (JOYSTICK_MODE[i] == MOUSE_EMULATION)
+            break;
+        }
+    if ((i<4) && (INPUT_mouse_mode != INPUT_MOUSE_OFF)) { 
+		INPUT_mouse_port = i;
+        SDL_Atari_Mouse(&STICK[i],&TRIG_input[i]);
+		}
+
+    INPUT_key_consol = INPUT_CONSOL_NONE;
+    switch(keycode) {
+        case AKEY_NONE:
+            keycode = Atari_Keyboard();
+            break;
+        case AKEY_BUTTON2:
+            INPUT_key_shift = 1;
+            keycode = AKEY_NONE;
+            break;
+        case AKEY_5200_RESET:
+            if (Atari800_machine_type == Atari800_MACHINE_5200)
+                keycode = AKEY_WARMSTART;
+            break;
+        case AKEY_BUTTON_RESET:
+            if (Atari800_machine_type != Atari800_MACHINE_5200)
+                keycode = AKEY_WARMSTART;
+            break;
+        default:
+            Atari_Keyboard(); /* Get the keyboard state (for shift and control), but 
+                                  throw away the key, since the keypad key takes precedence */
+            if (INPUT_key_shift)
+                keycode |= AKEY_SHFT;
+        }
+	
+    // Merge the gamepad buttons and keyboard mod keys
+	if (pad_key_shift && !INPUT_key_shift)
+	   keycode |= AKEY_SHFT;
+    INPUT_key_shift |= pad_key_shift;
+	CONTROL |= pad_key_control;
+	INPUT_key_consol &= pad_key_consol;
+
+    return keycode;
+}
+
+/*------------------------------------------------------------------------------
+*  ApplyInput - Hands the input read by GatherInput to the emulated machine.
+*-----------------------------------------------------------------------------*/
+static void ApplyInput(int keycode)
+{
+    switch (keycode) {
+    case AKEY_EXIT:
+        requestQuit = TRUE;
+        break;
+    case AKEY_COLDSTART:
+        Atari800_Coldstart();
+        break;
+    case AKEY_WARMSTART:
+		if (Atari800_disable_basic && disable_all_basic) {
+			/* Disable basic on a warmstart, even though the real atarixl
+				didn't work this way */
+            GTIA_consol_override = 2;
+			}
+        Atari800_Warmstart();
+        break;
+    case AKEY_SCREENSHOT:
+        Save_TIFF_file(Find_TIFF_name());
+        break;
+    case AKEY_BREAK:
+        INPUT_key_break = 1;
+        if (!last_key_break) {
+            if (POKEY_IRQEN & 0x80) {
+                POKEY_IRQST &= ~0x80;
+                CPU_GenerateIRQ();
+            }
+            break;
+	case AKEY_PBI_BB_MENU:
+		PBI_BB_Menu();
+		break;
+	default:
+        INPUT_key_break = 0;
+        INPUT_key_code = keycode;
+        break;
+        }
+    }
+	
+	SDL_Atari_CX85();
+    
+    if (Atari800_machine_type == Atari800_MACHINE_5200) {
+        if (INPUT_key_shift & !last_key_break) {
+	if (POKEY_IRQEN & 0x80) {
+	    POKEY_IRQST &= ~0x80;
+                CPU_GenerateIRQ();
+                }
+            }
+         last_key_break = INPUT_key_shift;
+       }
+    else
+        last_key_break = INPUT_key_break;
+
+    INPUT_key_code = INPUT_key_code | CONTROL;
+
+    POKEY_SKSTAT |= 0xc;
+    if (INPUT_key_shift)
+        POKEY_SKSTAT &= ~8;
+    if (INPUT_key_code == AKEY_NONE)
+        last_key_code = AKEY_NONE;
+	/* Following keys cannot be read with both shift and control pressed:
+	 J K L ; + * Z X C V B F1 F2 F3 F4 HELP	 */
+	/* which are 0x00-0x07 and 0x10-0x17 */
+	/* This is caused by the keyboard itself, these keys generate 'ghost keys'
+	 * when pressed with shift and control */
+	if (Atari800_machine_type != Atari800_MACHINE_5200 && (INPUT_key_code&~0x17) == AKEY_SHFTCTRL) {
+		INPUT_key_code = AKEY_NONE;
+	}
+    if (INPUT_key_code != AKEY_NONE) {
+		/* The 5200 has only 4 of the 6 keyboard scan lines connected */
+		/* Pressing one 5200 key is like pressing 4 Atari 800 keys. */
+		/* The LSB (bit 0) and bit 5 are the two missing lines. */
+		/* When debounce is enabled, multiple keys pressed generate
+		 * no results. */
+		/* When debounce is disabled, multiple keys pressed generate
+		 * results only when in numerical sequence. */
+		/* Thus the LSB being one of the missing lines is important
+		 * because that causes events to be generated. */
+		/* Two events are generated every 64 scan lines
+		 * but this code only does one every frame. */
+		/* Bit 5 is different for each keypress because it is one
+		 * of the missing lines. */
+		if (Atari800_machine_type == Atari800_MACHINE_5200) {
+			static int bit5_5200 = 0;
+			if (bit5_5200) {
+				INPUT_key_code &= ~0x20;
+			}
+			bit5_5200 = !bit5_5200;
+			/* 5200 2nd fire button generates CTRL as well */
+			if (INPUT_key_shift) {
+				INPUT_key_code |= AKEY_SHFTCTRL;
+			}
+		}
+        POKEY_SKSTAT &= ~4;
+        if ((INPUT_key_code ^ last_key_code) & ~AKEY_SHFTCTRL) {
+        /* ignore if only shift or control has changed its state */
+            last_key_code = INPUT_key_code;
+            POKEY_KBCODE = (UBYTE) INPUT_key_code;
+            if (POKEY_IRQEN & 0x40) {
+                if (POKEY_IRQST & 0x40) {
+                    POKEY_IRQST &= ~0x40;
+                    CPU_GenerateIRQ();
+                }
+                else {
+                    /* keyboard over-run */
+                    POKEY_SKSTAT &= ~0x40;
+                    /* assert(CPU_IRQ != 0); */
+                }
+            }
+        }
+    }
+
+	if (INPUT_joy_multijoy && Atari800_machine_type != Atari800_MACHINE_5200) {
+		PIA_PORT_input[0] = 0xf0 | STICK[joy_multijoy_no];
+		PIA_PORT_input[1] = 0xff;
+		GTIA_TRIG[0] = TRIG_input[joy_multijoy_no];
+        GTIA_TRIG[1] = 1;
+	}
+	else {
+		GTIA_TRIG[0] = TRIG_input[0];
+		GTIA_TRIG[1] = TRIG_input[1];
+		PIA_PORT_input[0] = (STICK[1] << 4) | STICK[0];
+		PIA_PORT_input[1] = (STICK[3] << 4) | STICK[2];
+	}
+    if (Atari800_machine_type != Atari800_MACHINE_XLXE) {
+        GTIA_TRIG[2] = TRIG_input[2];
+        GTIA_TRIG[3] = TRIG_input[3];
+    }
+}
+
+/*------------------------------------------------------------------------------
+*  CheckXEP80Autoswitch - Switches to the 80 column screen once the XEP80 is
+*    sent characters.
+*-----------------------------------------------------------------------------*/
+static void CheckXEP80Autoswitch(void)
+{
+    if (XEP80_enabled && COL80_autoswitch) {
+        if (XEP80_sent_count > XEP80_last_sent_count + 1) {
+            if (!PLATFORM_80col)
+                PLATFORM_Switch80Col();
+        }
+        XEP80_last_sent_count = XEP80_sent_count;
+    }
+}
+
+/*------------------------------------------------------------------------------
+*  EmulateFrame - Runs the emulator for one frame and displays it, or shows
+*    why it can not run.
+*-----------------------------------------------------------------------------*/
+static void EmulateFrame(void)
+{
+    static double last_time = 0.0;
+
+    /* If emulator is in Ultimate mode without a valid ROM */
+    if (ULTIMATE_enabled && !ULTIMATE_have_rom) {
+        /* Clear the screen if we are in 5200 mode, with no cartridge */
+        BasicUIInit();
+        ClearScreen();
+        CenterPrint(0x9e, 0x94, "Atari Ultimate1mb Emulator", 11);
+        CenterPrint(0x9e, 0x94, "Error Loading Ultimate1mb ROM File", 12);
+        Atari_DisplayScreen((UBYTE *) Screen_atari);
+    }
+    /* If emulator is in SIDE2 mode without a valid ROM */
+    else if (((CARTRIDGE_main.type == CARTRIDGE_SIDE2) || (CARTRIDGE_piggyback.type == CARTRIDGE_SIDE2)) && !SIDE2_have_rom) {
+        /* Clear the screen if we are in 5200 mode, with no cartridge */
+        BasicUIInit();
+        ClearScreen();
+        CenterPrint(0x9e, 0x94, "Atari SIDE2 Emulator", 11);
+        CenterPrint(0x9e, 0x94, "Error Loading SIDE2 ROM File", 12);
+        Atari_DisplayScreen((UBYTE *) Screen_atari);
+    }
+    /* If emulator isn't paused, and 5200 has a cartridge */
+    else if (!pauseEmulator && !((Atari800_machine_type == Atari800_MACHINE_5200) && (CARTRIDGE_main.type == CARTRIDGE_NONE)) && ((ULTIMATE_enabled && ULTIMATE_have_rom) || !ULTIMATE_enabled)) {
+		MOVIE_StartFrame();
+		PBI_BB_Frame(); /* just to make the menu key go up automatically */
+        Devices_Frame();
+        SIO_Frame();
+        GTIA_Frame();
+        StageBegin();
+        ANTIC_Frame(TRUE);
+        StageEnd(STAGE_ANTIC);
+        MOVIE_EndFrame();
+		/* With -threaded the main thread updates the media window */
+		if (mediaStatusWindowOpen && coreThread == NULL)
+			MAC_LED_Frame();
+		if (mediaStatusWindowOpen && coreThread == NULL)
+			Casette_Frame();
+        StageBegin();
+        POKEY_Frame();
+        StageEnd(STAGE_POKEY);
+        StageBegin();
+		Sound_Update();
+        StageEnd(STAGE_SOUND);
+        Atari800_nframes++;
+        REWIND_Frame();
+        if (RunAheadPossible())
+            RunAhead();
+        SDL_DrawMousePointer();
+        StageBegin();
+        UnlockCore();
+        Atari800_Sync();
+        LockCore();
+        StageEnd(STAGE_SYNC);
+        if (coreThread != NULL)
+            SDL_AtomicIncRef(&coreFrames);
+        else
+            CountFPS();
+		if (speed_limit == 0 || (speed_limit == 1 && deltatime <= 1.0/Atari800_FPS_PAL)) {
+			if (Atari800Time() >= last_time + 1.0/60.0) {
+                Screen_DrawDiskLED();
+                Screen_DrawHDDiskLED();
+                if (FULLSCREEN_MACOS)
+                    Screen_DrawAtariSpeed(currentFps);
+                Screen_Draw1200LED();
+                Screen_DrawCapslock(MEMORY_dGetByte(0x2BE));
+                if (showFrameTimes)
+                    Screen_DrawFrameTimes(STAGE_COUNT, stageNames, frameTimesAverage, frameTimesPeak, stageColours);
+                StageBegin();
+				Atari_DisplayScreen((UBYTE *) Screen_atari);
+                StageEnd(STAGE_DISPLAY);
+				last_time = Atari800Time();
+				}
+			}
+		else {
+            Screen_DrawDiskLED();
+            Screen_DrawHDDiskLED();
+            Screen_Draw1200LED();
+            Screen_DrawCapslock(MEMORY_dGetByte(0x2BE));
+            if (showFrameTimes)
+                Screen_DrawFrameTimes(STAGE_COUNT, stageNames, frameTimesAverage, frameTimesPeak, stageColours);
+            StageBegin();
+			Atari_DisplayScreen((UBYTE *) Screen_atari);
+            StageEnd(STAGE_DISPLAY);
+			}
+        }
+    else if ((Atari800_machine_type == Atari800_MACHINE_5200) && (CARTRIDGE_main.type == CARTRIDGE_NONE)){
+        /* Clear the screen if we are in 5200 mode, with no cartridge */
+        BasicUIInit();
+        ClearScreen();
+        CenterPrint(0x9e, 0x94, "Atari 5200 Emulator", 11);
+        CenterPrint(0x9e, 0x94, "Please Insert Cartridge", 12);
+        Atari_DisplayScreen((UBYTE *) Screen_atari);
+        }
+    else {
+        UnlockCore();
+        usleep(100000);
+        LockCore();
+		Atari_DisplayScreen((UBYTE *) Screen_atari);
+		}
+}
+
+/*------------------------------------------------------------------------------
+*  LockCore/UnlockCore - Keep the main thread and the core thread out of the
+*    emulator at the same time.  They do nothing without -threaded.
+*-----------------------------------------------------------------------------*/
+static void LockCore(void)
+{
+    if (coreMutex == NULL)
+        return;
+    if (SDL_ThreadID() == coreThreadID) {
+        SDL_LockMutex(coreMutex);
+        return;
+        }
+    SDL_AtomicIncRef(&mainWaiting);
+    SDL_LockMutex(coreMutex);
+    SDL_AtomicDecRef(&mainWaiting);
+    mainLockDepth++;
+}
+
+static void UnlockCore(void)
+{
+    if (coreMutex == NULL)
+        return;
+    if (SDL_ThreadID() != coreThreadID)
+        mainLockDepth--;
+    SDL_UnlockMutex(coreMutex);
+}
+
+/*------------------------------------------------------------------------------
+*  PushInput - Queues the input of GatherInput for the core thread.  Only the
+*    main thread moves inputHead and only the core moves inputTail, so the
+*    queue needs no lock.  Input that did not change is not queued, the core
+*    keeps using the last one.
+*-----------------------------------------------------------------------------*/
+static void PushInput(int keycode)
+{
+    int head = SDL_AtomicGet(&inputHead);
+    InputSnapshot input;
+
+    memset(&input, 0, sizeof(input));
+    input.keycode = keycode;
+    input.key_shift = INPUT_key_shift;
+    input.key_consol = INPUT_key_consol;
+    input.control = CONTROL;
+    memcpy(input.stick, STICK, sizeof(input.stick));
+    memcpy(input.trig, TRIG_input, sizeof(input.trig));
+    if (memcmp(&input, &inputPushed, sizeof(input)) == 0)
+        return;
+    /* Full only while the core is stopped in a dialog */
+    if ((head + 1) % INPUT_QUEUE_SIZE == SDL_AtomicGet(&inputTail))
+        return;
+    inputQueue[head] = input;
+    inputPushed = input;
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&inputHead, (head + 1) % INPUT_QUEUE_SIZE);
+}
+
+/*------------------------------------------------------------------------------
+*  PopInput - Takes the next input from the queue, or the last one again,
+*    and puts it back where ApplyInput expects it.  Returns the key code.
+*-----------------------------------------------------------------------------*/
+static int PopInput(void)
+{
+    int tail = SDL_AtomicGet(&inputTail);
+
+    if (tail != SDL_AtomicGet(&inputHead)) {
+        SDL_MemoryBarrierAcquire();
+        inputApplied = inputQueue[tail];
+        SDL_AtomicSet(&inputTail, (tail + 1) % INPUT_QUEUE_SIZE);
+        }
+    else if (inputApplied.keycode < 0 && inputApplied.keycode != AKEY_BREAK)
+        /* Coldstart, screenshot and the like happen once */
+        inputApplied.keycode = AKEY_NONE;
+    INPUT_key_shift = inputApplied.key_shift;
+    INPUT_key_consol = inputApplied.key_consol;
+    CONTROL = inputApplied.control;
+    memcpy(STICK, inputApplied.stick, sizeof(STICK));
+    memcpy(TRIG_input, inputApplied.trig, sizeof(TRIG_input));
+    return inputApplied.keycode;
+}
+
+/*------------------------------------------------------------------------------
+*  PublishFrame - Hands Screen_atari and its dirty spans to the main thread
+*    through the triple buffer.  Called with the core lock held.
+*-----------------------------------------------------------------------------*/
+static void PublishFrame(void)
+{
+    FrameSlot *slot = &frameSlots[frameBack];
+    int old;
+    int y;
+
+    memcpy(slot->pixels, Screen_atari, sizeof(slot->pixels));
+    for (y = 0; y < Screen_HEIGHT; y++) {
+        slot->dirty_left[y] = Screen_dirty_left[y] < pendingLeft[y] ?
+                              Screen_dirty_left[y] : pendingLeft[y];
+        slot->dirty_right[y] = Screen_dirty_right[y] > pendingRight[y] ?
+                               Screen_dirty_right[y] : pendingRight[y];
+        }
+    do
+        old = SDL_AtomicGet(&frameMiddle);
+    while (!SDL_AtomicCAS(&frameMiddle, old, frameBack | FRAME_FRESH));
+    frameBack = old & ~FRAME_FRESH;
+    if (old & FRAME_FRESH) {
+        /* Dropped, so the next frame must redraw what it changed too */
+        memcpy(pendingLeft, slot->dirty_left, sizeof(pendingLeft));
+        memcpy(pendingRight, slot->dirty_right, sizeof(pendingRight));
+#ifdef FRAME_PACING_STATS
+        SDL_AtomicIncRef(&pacingDropped);
+#endif
+        }
+    else {
+        memcpy(pendingLeft, Screen_dirty_left, sizeof(pendingLeft));
+        memcpy(pendingRight, Screen_dirty_right, sizeof(pendingRight));
+        }
+    Screen_ClearDirtySpans();
+}
+
+/*------------------------------------------------------------------------------
+*  PresentFrame - Shows the newest frame of the core thread, or the last one
+*    again if the core has not finished another since.
+*-----------------------------------------------------------------------------*/
+static void PresentFrame(void)
+{
+    FrameSlot *slot;
+    int fresh = FALSE;
+    int middle;
+
+    for (;;) {
+        middle = SDL_AtomicGet(&frameMiddle);
+        if (!(middle & FRAME_FRESH))
+            break;
+        if (SDL_AtomicCAS(&frameMiddle, middle, frameFront)) {
+            frameFront = middle & ~FRAME_FRESH;
+            fresh = TRUE;
+            break;
+            }
+        }
+    if (PLATFORM_80col) {
+        /* The 80 column screens are drawn from the devices themselves */
+        LockCore();
+        DrawScreen((UBYTE *) Screen_atari, Screen_dirty_left, Screen_dirty_right);
+        UnlockCore();
+        }
+    else if (fresh) {
+        slot = &frameSlots[frameFront];
+        DrawScreen(slot->pixels, slot->dirty_left, slot->dirty_right);
+        }
+    RenderScreen();
+
+#ifdef FRAME_PACING_STATS
+    {
+        Uint64 now = SDL_GetPerformanceCounter();
+
+        if (pacingLast != 0) {
+            double ms = (double) (now - pacingLast) * 1000.0 /
+                        SDL_GetPerformanceFrequency();
+
+            pacingSum += ms;
+            pacingSumSquares += ms * ms;
+            if (ms > pacingWorst)
+                pacingWorst = ms;
+            pacingIntervals++;
+            }
+        pacingLast = now;
+        if (!fresh)
+            pacingDuplicated++;
+        if (++pacingFrames == FRAME_PACING_STATS_FRAMES && pacingIntervals > 0) {
+            double mean = pacingSum / pacingIntervals;
+            double variance = pacingSumSquares / pacingIntervals - mean * mean;
+
+            Log_print("Frame pacing: %.2f ms/frame, jitter %.2f ms, worst %.2f ms, "
+                      "%d frames dropped, %d shown twice",
+                      mean, variance > 0.0 ? sqrt(variance) : 0.0, pacingWorst,
+                      SDL_AtomicSet(&pacingDropped, 0), pacingDuplicated);
+            pacingSum = 0.0;
+            pacingSumSquares = 0.0;
+            pacingWorst = 0.0;
+            pacingIntervals = 0;
+            pacingFrames = 0;
+            pacingDuplicated = 0;
+            }
+    }
+#endif
+}
+
+/*------------------------------------------------------------------------------
+*  PaceFrame - Waits for the next refresh of the display.  With vsync on
+*    SDL_RenderPresent does that already.
+*-----------------------------------------------------------------------------*/
+static void PaceFrame(void)
+{
+    static Uint64 next = 0;
+    Uint64 now = SDL_GetPerformanceCounter();
+    Uint64 period;
+    SDL_DisplayMode mode;
+    int refresh = 60;
+
+    if (vsyncEnabled)
+        return;
+    if (SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(MainWindow), &mode) == 0 &&
+        mode.refresh_rate > 0)
+        refresh = mode.refresh_rate;
+    period = SDL_GetPerformanceFrequency() / refresh;
+    /* Start over after falling behind, rather than rushing to catch up */
+    if (next == 0 || now > next + period)
+        next = now;
+    next += period;
+    if (next > now)
+        SDL_Delay((Uint32) ((next - now) * 1000 / SDL_GetPerformanceFrequency()));
+}
+
+/*------------------------------------------------------------------------------
+*  CoreThread - Runs the emulator with -threaded, holding the core lock but
+*    while it sleeps and between frames.
+*-----------------------------------------------------------------------------*/
+static int SDLCALL CoreThread(void *data)
+{
+    /* Before LockCore, which tells the threads apart by it */
+    coreThreadID = SDL_ThreadID();
+    LockCore();
+    while (!SDL_AtomicGet(&coreQuit)) {
+        StageBegin();
+        ApplyInput(PopInput());
+        StageEnd(STAGE_INPUT);
+        EmulateFrame();
+        FrameTimesUpdate();
+        /* The main thread goes first if it waits for the lock */
+        UnlockCore();
+        while (SDL_AtomicGet(&mainWaiting) && !SDL_AtomicGet(&coreQuit))
+            SDL_Delay(0);
+        LockCore();
+        }
+    UnlockCore();
+    SDL_AtomicSet(&coreDone, 1);
+    return 0;
+}
+
+/*------------------------------------------------------------------------------
+*  StartCoreThread - Moves the emulator to its own thread.  Returns FALSE if
+*    it has to stay on the main thread.
+*-----------------------------------------------------------------------------*/
+static int StartCoreThread(void)
+{
+    int i;
+
+    frameSlots = (FrameSlot *) malloc(3 * sizeof(FrameSlot));
+    coreMutex = SDL_CreateMutex();
+    coreCallDone = SDL_CreateSemaphore(0);
+    if (frameSlots == NULL || coreMutex == NULL || coreCallDone == NULL) {
+        Log_print("Cannot run the emulator on its own thread: %s", SDL_GetError());
+        StopCoreThread();
+        return FALSE;
+        }
+    frameBack = 0;
+    SDL_AtomicSet(&frameMiddle, 1);
+    frameFront = 2;
+    for (i = 0; i < Screen_HEIGHT; i++) {
+        pendingLeft[i] = Screen_WIDTH;
+        pendingRight[i] = 0;
+        }
+    SDL_AtomicSet(&coreQuit, 0);
+    SDL_AtomicSet(&coreDone, 0);
+    SDL_AtomicSet(&inputHead, 0);
+    SDL_AtomicSet(&inputTail, 0);
+    memset(&inputPushed, 0, sizeof(inputPushed));
+    inputApplied = inputPushed;
+    inputApplied.keycode = AKEY_NONE;
+    full_display = FULL_DISPLAY_COUNT;
+
+    /* Held until coreThread is set, as the core checks it to know that it
+       runs on its own thread */
+    LockCore();
+    coreThread = SDL_CreateThread(CoreThread, "Atari800 core", NULL);
+    if (coreThread == NULL) {
+        UnlockCore();
+        Log_print("Cannot run the emulator on its own thread: %s", SDL_GetError());
+        StopCoreThread();
+        return FALSE;
+        }
+    UnlockCore();
+    return TRUE;
+}
+
+/*------------------------------------------------------------------------------
+*  FinishCoreCall - Returns RESULT from the PLATFORM_Exit call the core waits
+*    in, if it still waits.  StopCoreThread may have answered it already
+*    while the main thread was in the dialog for it.
+*-----------------------------------------------------------------------------*/
+static void FinishCoreCall(int result)
+{
+    if (SDL_AtomicCAS(&coreCallPending, 1, 0)) {
+        coreCallResult = result;
+        SDL_SemPost(coreCallDone);
+        }
+}
+
+/*------------------------------------------------------------------------------
+*  StopCoreThread - Brings the emulator back to the main thread.  Called on
+*    the main thread, which may hold the core lock when the application is
+*    told to quit.
+*-----------------------------------------------------------------------------*/
+static void StopCoreThread(void)
+{
+    if (coreThread != NULL) {
+        if (SDL_ThreadID() == coreThreadID)
+            return;
+        SDL_AtomicSet(&coreQuit, 1);
+        for (; mainLockDepth > 0; mainLockDepth--)
+            SDL_UnlockMutex(coreMutex);
+        /* A core waiting in PLATFORM_Exit is told to carry on, so that it
+           sees coreQuit, also if it gets there before it stops */
+        while (!SDL_AtomicGet(&coreDone)) {
+            FinishCoreCall(1);
+            SDL_Delay(1);
+            }
+        SDL_WaitThread(coreThread, NULL);
+        coreThread = NULL;
+        PrintOutputControllerFlush();
+        ControlManagerMessageFlush();
+        }
+    if (coreMutex != NULL) {
+        SDL_DestroyMutex(coreMutex);
+        coreMutex = NULL;
+        }
+    if (coreCallDone != NULL) {
+        SDL_DestroySemaphore(coreCallDone);
+        coreCallDone = NULL;
+        }
+    free(frameSlots);
+    frameSlots = NULL;
+    mainLockDepth = 0;
+    coreThreadID = 0;
+}
+
+/*------------------------------------------------------------------------------
+*  PresentationFrame - One pass of the main loop with -threaded.  Handles the
+*    events, queues their input for the core, and shows the newest frame.
+*-----------------------------------------------------------------------------*/
+static void PresentationFrame(void)
+{
+    int frames;
+
+    LockCore();
+    if (SDL_AtomicGet(&coreCallPending))
+        FinishCoreCall(ExitOrMonitor(coreCallArg));
+    if (SDL_AtomicCAS(&switch80ColPending, 1, 0))
+        Switch80Col();
+    /* Cocoa only takes the printer output and the log from the main thread */
+    PrintOutputControllerFlush();
+    ControlManagerMessageFlush();
+    PushInput(GatherInput());
+    ProcessMacMenus();
+    CheckXEP80Autoswitch();
+    if (mediaStatusWindowOpen) {
+        MAC_LED_Frame();
+        Casette_Frame();
+        }
+    ProcessMacPrefsChange();
+    UnlockCore();
+    /* Stopped if the application was told to quit */
+    if (coreThread == NULL)
+        return;
+
+    PresentFrame();
+    for (frames = SDL_AtomicSet(&coreFrames, 0); frames > 0; frames--)
+        CountFPS();
+    PaceFrame();
+}
+
+/*------------------------------------------------------------------------------
+* main - main function of emulator with main execution loop.
+*-----------------------------------------------------------------------------*/
+int SDL_main(int argc, char **argv)
+{
+    int done = 0;
+    int retVal;
+
+    POKEYSND_stereo_enabled = FALSE; /* Turn this off here....otherwise games only come
+                             from one channel...you only want this for demos mainly
+                             anyway */
+    SDL_version v;
+	SDL_GetVersion(&v);
+	Log_print("SDL Version: %u.%u.%u", v.major, v.minor, v.patch);
+	SDLMainActivate();
+	
+    if (!fileToLoad) {
+	  argc = prefsArgc;
+      argv = prefsArgv;
+	  }
+
+    if (!Atari800_Initialise(&argc, argv))
         return 3;
 
     if (!EnableDisplayManager80ColMode(Atari800_machine_type, XEP80_enabled, AF80_enabled, BIT3_enabled))
@@ -5612,8 +7130,8 @@ int SDL_main(int argc, char **argv)
 #endif			 
 	}
 
-    /* Clear the alternate page, so the first redraw is entire screen */
-    memset(Screen_atari_b, 0, (Screen_HEIGHT * Screen_WIDTH));
+    /* The first redraw is entire screen */
+    Screen_EntireDirty();
 	
 	/* Create the OpenGL Monitor Screen */
 	MonitorGLScreen = SDL_CreateRGBSurface(SDL_SWSURFACE, 640, 480, 16,
@@ -5643,273 +7161,24 @@ int SDL_main(int argc, char **argv)
         pasteState = PASTE_START;
     }
 
-    while (!done) {        
-        /* Handle joysticks and paddles */
-        SDL_Atari_PORT(&STICK[0], &STICK[1], &STICK[2], &STICK[3]);
-        keycode = SDL_Atari_TRIG(&TRIG_input[0], &TRIG_input[1], &TRIG_input[2], &TRIG_input[3],
-                                 &pad_key_shift, &pad_key_control, &pad_key_consol);
-        for (i=0;i<4;i++) {
-            if (JOYSTICK_MODE[i] == MOUSE_EMULATION)
-                break;
-            }
-        if ((i<4) && (INPUT_mouse_mode != INPUT_MOUSE_OFF)) { 
-			INPUT_mouse_port = i;
-            SDL_Atari_Mouse(&STICK[i],&TRIG_input[i]);
-			}
+    if (threadedCore && !StartCoreThread())
+        threadedCore = FALSE;
 
-        INPUT_key_consol = INPUT_CONSOL_NONE;
-        switch(keycode) {
-            case AKEY_NONE:
-                keycode = Atari_Keyboard();
-                break;
-            case AKEY_BUTTON2:
-                INPUT_key_shift = 1;
-                keycode = AKEY_NONE;
-                break;
-            case AKEY_5200_RESET:
-                if (Atari800_machine_type == Atari800_MACHINE_5200)
-                    keycode = AKEY_WARMSTART;
-                break;
-            case AKEY_BUTTON_RESET:
-                if (Atari800_machine_type != Atari800_MACHINE_5200)
-                    keycode = AKEY_WARMSTART;
-                break;
-            default:
-                Atari_Keyboard(); /* Get the keyboard state (for shift and control), but 
-                                      throw away the key, since the keypad key takes precedence */
-                if (INPUT_key_shift)
-                    keycode |= AKEY_SHFT;
-            }
-		
-        // Merge the gamepad buttons and keyboard mod keys
-		if (pad_key_shift && !INPUT_key_shift)
-		   keycode |= AKEY_SHFT;
-        INPUT_key_shift |= pad_key_shift;
-		CONTROL |= pad_key_control;
-		INPUT_key_consol &= pad_key_consol;
-		
-        switch (keycode) {
-        case AKEY_EXIT:
-            done = 1;
-            break;
-        case AKEY_COLDSTART:
-            Atari800_Coldstart();
-            break;
-        case AKEY_WARMSTART:
-			if (Atari800_disable_basic && disable_all_basic) {
-				/* Disable basic on a warmstart, even though the real atarixl
-					didn't work this way */
-                GTIA_consol_override = 2;
-				}
-            Atari800_Warmstart();
-            break;
-        case AKEY_SCREENSHOT:
-            Save_TIFF_file(Find_TIFF_name());
-            break;
-        case AKEY_BREAK:
-            INPUT_key_break = 1;
-            if (!last_key_break) {
-                if (POKEY_IRQEN & 0x80) {
-                    POKEY_IRQST &= ~0x80;
-                    CPU_GenerateIRQ();
-                }
-                break;
-		case AKEY_PBI_BB_MENU:
-			PBI_BB_Menu();
-			break;
-		default:
-            INPUT_key_break = 0;
-            INPUT_key_code = keycode;
-            break;
-            }
-        }
-		
-		SDL_Atari_CX85();
-        
-        if (Atari800_machine_type == Atari800_MACHINE_5200) {
-            if (INPUT_key_shift & !last_key_break) {
-		if (POKEY_IRQEN & 0x80) {
-		    POKEY_IRQST &= ~0x80;
-                    CPU_GenerateIRQ();
-                    }
-                }
-             last_key_break = INPUT_key_shift;
-           }
-        else
-            last_key_break = INPUT_key_break;
-
-        INPUT_key_code = INPUT_key_code | CONTROL;
-
-        POKEY_SKSTAT |= 0xc;
-        if (INPUT_key_shift)
-            POKEY_SKSTAT &= ~8;
-        if (INPUT_key_code == AKEY_NONE)
-            last_key_code = AKEY_NONE;
-		/* Following keys cannot be read with both shift and control pressed:
-		 J K L ; + * Z X C V B F1 F2 F3 F4 HELP	 */
-		/* which are 0x00-0x07 and 0x10-0x17 */
-		/* This is caused by the keyboard itself, these keys generate 'ghost keys'
-		 * when pressed with shift and control */
-		if (Atari800_machine_type != Atari800_MACHINE_5200 && (INPUT_key_code&~0x17) == AKEY_SHFTCTRL) {
-			INPUT_key_code = AKEY_NONE;
-		}
-        if (INPUT_key_code != AKEY_NONE) {
-			/* The 5200 has only 4 of the 6 keyboard scan lines connected */
-			/* Pressing one 5200 key is like pressing 4 Atari 800 keys. */
-			/* The LSB (bit 0) and bit 5 are the two missing lines. */
-			/* When debounce is enabled, multiple keys pressed generate
-			 * no results. */
-			/* When debounce is disabled, multiple keys pressed generate
-			 * results only when in numerical sequence. */
-			/* Thus the LSB being one of the missing lines is important
-			 * because that causes events to be generated. */
-			/* Two events are generated every 64 scan lines
-			 * but this code only does one every frame. */
-			/* Bit 5 is different for each keypress because it is one
-			 * of the missing lines. */
-			if (Atari800_machine_type == Atari800_MACHINE_5200) {
-				static int bit5_5200 = 0;
-				if (bit5_5200) {
-					INPUT_key_code &= ~0x20;
-				}
-				bit5_5200 = !bit5_5200;
-				/* 5200 2nd fire button generates CTRL as well */
-				if (INPUT_key_shift) {
-					INPUT_key_code |= AKEY_SHFTCTRL;
-				}
-			}
-            POKEY_SKSTAT &= ~4;
-            if ((INPUT_key_code ^ last_key_code) & ~AKEY_SHFTCTRL) {
-            /* ignore if only shift or control has changed its state */
-                last_key_code = INPUT_key_code;
-                POKEY_KBCODE = (UBYTE) INPUT_key_code;
-                if (POKEY_IRQEN & 0x40) {
-                    if (POKEY_IRQST & 0x40) {
-                        POKEY_IRQST &= ~0x40;
-                        CPU_GenerateIRQ();
-                    }
-                    else {
-                        /* keyboard over-run */
-                        POKEY_SKSTAT &= ~0x40;
-                        /* assert(CPU_IRQ != 0); */
-                    }
-                }
-            }
-        }
-
-	if (INPUT_joy_multijoy && Atari800_machine_type != Atari800_MACHINE_5200) {
-		PIA_PORT_input[0] = 0xf0 | STICK[joy_multijoy_no];
-		PIA_PORT_input[1] = 0xff;
-		GTIA_TRIG[0] = TRIG_input[joy_multijoy_no];
-        GTIA_TRIG[1] = 1;
-	}
-	else {
-		GTIA_TRIG[0] = TRIG_input[0];
-		GTIA_TRIG[1] = TRIG_input[1];
-		PIA_PORT_input[0] = (STICK[1] << 4) | STICK[0];
-		PIA_PORT_input[1] = (STICK[3] << 4) | STICK[2];
-	}
-    if (Atari800_machine_type != Atari800_MACHINE_XLXE) {
-        GTIA_TRIG[2] = TRIG_input[2];
-        GTIA_TRIG[3] = TRIG_input[3];
-    }
-
-        /* switch between screens to enable delta output */
-		if (screenSwitchEnabled) {
-			if (Screen_atari==Screen_atari1) {
-				Screen_atari = Screen_atari2;
-				Screen_atari_b = Screen_atari1;
-			}
-			else {
-				Screen_atari = Screen_atari1;
-				Screen_atari_b = Screen_atari2;
-			}
-			if (speed_limit == 0 || (speed_limit == 1 && deltatime <= 1.0/Atari800_FPS_PAL))
-				screenSwitchEnabled = FALSE;
-		}
-
-        ProcessMacMenus();
-        
-        if (XEP80_enabled && COL80_autoswitch) {
-            if (XEP80_sent_count > XEP80_last_sent_count + 1) {
-                if (!PLATFORM_80col)
-                    PLATFORM_Switch80Col();
-            }
-            XEP80_last_sent_count = XEP80_sent_count;
-        }
-
-        /* If emulator is in Ultimate mode without a valid ROM */
-        if (ULTIMATE_enabled && !ULTIMATE_have_rom) {
-            /* Clear the screen if we are in 5200 mode, with no cartridge */
-            BasicUIInit();
-            memset(Screen_atari_b, 0, (Screen_HEIGHT * Screen_WIDTH));
-            ClearScreen();
-            CenterPrint(0x9e, 0x94, "Atari Ultimate1mb Emulator", 11);
-            CenterPrint(0x9e, 0x94, "Error Loading Ultimate1mb ROM File", 12);
-            Atari_DisplayScreen((UBYTE *) Screen_atari);
-        }
-        /* If emulator is in SIDE2 mode without a valid ROM */
-        else if (((CARTRIDGE_main.type == CARTRIDGE_SIDE2) || (CARTRIDGE_piggyback.type == CARTRIDGE_SIDE2)) && !SIDE2_have_rom) {
-            /* Clear the screen if we are in 5200 mode, with no cartridge */
-            BasicUIInit();
-            memset(Screen_atari_b, 0, (Screen_HEIGHT * Screen_WIDTH));
-            ClearScreen();
-            CenterPrint(0x9e, 0x94, "Atari SIDE2 Emulator", 11);
-            CenterPrint(0x9e, 0x94, "Error Loading SIDE2 ROM File", 12);
-            Atari_DisplayScreen((UBYTE *) Screen_atari);
-        }
-        /* If emulator isn't paused, and 5200 has a cartridge */
-        else if (!pauseEmulator && !((Atari800_machine_type == Atari800_MACHINE_5200) && (CARTRIDGE_main.type == CARTRIDGE_NONE)) && ((ULTIMATE_enabled && ULTIMATE_have_rom) || !ULTIMATE_enabled)) {
-			PBI_BB_Frame(); /* just to make the menu key go up automatically */
-            Devices_Frame();
-            GTIA_Frame();
-            ANTIC_Frame(TRUE);
-			if (mediaStatusWindowOpen)
-				MAC_LED_Frame();
-			if (mediaStatusWindowOpen)
-				Casette_Frame();
-            SDL_DrawMousePointer();
-            POKEY_Frame();
-			Sound_Update();
-            Atari800_nframes++;
-            Atari800_Sync();
-            CountFPS();
-			if (speed_limit == 0 || (speed_limit == 1 && deltatime <= 1.0/Atari800_FPS_PAL)) {
-				if (Atari800Time() >= last_time + 1.0/60.0) {
-                    Screen_DrawDiskLED();
-                    Screen_DrawHDDiskLED();
-                    if (FULLSCREEN_MACOS)
-                        Screen_DrawAtariSpeed(currentFps);
-                    Screen_Draw1200LED();
-                    Screen_DrawCapslock(MEMORY_dGetByte(0x2BE));
-					Atari_DisplayScreen((UBYTE *) Screen_atari);
-					last_time = Atari800Time();
-					screenSwitchEnabled = TRUE;
-					}
-				}
-			else {
-                Screen_DrawDiskLED();
-                Screen_DrawHDDiskLED();
-                Screen_Draw1200LED();
-                Screen_DrawCapslock(MEMORY_dGetByte(0x2BE));
-				Atari_DisplayScreen((UBYTE *) Screen_atari);
-				}
-            }
-        else if ((Atari800_machine_type == Atari800_MACHINE_5200) && (CARTRIDGE_main.type == CARTRIDGE_NONE)){
-            /* Clear the screen if we are in 5200 mode, with no cartridge */
-            BasicUIInit();
-            memset(Screen_atari_b, 0, (Screen_HEIGHT * Screen_WIDTH));
-            ClearScreen();
-            CenterPrint(0x9e, 0x94, "Atari 5200 Emulator", 11);
-            CenterPrint(0x9e, 0x94, "Please Insert Cartridge", 12);
-            Atari_DisplayScreen((UBYTE *) Screen_atari);
-            }
+    while (!done) {        
+        if (coreThread != NULL)
+            PresentationFrame();
         else {
-            usleep(100000);
-			Atari_DisplayScreen((UBYTE *) Screen_atari);
-			}
-
-        ProcessMacPrefsChange();
+            StageBegin();
+            ApplyInput(GatherInput());
+            ProcessMacMenus();
+            StageEnd(STAGE_INPUT);
+            CheckXEP80Autoswitch();
+            EmulateFrame();
+            StageBegin();
+            ProcessMacPrefsChange();
+            StageEnd(STAGE_PREFS);
+            FrameTimesUpdate();
+            }
 
         if (requestQuit)
             done = TRUE;
@@ -5917,6 +7186,9 @@ int SDL_main(int argc, char **argv)
 		AboutBoxScroll();
 		
         }
+    StopCoreThread();
+    if (frameTimesFile != NULL)
+        FrameTimesToggleFile();
     Atari800_Exit(FALSE);
     Log_flushlog();
     return 0;
@@ -259,6 +259,13 @@
 /* Enable tracing of cpu in monitor */
 #define MONITOR_TRACE */
 
+/* Enable streaming of every executed instruction to a trace file */
+#define MONITOR_TRACELOG
+
+/* Enable the PROF cycle profiler in monitor. CPU_GO then tests whether it
+   is on before and after every instruction, so it is off by default. */
+/* #define MONITOR_PROF */
+
 /* Enable Snailmeter (shows how much is the emulator slower than original) */
 #define SNAILMETER
 
@@ -331,8 +338,8 @@
 /* Don't use command line configuration update */
 #define DONT_USE_RTCONFIGUPDATE
 
-/* Define two screen arrays used for switching */
-#define BITPL_SCR
+/* Have ANTIC keep the changed span of each scanline for the display */
+#define DIRTYSPAN
 
 /* Change name confict with monitor() function */
 #define monitor Atari_monitor
@@ -36,8 +36,14 @@
 #include "monitor.h"
 #include "pia.h"
 #include "pokey.h"
+#ifdef MONITOR_PROF
+#include "profile.h"
+#endif
 #include "prompts.h"
 #include "sio.h"
+#ifdef MONITOR_TRACELOG
+#include "tracelog.h"
+#endif
 #include "util.h"
 #include <stdarg.h>
 #ifdef STEREO_SOUND
@@ -368,40 +374,176 @@ static symtable_rec *symtable_user = NULL;
 static int symtable_user_size = 0;
 #endif
 
-static const char *find_label_name(UWORD addr, int write)
+/* Label files from MADS or ca65 can have tens of thousands of symbols, so
+   the user labels are indexed by address (first label for an address wins)
+   and by name (first label with a name wins). The indexes are rebuilt on
+   the next lookup after the labels change. */
+static int *user_label_by_addr = NULL;	/* 64K entries, index or -1 */
+static int *user_label_by_name = NULL;	/* open addressing hash, index or -1 */
+static int user_label_hash_size = 0;
+static int user_labels_indexed = FALSE;
+
+/* Index + 1 of the first builtin label for each address, 0 if none,
+   for symtable_builtin and symtable_builtin_5200 */
+static UWORD *builtin_label_by_addr[2] = {NULL, NULL};
+
+/* The user label names are kept in large blocks that are freed together */
+#define LABEL_NAMES_BLOCK_SIZE 65536
+typedef struct label_names_block {
+	struct label_names_block *next;
+	size_t used;
+	size_t size;
+	char text[1];
+} label_names_block;
+static label_names_block *label_names = NULL;
+
+static char *store_label_name(const char *name, size_t len)
+{
+	label_names_block *b = label_names;
+	char *s;
+	if (b == NULL || b->used + len + 1 > b->size) {
+		size_t size = len + 1 > LABEL_NAMES_BLOCK_SIZE ? len + 1 : LABEL_NAMES_BLOCK_SIZE;
+		b = (label_names_block *) Util_malloc(sizeof(label_names_block) + size);
+		b->next = label_names;
+		b->used = 0;
+		b->size = size;
+		label_names = b;
+	}
+	s = b->text + b->used;
+	memcpy(s, name, len);
+	s[len] = '\0';
+	b->used += len + 1;
+	return s;
+}
+
+static unsigned int label_name_hash(const char *name)
+{
+	/* FNV-1a of the upper case name, as labels are not case sensitive */
+	unsigned int h = 2166136261U;
+	while (*name != '\0')
+		h = (h ^ (unsigned char) toupper((unsigned char) *name++)) * 16777619U;
+	return h;
+}
+
+/* Adds user label I to the name hash unless the name is already there */
+static void hash_user_label(int i)
+{
+	unsigned int mask = user_label_hash_size - 1;
+	unsigned int h = label_name_hash(symtable_user[i].name) & mask;
+	int n;
+	while ((n = user_label_by_name[h]) >= 0) {
+		if (Util_stricmp(symtable_user[n].name, symtable_user[i].name) == 0)
+			return;
+		h = (h + 1) & mask;
+	}
+	user_label_by_name[h] = i;
+}
+
+static void index_user_labels(void)
 {
 	int i;
+	if (user_label_by_addr == NULL)
+		user_label_by_addr = (int *) Util_malloc(0x10000 * sizeof(int));
+	for (i = 0; i < 0x10000; i++)
+		user_label_by_addr[i] = -1;
+	/* keep the hash at most half full */
+	if (user_label_hash_size < 2 * symtable_user_size) {
+		if (user_label_hash_size == 0)
+			user_label_hash_size = 1024;
+		while (user_label_hash_size < 2 * symtable_user_size)
+			user_label_hash_size *= 2;
+		free(user_label_by_name);
+		user_label_by_name = (int *) Util_malloc(user_label_hash_size * sizeof(int));
+	}
+	for (i = 0; i < user_label_hash_size; i++)
+		user_label_by_name[i] = -1;
 	for (i = 0; i < symtable_user_size; i++) {
-		if (symtable_user[i].addr == addr)
+		if (user_label_by_addr[symtable_user[i].addr] < 0)
+			user_label_by_addr[symtable_user[i].addr] = i;
+		hash_user_label(i);
+	}
+	user_labels_indexed = TRUE;
+}
+
+static const symtable_rec *builtin_labels(UWORD **by_addr)
+{
+	int machine = Atari800_machine_type == Atari800_MACHINE_5200;
+	const symtable_rec *table = machine ? symtable_builtin_5200 : symtable_builtin;
+	if (builtin_label_by_addr[machine] == NULL) {
+		UWORD *index = (UWORD *) Util_malloc(0x10000 * sizeof(UWORD));
+		int i;
+		memset(index, 0, 0x10000 * sizeof(UWORD));
+		for (i = 0; table[i].name != NULL; i++)
+			if (index[table[i].addr] == 0)
+				index[table[i].addr] = (UWORD) (i + 1);
+		builtin_label_by_addr[machine] = index;
+	}
+	*by_addr = builtin_label_by_addr[machine];
+	return table;
+}
+
+static const char *find_label_name(UWORD addr, int write)
+{
+	if (symtable_user_size > 0) {
+		int i;
+		if (!user_labels_indexed)
+			index_user_labels();
+		i = user_label_by_addr[addr];
+		if (i >= 0)
 			return symtable_user[i].name;
 	}
 	if (symtable_builtin_enable) {
-		const symtable_rec *p;
-		for (p = (Atari800_machine_type == Atari800_MACHINE_5200 ? symtable_builtin_5200 : symtable_builtin); p->name != NULL; p++) {
-			if (p->addr == addr) {
-				if (write && p[1].addr == addr)
-					p++;
-				return p->name;
-			}
+		UWORD *by_addr;
+		const symtable_rec *p = builtin_labels(&by_addr);
+		if (by_addr[addr] != 0) {
+			p += by_addr[addr] - 1;
+			if (write && p[1].addr == addr)
+				p++;
+			return p->name;
 		}
 	}
 	return NULL;
 }
 
+#ifdef MONITOR_PROF
+/* Names the functions in the profiler's call tree */
+static const char *profile_label_name(UWORD addr)
+{
+	return find_label_name(addr, 0);
+}
+#endif
+
 #ifdef MACOSX_MON_ENHANCEMENTS
 symtable_rec *find_user_label(const char *name)
 #else
 static symtable_rec *find_user_label(const char *name)
 #endif
 {
+	unsigned int mask;
+	unsigned int h;
 	int i;
-	for (i = 0; i < symtable_user_size; i++) {
+	if (symtable_user_size == 0)
+		return NULL;
+	if (!user_labels_indexed)
+		index_user_labels();
+	mask = user_label_hash_size - 1;
+	for (h = label_name_hash(name) & mask; (i = user_label_by_name[h]) >= 0; h = (h + 1) & mask) {
 		if (Util_stricmp(symtable_user[i].name, name) == 0)
 			return &symtable_user[i];
 	}
 	return NULL;
 }
 
+#ifdef MACOSX_MON_ENHANCEMENTS
+void set_user_label_addr(symtable_rec *p, UWORD addr)
+#else
+static void set_user_label_addr(symtable_rec *p, UWORD addr)
+#endif
+{
+	p->addr = addr;
+	user_labels_indexed = FALSE;
+}
+
 #ifdef MACOSX_MON_ENHANCEMENTS
 int find_label_value(const char *name)
 #else
@@ -426,19 +568,20 @@ void free_user_labels(void)
 static void free_user_labels(void)
 #endif
 {
+	while (label_names != NULL) {
+		label_names_block *next = label_names->next;
+		free(label_names);
+		label_names = next;
+	}
 	if (symtable_user != NULL) {
-		while (symtable_user_size > 0)
-			free(symtable_user[--symtable_user_size].name);
 		free(symtable_user);
 		symtable_user = NULL;
 	}
+	symtable_user_size = 0;
+	user_labels_indexed = FALSE;
 }
 
-#ifdef MACOSX_MON_ENHANCEMENTS
-void add_user_label(const char *name, UWORD addr)
-#else
-static void add_user_label(const char *name, UWORD addr)
-#endif
+static void add_user_label_len(const char *name, size_t len, UWORD addr)
 {
 #define SYMTABLE_USER_INITIAL_SIZE 128
 	if (symtable_user == NULL)
@@ -449,11 +592,31 @@ static void add_user_label(const char *name, UWORD addr)
 		symtable_user = (symtable_rec *) Util_realloc(symtable_user,
 			2 * symtable_user_size * sizeof(symtable_rec));
 	}
-	symtable_user[symtable_user_size].name = Util_strdup(name);
+	symtable_user[symtable_user_size].name = store_label_name(name, len);
 	symtable_user[symtable_user_size].addr = addr;
 	symtable_user_size++;
 }
 
+#ifdef MACOSX_MON_ENHANCEMENTS
+void add_user_label(const char *name, UWORD addr)
+#else
+static void add_user_label(const char *name, UWORD addr)
+#endif
+{
+	add_user_label_len(name, strlen(name), addr);
+	if (user_labels_indexed) {
+		/* update the indexes in place while the hash has room */
+		int i = symtable_user_size - 1;
+		if (2 * symtable_user_size > user_label_hash_size)
+			user_labels_indexed = FALSE;
+		else {
+			if (user_label_by_addr[addr] < 0)
+				user_label_by_addr[addr] = i;
+			hash_user_label(i);
+		}
+	}
+}
+
 #ifdef MACOSX_MON_ENHANCEMENTS
 void load_user_labels(const char *filename)
 #else
@@ -461,7 +624,10 @@ static void load_user_labels(const char *filename)
 #endif
 {
 	FILE *fp;
-	char line[256];
+	char *text;
+	const char *line;
+	const char *end;
+	int len;
 	if (filename == NULL) {
 		mon_printf("You must specify a filename\n");
 		return;
@@ -473,16 +639,31 @@ static void load_user_labels(const char *filename)
 		perror(filename);
 		return;
 	}
+	/* read the whole file and parse it in place, which is much faster than
+	   fgets for label files with 100k symbols */
+	len = Util_flen(fp);
+	if (len < 0)
+		len = 0;
+	Util_rewind(fp);
+	text = (char *) Util_malloc(len + 1);
+	len = (int) fread(text, 1, len, fp);
+	fclose(fp);
+	text[len] = '\0';
 #ifndef MACOSX_MON_ENHANCEMENTS   // We don't clear labels on a load so you can merge two files
 	free_user_labels();
 #endif
-	while (fgets(line, sizeof(line), fp)) {
-		char *p;
+	end = text + len;
+	for (line = text; line < end; ) {
+		const char *p;
+		const char *eol = memchr(line, '\n', end - line);
+		const char *name_end;
 		unsigned int value = 0;
 		int digits = 0;
+		if (eol == NULL)
+			eol = end;
 		/* Find first 4 hex digits or more. */
 		/* We don't support "Cafe Assembler", "Dead Assembler" or "C0de Assembler". ;-) */
-		for (p = line; *p != '\0'; p++) {
+		for (p = line; p < eol; p++) {
 			if (*p >= '0' && *p <= '9') {
 				value = (value << 4) + *p - '0';
 				digits++;
@@ -505,19 +686,23 @@ static void load_user_labels(const char *filename)
 				digits = 0;
 			}
 		}
-		if (*p != ' ' && *p != '\t')
+		line = eol + 1;
+		if (p == eol || (*p != ' ' && *p != '\t'))
 			continue;
 		if (value > 0xffff || digits > 8)
 			continue;
 		do
 			p++;
-		while (*p == ' ' || *p == '\t');
-		Util_chomp(p);
-		if (*p == '\0')
+		while (p < eol && (*p == ' ' || *p == '\t'));
+		name_end = eol;
+		if (name_end > p && name_end[-1] == '\r')
+			name_end--;
+		if (name_end == p)
 			continue;
-		add_user_label(p, (UWORD) value);
+		add_user_label_len(p, name_end - p, (UWORD) value);
 	}
-	fclose(fp);
+	free(text);
+	user_labels_indexed = FALSE;
 	mon_printf("Loaded %d labels\n", symtable_user_size);
 }
 
@@ -812,6 +997,16 @@ void MONITOR_monitorEnter(void)
 	  
 	CPU_GetStatus();
 
+#ifdef MEMORY_WATCHPOINTS
+	if (MEMORY_watch_hit >= 0) {
+		mon_printf("(Watchpoint #%d: %s %04X, value %02X)\n", MEMORY_watch_hit,
+				   MEMORY_watch_hit_type == MEMORY_WATCH_READ ? "read of" :
+				   MEMORY_watch_hit_type == MEMORY_WATCH_WRITE ? "write to" : "DMA read of",
+				   MEMORY_watch_hit_addr, MEMORY_watch_hit_value);
+		MEMORY_watch_hit = -1;
+	}
+#endif
+
 #ifdef MONITOR_BREAK
 	if (break_over) {
 		/* "O" command was active */
@@ -962,6 +1157,13 @@ int MONITOR_monitorCmd(char *input)
 	{
 		char *t;
 
+#ifdef MEMORY_WATCHPOINTS
+		/* a watch hit by a monitor command must not stop the emulation */
+		if (MEMORY_watch_hit >= 0) {
+			MEMORY_watch_hit = -1;
+			MONITOR_break_step = FALSE;
+		}
+#endif
 		RemoveLF(input);
         strncpy(s,input,127);
         if (MONITOR_assemblerMode) {
@@ -1036,6 +1238,65 @@ int MONITOR_monitorCmd(char *input)
 			else
 				ANTIC_break_ypos = break_temp;
 		}
+#ifdef MEMORY_WATCHPOINTS
+		else if (strcmp(t, "WATCH") == 0) {
+			char *arg = get_token(NULL);
+			UWORD addr;
+			UWORD num;
+
+			if (arg == NULL) {
+				int i;
+
+				if (MEMORY_num_watches == 0)
+					mon_printf("No watchpoints\n");
+				for (i = 0; i < MEMORY_num_watches; i++) {
+					const MEMORY_watch *w = &MEMORY_watches[i];
+
+					mon_printf("%2d: %04X %s%s%s", i, w->addr,
+							   (w->types & MEMORY_WATCH_READ) ? "R" : "",
+							   (w->types & MEMORY_WATCH_WRITE) ? "W" : "",
+							   (w->types & MEMORY_WATCH_DMA) ? " DMA" : "");
+					if (w->bank != MEMORY_WATCH_ANY_BANK)
+						mon_printf(" bank %d", w->bank);
+					mon_printf("\n");
+				}
+			}
+			else if (strcasecmp(arg, "CLEAR") == 0)
+				MEMORY_ClearWatches();
+			else if (strcasecmp(arg, "DEL") == 0) {
+				if (get_dec(NULL, &num) && num < MEMORY_num_watches)
+					MEMORY_DeleteWatch(num);
+				else
+					mon_printf("Usage: WATCH DEL n\n");
+			}
+			else if (get_val(arg, &addr)) {
+				char *type = get_token(NULL);
+				int types = MEMORY_WATCH_READ | MEMORY_WATCH_WRITE;
+				int bank = MEMORY_WATCH_ANY_BANK;
+
+				if (type == NULL)
+					type = "RW";
+				if (strcasecmp(type, "R") == 0)
+					types = MEMORY_WATCH_READ;
+				else if (strcasecmp(type, "W") == 0)
+					types = MEMORY_WATCH_WRITE;
+				else if (strcasecmp(type, "DMA") == 0)
+					types = MEMORY_WATCH_DMA;
+				else if (strcasecmp(type, "RW") != 0)
+					types = 0;
+				if (get_dec(NULL, &num))
+					bank = num;
+				if (types == 0)
+					mon_printf("Usage: WATCH addr [R|W|RW|DMA] [bank]\n");
+				else if ((types & MEMORY_WATCH_DMA) == 0 && addr < 0x200)
+					mon_printf("Zero page and stack can not be watched, use a READ/WRITE breakpoint\n");
+				else if (MEMORY_AddWatch(addr, types, bank) < 0)
+					mon_printf("Too many watchpoints\n");
+			}
+			else
+				mon_printf("Usage: WATCH addr [R|W|RW|DMA] [bank], WATCH DEL n or WATCH CLEAR\n");
+		}
+#endif
 		else if (strcmp(t, "MONHIST") == 0) {
 			char *brkarg;
 			brkarg = get_token(NULL);
@@ -1271,6 +1532,91 @@ int MONITOR_monitorCmd(char *input)
 		}
 #endif
 
+#ifdef MONITOR_TRACELOG
+		else if (strcmp(t, "TRACELOG") == 0) {
+			char *arg = get_token(NULL);
+
+			if (arg == NULL)
+				mon_printf("Trace log is %s, %llu instructions written\n",
+						   TRACELOG_active ? "on" : "off", (unsigned long long) TRACELOG_count);
+			else if (strcasecmp(arg, "OFF") == 0)
+				TRACELOG_Stop();
+			else {
+				char *mode = get_token(NULL);
+
+				if (mode != NULL && strcasecmp(mode, "RAW") != 0)
+					mon_printf("Usage: TRACELOG file [RAW] or TRACELOG OFF\n");
+				else if (!TRACELOG_Start(arg, mode == NULL))
+					mon_printf("Error opening trace log %s\n", arg);
+			}
+		}
+#endif
+
+#ifdef MONITOR_PROF
+		else if (strcmp(t, "PROF") == 0) {
+			char *arg = get_token(NULL);
+
+			if (arg == NULL) {
+				ULONG insns;
+				uint64_t cyc, stolen;
+
+				PROFILE_Totals(&insns, &cyc, &stolen);
+				mon_printf("Profiler is %s: %lu instructions, %llu cycles, %llu stolen by ANTIC\n",
+						   PROFILE_active ? "on" : "off", (unsigned long) insns,
+						   (unsigned long long) cyc, (unsigned long long) stolen);
+			}
+			else if (strcasecmp(arg, "ON") == 0)
+				PROFILE_Start();
+			else if (strcasecmp(arg, "OFF") == 0)
+				PROFILE_Stop();
+			else if (strcasecmp(arg, "CLEAR") == 0)
+				PROFILE_Clear();
+			else if (strcasecmp(arg, "TOP") == 0) {
+				PROFILE_entry top[64];
+				UWORD num = 16;
+				int n, i;
+
+				get_dec(NULL, &num);
+				if (num > 64)
+					num = 64;
+				n = PROFILE_Top(top, num);
+				if (n == 0)
+					mon_printf("No profile. Type PROF ON and continue emulation.\n");
+				else
+					mon_printf("Addr  Bank      Count       Cycles       Stolen\n");
+				for (i = 0; i < n; i++) {
+					const char *label = find_label_name(top[i].addr, 0);
+
+					mon_printf("%04X  %4d %10lu %12llu %12llu  ", top[i].addr, top[i].bank,
+							   (unsigned long) top[i].count, (unsigned long long) top[i].cycles,
+							   (unsigned long long) top[i].stolen);
+					if (top[i].bank == 0)
+						show_instruction(top[i].addr, 22);
+					else
+						mon_printf("%s\n", label != NULL ? label : "");
+				}
+			}
+			else if (strcasecmp(arg, "SAVE") == 0) {
+				char *file = get_token(NULL);
+
+				if (file == NULL)
+					mon_printf("Usage: PROF SAVE file\n");
+				else if (!PROFILE_SaveFolded(file, profile_label_name))
+					mon_printf("Error writing %s\n", file);
+			}
+			else if (strcasecmp(arg, "HIST") == 0) {
+				char *file = get_token(NULL);
+
+				if (file == NULL)
+					mon_printf("Usage: PROF HIST file\n");
+				else if (!PROFILE_SaveHistogram(file))
+					mon_printf("Error writing %s\n", file);
+			}
+			else
+				mon_printf("Usage: PROF [ON|OFF|CLEAR|TOP [n]|SAVE file|HIST file]\n");
+		}
+#endif /* MONITOR_PROF */
+
 #ifdef MONITOR_PROFILE
 		else if (strcmp(t, "PROFILE") == 0) {
 			int i;
@@ -1923,6 +2269,8 @@ int MONITOR_monitorCmd(char *input)
 				mon_printf("B OFF - turn breakpoint table OFF\n");
 #endif
 				mon_printf("B OFF num1 num2 num3 - turn particular breakpoint OFF\n");
+				mon_printf("B BENCH - start measuring emulation speed\n");
+				mon_printf("B STAT - show emulation speed with current breakpoints\n");
 				mon_printf("B [num] cond1 cond2 cond3 ... - insert several breakpoints\n");
 				mon_printf("    (in num position in breakpoint table)\n");
 				mon_printf("  - Breakpoint will fire when all conditions are meet\n");
@@ -1955,6 +2303,32 @@ int MONITOR_monitorCmd(char *input)
 				}
 				else mon_printf("Error. Type B ? for help.\n");
 			}
+			else if (strcasecmp(arg, "BENCH") == 0) {
+				CPU_break_bench_time = 0.0;
+				CPU_break_bench_cycles = 0;
+				CPU_break_bench_insns = 0;
+				CPU_break_bench_checks = 0;
+				CPU_break_bench = TRUE;
+				mon_printf("Breakpoint speed measurement started\n");
+			}
+			else if (strcasecmp(arg, "STAT") == 0) {
+				int active = 0;
+
+				for (i=0; i<MONITOR_breakpoint_table_size; i++)
+					if (MONITOR_breakpoint_table[i].on && MONITOR_breakpoint_table[i].condition != MONITOR_BREAKPOINT_OR)
+						active++;
+				mon_printf("Active conditions: %d\n", active);
+				if (!CPU_break_bench || CPU_break_bench_time <= 0.0)
+					mon_printf("No measurement. Type B BENCH and continue emulation.\n");
+				else {
+					mon_printf("Emulated cycles/sec: %.0f\n",
+							   CPU_break_bench_cycles / CPU_break_bench_time);
+					if (CPU_break_bench_insns)
+						mon_printf("Instructions checked: %.3f%% of %llu\n",
+								   100.0 * CPU_break_bench_checks / CPU_break_bench_insns,
+								   (unsigned long long) CPU_break_bench_insns);
+				}
+			}
 			else if (strcasecmp(arg, "C") == 0) {
 				MONITOR_breakpoint_table_size=0;
 				BreakpointsControllerSetDirty();
@@ -2160,7 +2534,7 @@ int MONITOR_monitorCmd(char *input)
 						if (p != NULL) {
 							if (p->addr != addr) {
 								mon_printf("%s redefined (previous value: %04X)\n", name, p->addr);
-								p->addr = addr;
+								set_user_label_addr(p, addr);
 							}
 						}
 						else
@@ -2315,6 +2689,10 @@ int MONITOR_monitorCmd(char *input)
 #ifdef MONITOR_BREAK
 			mon_printf("BREAK [addr]                   - Set breakpoint at address\n");
 			mon_printf("YBREAK [pos], or [1000+pos]    - Break at scanline or flash scanline\n");
+#ifdef MEMORY_WATCHPOINTS
+			mon_printf("WATCH addr [R|W|RW|DMA] [bank] - Break after an access to addr\n");
+			mon_printf("WATCH [DEL n|CLEAR]            - List or delete watchpoints\n");
+#endif
 
  			mon_printf("BRKHERE [on|off]               - Set BRK opcode behaviour\n");
  			mon_printf("MONHIST [on|off]               - Turn monitor history keeping on/off\n");
@@ -2339,6 +2717,16 @@ int MONITOR_monitorCmd(char *input)
 #ifdef MONITOR_PROFILE
 			mon_printf("PROFILE                        - Display profiling statistics\n");
 #endif
+#ifdef MONITOR_TRACELOG
+			mon_printf("TRACELOG file [RAW]            - Stream every instruction to a file\n");
+			mon_printf("TRACELOG OFF                   - Stop the trace log\n");
+#endif
+#ifdef MONITOR_PROF
+			mon_printf("PROF [ON|OFF|CLEAR]            - Profile 6502 cycles per address and call\n");
+			mon_printf("PROF TOP [n]                   - List the n addresses with most cycles\n");
+			mon_printf("PROF SAVE file                 - Write call stacks for a flame graph\n");
+			mon_printf("PROF HIST file                 - Write cycles per address as CSV\n");
+#endif
 #ifdef MONITOR_HINTS
 			mon_printf("LABELS file                    - Load labels from file (xasm format)\n");
 #endif
@@ -14,6 +14,7 @@
 #include "atari.h"
 #include "bit3.h"
 #include "cfg.h"
+#include "cpu.h"
 #include "prompts.h"
 #include "input.h"
 #include "memory.h"
@@ -104,6 +105,14 @@ extern int joystick0Num, joystick1Num;
 extern int joystick2Num, joystick3Num;
 extern int paddlesXAxisOnly;
 extern int keyjoyEnable;
+extern int runahead_frames;
+extern int runahead_frames_arg;
+extern int idle_skip_arg;
+#ifdef SYNCHRONIZED_SOUND
+extern int sound_rate_control;
+extern int sound_rate_control_arg;
+#endif
+extern int threadedCore;
 extern int SDL_TRIG_0;
 extern int SDL_TRIG_0_B;
 extern int SDL_TRIG_0_R;
@@ -1399,6 +1408,17 @@ int loadMacPrefs(int firstTime)
     joystick3Num = prefs.joystick4Num;
     paddlesXAxisOnly  = prefs.paddlesXAxisOnly; 
 	keyjoyEnable = prefs.keyjoyEnable;
+	if (!runahead_frames_arg)
+		runahead_frames = prefs.runAheadFrames;
+	if (!idle_skip_arg)
+		CPU_idle_skip = prefs.idleSkip;
+#ifdef SYNCHRONIZED_SOUND
+	if (!sound_rate_control_arg)
+		sound_rate_control = prefs.soundRateControl;
+#endif
+	/* SDL_main starts the core thread once, before the first frame */
+	if (firstTime && prefs.threadedCore)
+		threadedCore = TRUE;
     INPUT_cx85 = prefs.cx85enabled;
 	cx85_port = prefs.cx85port;
 
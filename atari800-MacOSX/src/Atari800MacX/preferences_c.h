@@ -180,6 +180,10 @@ typedef struct ATARI800MACX_PREF {
 				int saveCurrentMedia;
 				int clearCurrentMedia;
 				int keyjoyEnable;
+				int runAheadFrames;
+				int idleSkip;
+				int threadedCore;
+				int soundRateControl;
 				double emulationSpeed;
                 int af80_enabled;
                 int bit3_enabled;
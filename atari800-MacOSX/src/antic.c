@@ -29,6 +29,7 @@
 #endif
 
 #include "antic.h"
+#include "antic_simd.h"
 #include "atari.h"
 #include "cpu.h"
 #include "gtia.h"
@@ -47,6 +48,18 @@
 #ifdef NEW_CYCLE_EXACT
 #include "cycle_map.h"
 #endif
+#ifdef BENCHMARK
+#include "bench.h"
+
+/* Time spent in the CPU is not ANTIC's */
+static void bench_CPU_GO(int limit)
+{
+	int prev = BENCH_Switch(BENCH_CPU);
+	CPU_GO(limit);
+	BENCH_Switch(prev);
+}
+#define CPU_GO bench_CPU_GO
+#endif
 
 #define LCHOP 3			/* do not build leftmost 0..3 characters in wide mode */
 #define RCHOP 3			/* do not build rightmost 0..3 characters in wide mode */
@@ -181,14 +194,37 @@ static UBYTE *scratchFillLimit;
 
 #define READ_VIDEO_LONG(ptr) (*(ptr))
 
+#ifdef DIRTYSPAN
+/* ANTIC_Frame finds the dirty spans of the scanlines it draws. Writes to
+   Screen_atari through these two functions add to the spans themselves. */
+static void mark_dirty_bytes(const UBYTE *ptr, ULONG size)
+{
+	ULONG offset = (ULONG) (ptr - (const UBYTE *) Screen_atari);
+	ULONG end = offset + size;
+	while (offset < end) {
+		int y = offset / Screen_WIDTH;
+		ULONG line_end = (y + 1) * Screen_WIDTH;
+		Screen_MarkDirtySpan(y, offset - y * Screen_WIDTH,
+		                     end < line_end ? end - y * Screen_WIDTH : Screen_WIDTH);
+		offset = line_end;
+	}
+}
+#endif /* DIRTYSPAN */
+
 void ANTIC_VideoMemset(UBYTE *ptr, UBYTE val, ULONG size)
 {
 	FILL_VIDEO(ptr, val, size);
+#ifdef DIRTYSPAN
+	mark_dirty_bytes(ptr, size);
+#endif
 }
 
 void ANTIC_VideoPutByte(UBYTE *ptr, UBYTE val)
 {
 	WRITE_VIDEO_BYTE(ptr, val);
+#ifdef DIRTYSPAN
+	mark_dirty_bytes(ptr, 1);
+#endif
 }
 
 
@@ -247,6 +283,44 @@ static UBYTE antic_memory[52];
    ------------------------------------------------------------------------ */
 
 static UWORD *scrn_ptr;
+
+#ifdef DIRTYSPAN
+/* The scanline at scrn_ptr as it was before it was drawn */
+static ULONG dirty_span_line[Screen_WIDTH / 4];
+static int dirty_span_y;
+
+static void dirty_span_begin(int y)
+{
+	dirty_span_y = y;
+	if (y < Screen_HEIGHT)
+		memcpy(dirty_span_line, scrn_ptr, Screen_WIDTH);
+}
+
+/* Adds the part of the scanline just drawn that differs from the copy to
+   its dirty span, while the line is still in the cache */
+static void dirty_span_end(void)
+{
+	const ULONG *line = (const ULONG *) scrn_ptr;
+	int left = 0;
+	int right = Screen_WIDTH / 4;
+	while (left < right && line[left] == dirty_span_line[left])
+		left++;
+	if (left == right)
+		return;
+	while (line[right - 1] == dirty_span_line[right - 1])
+		right--;
+	Screen_MarkDirtySpan(dirty_span_y, left * 4, right * 4);
+}
+
+/* Moves scrn_ptr to the next scanline */
+#define NEXT_SCANLINE do { \
+		dirty_span_end(); \
+		scrn_ptr += Screen_WIDTH / 2; \
+		dirty_span_begin(dirty_span_y + 1); \
+	} while (0)
+#else /* DIRTYSPAN */
+#define NEXT_SCANLINE (scrn_ptr += Screen_WIDTH / 2)
+#endif /* DIRTYSPAN */
 #endif /* !defined(BASIC) && !defined(CURSES_BASIC) */
 
 /* Separate access to XE extended memory ----------------------------------- */
@@ -621,6 +695,7 @@ UWORD ANTIC_cl[128];
 		WRITE_VIDEO_LONG_UNALIGNED(((ULONG *) ptr) + 1, background); \
 		ptr += 4; \
 	}
+#define BACKGROUND_WORD(colreg) ((UWORD) background)
 #define DRAW_ARTIF { \
 		WRITE_VIDEO_LONG_UNALIGNED((ULONG *) ptr, art_curtable[(UBYTE) (screendata_tally >> 10)]); \
 		WRITE_VIDEO_LONG_UNALIGNED(((ULONG *) ptr) + 1, art_curtable[(UBYTE) (screendata_tally >> 6)]); \
@@ -638,6 +713,7 @@ UWORD ANTIC_cl[128];
 		WRITE_VIDEO(ptr + 3, ANTIC_cl[colreg]); \
 		ptr += 4;\
 	}
+#define BACKGROUND_WORD(colreg) ANTIC_cl[colreg]
 #define DRAW_ARTIF {\
 		WRITE_VIDEO(ptr++, ((UWORD *) art_curtable)[(screendata_tally & 0x03fc00) >> 9]); \
 		WRITE_VIDEO(ptr++, ((UWORD *) art_curtable)[((screendata_tally & 0x03fc00) >> 9) + 1]); \
@@ -950,6 +1026,7 @@ int ANTIC_Initialise(int *argc, char *argv[])
 {
 #if !defined(BASIC) && !defined(CURSES_BASIC)
 	int i, j;
+	int simd = TRUE;
 
 	for (i = j = 1; i < *argc; i++) {
 		int i_a = (i + 1 < *argc);		/* is argument available? */
@@ -965,9 +1042,14 @@ int ANTIC_Initialise(int *argc, char *argv[])
 			}
 			else a_m = TRUE;
 		}
+		else if (strcmp(argv[i], "-no-simd") == 0)
+			simd = FALSE;
 		else {
 			if (strcmp(argv[i], "-help") == 0) {
 				Log_print("\t-artif <num>     Set artifacting mode 0-4 (0 = disable)");
+#ifdef ANTIC_SIMD
+				Log_print("\t-no-simd         Draw the playfield without the vector kernels");
+#endif
 			}
 			argv[j++] = argv[i];
 		}
@@ -979,6 +1061,9 @@ int ANTIC_Initialise(int *argc, char *argv[])
 	}
 	*argc = j;
 
+#ifdef ANTIC_SIMD
+	ANTIC_SIMD_Initialise(simd);
+#endif
 	ANTIC_UpdateArtifacting();
 
 	playfield_lookup[0x00] = L_BAK;
@@ -1491,16 +1576,62 @@ static void draw_an_gtia_bug(const ULONG *t_pm_scanline_ptr)
 
 #endif /* PAGED_MEM */
 
+#ifdef ANTIC_SIMD
+/* Draws the characters from the current one up to the next one overlapped
+   by PMG with the vector kernel, leaving the loop at the end of the line.
+   DATA are the bytes to expand for the current character onwards. */
+#define DRAW_SIMD_RUN(data, attrib) \
+	if (ANTIC_SIMD_enabled) {\
+		int n = ANTIC_SIMD_Draw(nchars, data, attrib, simd_colours, ptr, t_pm_scanline_ptr);\
+		antic_memptr += n;\
+		ptr += 4 * n;\
+		t_pm_scanline_ptr += n;\
+		nchars -= n;\
+		if (nchars == 0)\
+			break;\
+	}
+#define INIT_SIMD_COLOURS(c0, c1, c2, c3, c3_inverse, colreg) \
+	simd_colours[0] = c0;\
+	simd_colours[1] = c1;\
+	simd_colours[2] = c2;\
+	simd_colours[3] = c3;\
+	simd_colours[ANTIC_SIMD_COLOUR_INVERSE3] = c3_inverse;\
+	simd_colours[ANTIC_SIMD_COLOUR_BACKGROUND] = BACKGROUND_WORD(colreg);
+#endif
+
 static void draw_antic_2(int nchars, const UBYTE *antic_memptr, UWORD *ptr, const ULONG *t_pm_scanline_ptr)
 {
 	INIT_BACKGROUND_6
+#ifdef ANTIC_SIMD
+	UBYTE line_chdata[Screen_WIDTH / 8];
+	const UBYTE *line_start = antic_memptr;
+	UWORD simd_colours[ANTIC_SIMD_COLOURS];
+#endif
 	INIT_ANTIC_2
 	INIT_HIRES
 
+#ifdef ANTIC_SIMD
+	if (ANTIC_SIMD_enabled) {
+		int i;
+		for (i = 0; i < nchars; i++) {
+			UBYTE screendata = antic_memptr[i];
+			int chdata;
+
+			GET_CHDATA_ANTIC_2
+			line_chdata[i] = (UBYTE) chdata;
+		}
+		INIT_SIMD_COLOURS(hires_norm(0x00), hires_norm(0x04), hires_norm(0x08), hires_norm(0x0c), hires_norm(0x0c), C_PF2)
+	}
+#endif
+
 	CHAR_LOOP_BEGIN
-		UBYTE screendata = *antic_memptr++;
+		UBYTE screendata;
 		int chdata;
 
+#ifdef ANTIC_SIMD
+		DRAW_SIMD_RUN(line_chdata + (antic_memptr - line_start), NULL)
+#endif
+		screendata = *antic_memptr++;
 		GET_CHDATA_ANTIC_2
 		if (IS_ZERO_ULONG(t_pm_scanline_ptr)) {
 			if (chdata) {
@@ -1817,6 +1948,11 @@ static void draw_antic_2_gtia_bug(int nchars, const UBYTE *antic_memptr, UWORD *
 static void draw_antic_4(int nchars, const UBYTE *antic_memptr, UWORD *ptr, const ULONG *t_pm_scanline_ptr)
 {
 	INIT_BACKGROUND_8
+#ifdef ANTIC_SIMD
+	UBYTE line_chdata[Screen_WIDTH / 8];
+	const UBYTE *line_start = antic_memptr;
+	UWORD simd_colours[ANTIC_SIMD_COLOURS];
+#endif
 #ifdef PAGED_MEM
 	UWORD t_chbase = ((anticmode == 4 ? dctr : dctr >> 1) ^ chbase_20) & 0xfc07;
 #else
@@ -1836,10 +1972,27 @@ static void draw_antic_4(int nchars, const UBYTE *antic_memptr, UWORD *ptr, cons
 	lookup2[0xc0] = lookup2[0x30] = lookup2[0x0c] = lookup2[0x03] = ANTIC_cl[C_PF2];
 	lookup2[0xcf] = lookup2[0x3f] = lookup2[0x1b] = lookup2[0x12] = ANTIC_cl[C_PF3];
 
+#ifdef ANTIC_SIMD
+	if (ANTIC_SIMD_enabled) {
+		int i;
+		for (i = 0; i < nchars; i++)
+#ifdef PAGED_MEM
+			line_chdata[i] = MEMORY_dGetByte(t_chbase + ((UWORD) (antic_memptr[i] & 0x7f) << 3));
+#else
+			line_chdata[i] = chptr[(antic_memptr[i] & 0x7f) << 3];
+#endif
+		INIT_SIMD_COLOURS(lookup2[0x00], lookup2[0x01], lookup2[0x02], lookup2[0x03], lookup2[0x12], C_BAK)
+	}
+#endif
+
 	CHAR_LOOP_BEGIN
-		UBYTE screendata = *antic_memptr++;
+		UBYTE screendata;
 		const UWORD *lookup;
 		UBYTE chdata;
+#ifdef ANTIC_SIMD
+		DRAW_SIMD_RUN(line_chdata + (antic_memptr - line_start), antic_memptr)
+#endif
+		screendata = *antic_memptr++;
 		if (screendata & 0x80)
 			lookup = lookup2 + 0xf;
 		else
@@ -2226,13 +2379,23 @@ static void draw_antic_c(int nchars, const UBYTE *antic_memptr, UWORD *ptr, cons
 static void draw_antic_e(int nchars, const UBYTE *antic_memptr, UWORD *ptr, const ULONG *t_pm_scanline_ptr)
 {
 	INIT_BACKGROUND_8
+#ifdef ANTIC_SIMD
+	UWORD simd_colours[ANTIC_SIMD_COLOURS];
+#endif
 	lookup2[0x00] = ANTIC_cl[C_BAK];
 	lookup2[0x40] = lookup2[0x10] = lookup2[0x04] = lookup2[0x01] = ANTIC_cl[C_PF0];
 	lookup2[0x80] = lookup2[0x20] = lookup2[0x08] = lookup2[0x02] = ANTIC_cl[C_PF1];
 	lookup2[0xc0] = lookup2[0x30] = lookup2[0x0c] = lookup2[0x03] = ANTIC_cl[C_PF2];
+#ifdef ANTIC_SIMD
+	INIT_SIMD_COLOURS(lookup2[0x00], lookup2[0x01], lookup2[0x02], lookup2[0x03], lookup2[0x03], C_BAK)
+#endif
 
 	CHAR_LOOP_BEGIN
-		UBYTE screendata = *antic_memptr++;
+		UBYTE screendata;
+#ifdef ANTIC_SIMD
+		DRAW_SIMD_RUN(antic_memptr, NULL)
+#endif
+		screendata = *antic_memptr++;
 		if (IS_ZERO_ULONG(t_pm_scanline_ptr)) {
 			if (screendata) {
 				WRITE_VIDEO(ptr++, lookup2[screendata & 0xc0]);
@@ -2337,10 +2500,20 @@ static void draw_antic_e_gtia11 (int nchars, const UBYTE *antic_memptr, UWORD *p
 static void draw_antic_f(int nchars, const UBYTE *antic_memptr, UWORD *ptr, const ULONG *t_pm_scanline_ptr)
 {
 	INIT_BACKGROUND_6
+#ifdef ANTIC_SIMD
+	UWORD simd_colours[ANTIC_SIMD_COLOURS];
+#endif
 	INIT_HIRES
+#ifdef ANTIC_SIMD
+	INIT_SIMD_COLOURS(hires_norm(0x00), hires_norm(0x04), hires_norm(0x08), hires_norm(0x0c), hires_norm(0x0c), C_PF2)
+#endif
 
 	CHAR_LOOP_BEGIN
-		int screendata = *antic_memptr++;
+		int screendata;
+#ifdef ANTIC_SIMD
+		DRAW_SIMD_RUN(antic_memptr, NULL)
+#endif
+		screendata = *antic_memptr++;
 		if (IS_ZERO_ULONG(t_pm_scanline_ptr)) {
 			if (screendata) {
 				WRITE_VIDEO(ptr++, hires_norm(screendata & 0xc0));
@@ -2781,8 +2954,17 @@ UBYTE ANTIC_GetDLByte(UWORD *paddr)
 {
 	int addr = *paddr;
 	UBYTE result;
+#ifdef MEMORY_WATCHPOINTS
+	if (MEMORY_watch_dma)
+		MEMORY_WatchDMA((UWORD) addr, 1);
+#endif
 	if (ANTIC_xe_ptr != NULL && addr < 0x8000 && addr >= 0x4000)
 		result = ANTIC_xe_ptr[addr - 0x4000];
+#ifdef MEMORY_WATCHPOINTS
+	else if (MEMORY_attrib[addr] & MEMORY_WATCH)
+		/* a DMA fetch is not a CPU read */
+		result = MEMORY_SafeGetByte((UWORD) addr);
+#endif
 	else
 		result = MEMORY_GetByte((UWORD) addr);
 	addr++;
@@ -2808,6 +2990,10 @@ UWORD ANTIC_GetDLWord(UWORD *paddr)
    nor screen+47 in wide playfield. This function does. */
 static void antic_load(void)
 {
+#ifdef MEMORY_WATCHPOINTS
+	if (MEMORY_watch_dma)
+		MEMORY_WatchDMA(screenaddr, chars_read[md]);
+#endif
 #ifdef PAGED_MEM
 	UBYTE *antic_memptr = antic_memory + ANTIC_margin;
 	UWORD new_screenaddr = screenaddr + chars_read[md];
@@ -2889,6 +3075,10 @@ void ANTIC_Frame(int draw_display)
 	} while (ANTIC_ypos < 8);
 
 	scrn_ptr = (UWORD *) Screen_atari;
+#ifdef DIRTYSPAN
+	if (draw_display)
+		dirty_span_begin(0);
+#endif
 #ifdef NEW_CYCLE_EXACT
 	ANTIC_cur_screen_pos = ANTIC_NOT_DRAWING;
 #endif
@@ -3098,7 +3288,7 @@ void ANTIC_Frame(int draw_display)
 			UPDATE_GTIA_BUG;
 			ANTIC_cur_screen_pos = ANTIC_NOT_DRAWING;
 			YPOS_BREAK_FLICKER;
-			scrn_ptr += Screen_WIDTH / 2;
+			NEXT_SCANLINE;
 			if (no_jvb) {
 				dctr++;
 				dctr &= 0xf;
@@ -3125,7 +3315,7 @@ void ANTIC_Frame(int draw_display)
 			draw_antic_0_ptr();
 			GOEOL;
 			YPOS_BREAK_FLICKER;
-			scrn_ptr += Screen_WIDTH / 2;
+			NEXT_SCANLINE;
 			if (no_jvb) {
 				dctr++;
 				dctr &= 0xf;
@@ -3157,7 +3347,7 @@ void ANTIC_Frame(int draw_display)
 		GOEOL;
 #endif /* NEW_CYCLE_EXACT */
 		YPOS_BREAK_FLICKER;
-		scrn_ptr += Screen_WIDTH / 2;
+		NEXT_SCANLINE;
 		dctr++;
 		dctr &= 0xf;
 	} while (ANTIC_ypos < (Screen_HEIGHT + 8));
@@ -3190,6 +3380,11 @@ void ANTIC_Frame(int draw_display)
 			} while (--k);
 			ptr -= 2 * (LCHOP + RCHOP); /* Move one line up */
 		} while (--ypos > 8); /* Stop after line 9 */
+#ifdef DIRTYSPAN
+		/* the spans were found before blending with the line above */
+		if (draw_display)
+			Screen_EntireDirty();
+#endif
 	}
 #endif /* NO_SIMPLE_PAL_BLENDING */
 
@@ -0,0 +1,363 @@
+/*
+ * antic_simd.c - Vector kernels for the ANTIC playfield modes
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "config.h"
+#include <string.h>
+
+#include "antic_simd.h"
+
+#ifdef ANTIC_SIMD
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#ifdef __GNUC__
+#include <immintrin.h>
+#define DISPATCH_AVX2
+#endif
+#else
+#include <arm_neon.h>
+#endif
+
+/* Every kernel expands one pixel pair per 16 bit lane: the character byte
+   is repeated in 4 lanes, each masked to its field and compared with the
+   3 non-zero values of the field to select the colour. */
+
+int ANTIC_SIMD_enabled = FALSE;
+
+typedef int (*draw_function)(int nchars, const UBYTE *data, const UBYTE *attrib,
+                             const UWORD *colours, UWORD *ptr, const ULONG *pm);
+static draw_function draw = NULL;
+
+/* Draws the characters before the first one overlapped by PMG */
+static int DrawScalar(int nchars, const UBYTE *data, const UBYTE *attrib,
+                      const UWORD *colours, UWORD *ptr, const ULONG *pm)
+{
+	UWORD lookup[4];
+	int i;
+
+	memcpy(lookup, colours, sizeof(lookup));
+	for (i = 0; i < nchars; i++) {
+		ULONG pm_pixels;
+		int chdata = data[i];
+
+		memcpy(&pm_pixels, pm + i, sizeof(pm_pixels));
+		if (pm_pixels != 0)
+			break;
+		if (chdata == 0) {
+			ptr[0] = ptr[1] = ptr[2] = ptr[3] = colours[ANTIC_SIMD_COLOUR_BACKGROUND];
+		}
+		else {
+			if (attrib != NULL)
+				lookup[3] = colours[attrib[i] & 0x80 ? ANTIC_SIMD_COLOUR_INVERSE3 : 3];
+			ptr[0] = lookup[chdata >> 6];
+			ptr[1] = lookup[(chdata >> 4) & 3];
+			ptr[2] = lookup[(chdata >> 2) & 3];
+			ptr[3] = lookup[chdata & 3];
+		}
+		ptr += 4;
+	}
+	return i;
+}
+
+#ifdef __SSE2__
+
+typedef struct {
+	__m128i fields;			/* 0xc0, 0x30, 0x0c, 0x03 */
+	__m128i fields_1;		/* field value 1 in each lane */
+	__m128i fields_2;		/* field value 2 in each lane */
+	__m128i bit7;
+	__m128i zero;
+	/* colours as differences from colour 0, so they can be selected by
+	   xor of the masked compares */
+	__m128i c0;
+	__m128i d1;
+	__m128i d2;
+	__m128i d3;
+	__m128i d3_inverse;		/* colour 3 ^ inverse colour 3 */
+	__m128i d_background;
+} sse2_constants;
+
+static void InitSSE2(sse2_constants *k, const UWORD *colours)
+{
+	k->fields = _mm_set_epi16(0x03, 0x0c, 0x30, 0xc0, 0x03, 0x0c, 0x30, 0xc0);
+	k->fields_1 = _mm_set_epi16(0x01, 0x04, 0x10, 0x40, 0x01, 0x04, 0x10, 0x40);
+	k->fields_2 = _mm_set_epi16(0x02, 0x08, 0x20, 0x80, 0x02, 0x08, 0x20, 0x80);
+	k->bit7 = _mm_set1_epi16(0x80);
+	k->zero = _mm_setzero_si128();
+	k->c0 = _mm_set1_epi16((short) colours[0]);
+	k->d1 = _mm_set1_epi16((short) (colours[1] ^ colours[0]));
+	k->d2 = _mm_set1_epi16((short) (colours[2] ^ colours[0]));
+	k->d3 = _mm_set1_epi16((short) (colours[3] ^ colours[0]));
+	k->d3_inverse = _mm_set1_epi16((short) (colours[3] ^ colours[ANTIC_SIMD_COLOUR_INVERSE3]));
+	k->d_background = _mm_set1_epi16((short) (colours[ANTIC_SIMD_COLOUR_BACKGROUND] ^ colours[0]));
+}
+
+/* V holds 2 characters, 4 lanes each */
+static __m128i ExpandSSE2(const sse2_constants *k, __m128i v, __m128i d3)
+{
+	__m128i m = _mm_and_si128(v, k->fields);
+	__m128i out = _mm_xor_si128(k->c0, _mm_and_si128(_mm_cmpeq_epi16(m, k->fields_1), k->d1));
+	out = _mm_xor_si128(out, _mm_and_si128(_mm_cmpeq_epi16(m, k->fields_2), k->d2));
+	out = _mm_xor_si128(out, _mm_and_si128(_mm_cmpeq_epi16(m, k->fields), d3));
+	return _mm_xor_si128(out, _mm_and_si128(_mm_cmpeq_epi16(v, k->zero), k->d_background));
+}
+
+static __m128i InverseSSE2(const sse2_constants *k, __m128i attrib)
+{
+	__m128i inverse = _mm_cmpeq_epi16(_mm_and_si128(attrib, k->bit7), k->bit7);
+	return _mm_xor_si128(k->d3, _mm_and_si128(inverse, k->d3_inverse));
+}
+
+static int DrawSSE2(int nchars, const UBYTE *data, const UBYTE *attrib,
+                    const UWORD *colours, UWORD *ptr, const ULONG *pm)
+{
+	sse2_constants k;
+	int i;
+
+	InitSSE2(&k, colours);
+	for (i = 0; i + 4 <= nchars; i += 4) {
+		__m128i pm_pixels = _mm_loadu_si128((const __m128i *) (pm + i));
+		__m128i bytes;
+		__m128i d3_lo = k.d3;
+		__m128i d3_hi = k.d3;
+		ULONG quad;
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(pm_pixels, k.zero)) != 0xffff)
+			break;
+		if (attrib != NULL) {
+			memcpy(&quad, attrib + i, sizeof(quad));
+			bytes = _mm_cvtsi32_si128((int) quad);
+			bytes = _mm_unpacklo_epi8(bytes, bytes);
+			bytes = _mm_unpacklo_epi16(bytes, bytes);
+			d3_lo = InverseSSE2(&k, _mm_unpacklo_epi8(bytes, k.zero));
+			d3_hi = InverseSSE2(&k, _mm_unpackhi_epi8(bytes, k.zero));
+		}
+		memcpy(&quad, data + i, sizeof(quad));
+		bytes = _mm_cvtsi32_si128((int) quad);
+		bytes = _mm_unpacklo_epi8(bytes, bytes);
+		bytes = _mm_unpacklo_epi16(bytes, bytes);
+		_mm_storeu_si128((__m128i *) (ptr + 4 * i), ExpandSSE2(&k, _mm_unpacklo_epi8(bytes, k.zero), d3_lo));
+		_mm_storeu_si128((__m128i *) (ptr + 4 * i + 8), ExpandSSE2(&k, _mm_unpackhi_epi8(bytes, k.zero), d3_hi));
+	}
+	return i + DrawScalar(nchars - i, data + i, attrib == NULL ? NULL : attrib + i,
+	                      colours, ptr + 4 * i, pm + i);
+}
+
+#ifdef DISPATCH_AVX2
+
+#define AVX2 __attribute__((target("avx2")))
+
+typedef struct {
+	__m256i fields;
+	__m256i fields_1;
+	__m256i fields_2;
+	__m256i bit7;
+	__m256i zero;
+	__m256i c0;
+	__m256i d1;
+	__m256i d2;
+	__m256i d3;
+	__m256i d3_inverse;
+	__m256i d_background;
+} avx2_constants;
+
+AVX2 static void InitAVX2(avx2_constants *k, const UWORD *colours)
+{
+	k->fields = _mm256_set_epi16(0x03, 0x0c, 0x30, 0xc0, 0x03, 0x0c, 0x30, 0xc0,
+	                             0x03, 0x0c, 0x30, 0xc0, 0x03, 0x0c, 0x30, 0xc0);
+	k->fields_1 = _mm256_and_si256(k->fields, _mm256_set1_epi16(0x55));
+	k->fields_2 = _mm256_and_si256(k->fields, _mm256_set1_epi16(0xaa));
+	k->bit7 = _mm256_set1_epi16(0x80);
+	k->zero = _mm256_setzero_si256();
+	k->c0 = _mm256_set1_epi16((short) colours[0]);
+	k->d1 = _mm256_set1_epi16((short) (colours[1] ^ colours[0]));
+	k->d2 = _mm256_set1_epi16((short) (colours[2] ^ colours[0]));
+	k->d3 = _mm256_set1_epi16((short) (colours[3] ^ colours[0]));
+	k->d3_inverse = _mm256_set1_epi16((short) (colours[3] ^ colours[ANTIC_SIMD_COLOUR_INVERSE3]));
+	k->d_background = _mm256_set1_epi16((short) (colours[ANTIC_SIMD_COLOUR_BACKGROUND] ^ colours[0]));
+}
+
+/* V holds 4 characters */
+AVX2 static __m256i ExpandAVX2(const avx2_constants *k, __m256i v, __m256i d3)
+{
+	__m256i m = _mm256_and_si256(v, k->fields);
+	__m256i out = _mm256_xor_si256(k->c0, _mm256_and_si256(_mm256_cmpeq_epi16(m, k->fields_1), k->d1));
+	out = _mm256_xor_si256(out, _mm256_and_si256(_mm256_cmpeq_epi16(m, k->fields_2), k->d2));
+	out = _mm256_xor_si256(out, _mm256_and_si256(_mm256_cmpeq_epi16(m, k->fields), d3));
+	return _mm256_xor_si256(out, _mm256_and_si256(_mm256_cmpeq_epi16(v, k->zero), k->d_background));
+}
+
+AVX2 static __m256i InverseAVX2(const avx2_constants *k, __m256i attrib)
+{
+	__m256i inverse = _mm256_cmpeq_epi16(_mm256_and_si256(attrib, k->bit7), k->bit7);
+	return _mm256_xor_si256(k->d3, _mm256_and_si256(inverse, k->d3_inverse));
+}
+
+AVX2 static int DrawAVX2(int nchars, const UBYTE *data, const UBYTE *attrib,
+                         const UWORD *colours, UWORD *ptr, const ULONG *pm)
+{
+	avx2_constants k;
+	int i;
+
+	InitAVX2(&k, colours);
+	for (i = 0; i + 8 <= nchars; i += 8) {
+		__m256i pm_pixels = _mm256_loadu_si256((const __m256i *) (pm + i));
+		__m128i bytes;
+		__m256i d3_lo = k.d3;
+		__m256i d3_hi = k.d3;
+
+		if (!_mm256_testz_si256(pm_pixels, pm_pixels))
+			break;
+		if (attrib != NULL) {
+			bytes = _mm_loadl_epi64((const __m128i *) (attrib + i));
+			bytes = _mm_unpacklo_epi8(bytes, bytes);
+			d3_lo = InverseAVX2(&k, _mm256_cvtepu8_epi16(_mm_unpacklo_epi16(bytes, bytes)));
+			d3_hi = InverseAVX2(&k, _mm256_cvtepu8_epi16(_mm_unpackhi_epi16(bytes, bytes)));
+		}
+		bytes = _mm_loadl_epi64((const __m128i *) (data + i));
+		bytes = _mm_unpacklo_epi8(bytes, bytes);
+		_mm256_storeu_si256((__m256i *) (ptr + 4 * i),
+		                    ExpandAVX2(&k, _mm256_cvtepu8_epi16(_mm_unpacklo_epi16(bytes, bytes)), d3_lo));
+		_mm256_storeu_si256((__m256i *) (ptr + 4 * i + 16),
+		                    ExpandAVX2(&k, _mm256_cvtepu8_epi16(_mm_unpackhi_epi16(bytes, bytes)), d3_hi));
+	}
+	/* at most 7 characters are left, or the run has ended */
+	return i + DrawSSE2(nchars - i, data + i, attrib == NULL ? NULL : attrib + i,
+	                    colours, ptr + 4 * i, pm + i);
+}
+
+#endif /* DISPATCH_AVX2 */
+
+#else /* __SSE2__ */
+
+typedef struct {
+	uint16x8_t fields;
+	uint16x8_t fields_1;
+	uint16x8_t fields_2;
+	uint16x8_t bit7;
+	uint16x8_t c0;
+	uint16x8_t c1;
+	uint16x8_t c2;
+	uint16x8_t c3;
+	uint16x8_t c3_inverse;
+	uint16x8_t background;
+} neon_constants;
+
+static void InitNEON(neon_constants *k, const UWORD *colours)
+{
+	static const UWORD fields[8] = { 0xc0, 0x30, 0x0c, 0x03, 0xc0, 0x30, 0x0c, 0x03 };
+
+	k->fields = vld1q_u16(fields);
+	k->fields_1 = vandq_u16(k->fields, vdupq_n_u16(0x55));
+	k->fields_2 = vandq_u16(k->fields, vdupq_n_u16(0xaa));
+	k->bit7 = vdupq_n_u16(0x80);
+	k->c0 = vdupq_n_u16(colours[0]);
+	k->c1 = vdupq_n_u16(colours[1]);
+	k->c2 = vdupq_n_u16(colours[2]);
+	k->c3 = vdupq_n_u16(colours[3]);
+	k->c3_inverse = vdupq_n_u16(colours[ANTIC_SIMD_COLOUR_INVERSE3]);
+	k->background = vdupq_n_u16(colours[ANTIC_SIMD_COLOUR_BACKGROUND]);
+}
+
+/* V holds 2 characters */
+static uint16x8_t ExpandNEON(const neon_constants *k, uint16x8_t v, uint16x8_t c3)
+{
+	uint16x8_t m = vandq_u16(v, k->fields);
+	uint16x8_t out = vbslq_u16(vceqq_u16(m, k->fields_1), k->c1, k->c0);
+	out = vbslq_u16(vceqq_u16(m, k->fields_2), k->c2, out);
+	out = vbslq_u16(vceqq_u16(m, k->fields), c3, out);
+	return vbslq_u16(vceqzq_u16(v), k->background, out);
+}
+
+/* Repeats each of 8 bytes in 4 lanes of 4 vectors */
+static void SpreadNEON(const UBYTE *bytes, uint16x8_t *v)
+{
+	uint8x8_t x = vld1_u8(bytes);
+	uint8x8x2_t pairs = vzip_u8(x, x);
+	uint16x4x2_t lo = vzip_u16(vreinterpret_u16_u8(pairs.val[0]), vreinterpret_u16_u8(pairs.val[0]));
+	uint16x4x2_t hi = vzip_u16(vreinterpret_u16_u8(pairs.val[1]), vreinterpret_u16_u8(pairs.val[1]));
+
+	v[0] = vmovl_u8(vreinterpret_u8_u16(lo.val[0]));
+	v[1] = vmovl_u8(vreinterpret_u8_u16(lo.val[1]));
+	v[2] = vmovl_u8(vreinterpret_u8_u16(hi.val[0]));
+	v[3] = vmovl_u8(vreinterpret_u8_u16(hi.val[1]));
+}
+
+static int DrawNEON(int nchars, const UBYTE *data, const UBYTE *attrib,
+                    const UWORD *colours, UWORD *ptr, const ULONG *pm)
+{
+	neon_constants k;
+	int i;
+
+	InitNEON(&k, colours);
+	for (i = 0; i + 8 <= nchars; i += 8) {
+		uint32x4_t pm_pixels = vorrq_u32(vld1q_u32((const uint32_t *) (pm + i)),
+		                                 vld1q_u32((const uint32_t *) (pm + i + 4)));
+		uint16x8_t v[4];
+		uint16x8_t c3[4];
+		int j;
+
+		if (vmaxvq_u32(pm_pixels) != 0)
+			break;
+		if (attrib != NULL) {
+			SpreadNEON(attrib + i, c3);
+			for (j = 0; j < 4; j++)
+				c3[j] = vbslq_u16(vtstq_u16(c3[j], k.bit7), k.c3_inverse, k.c3);
+		}
+		else
+			c3[0] = c3[1] = c3[2] = c3[3] = k.c3;
+		SpreadNEON(data + i, v);
+		for (j = 0; j < 4; j++)
+			vst1q_u16(ptr + 4 * i + 8 * j, ExpandNEON(&k, v[j], c3[j]));
+	}
+	return i + DrawScalar(nchars - i, data + i, attrib == NULL ? NULL : attrib + i,
+	                      colours, ptr + 4 * i, pm + i);
+}
+
+#endif /* __SSE2__ */
+
+void ANTIC_SIMD_Initialise(int enable)
+{
+#ifdef __SSE2__
+	draw = DrawSSE2;
+#ifdef DISPATCH_AVX2
+	if (__builtin_cpu_supports("avx2"))
+		draw = DrawAVX2;
+#endif
+#else
+	draw = DrawNEON;
+#endif
+	ANTIC_SIMD_enabled = enable;
+}
+
+int ANTIC_SIMD_Draw(int nchars, const UBYTE *data, const UBYTE *attrib,
+                    const UWORD *colours, UWORD *ptr, const ULONG *pm)
+{
+	return draw(nchars, data, attrib, colours, ptr, pm);
+}
+
+#endif /* ANTIC_SIMD */
+
+/*
+vim:ts=4:sw=4:
+*/
@@ -0,0 +1,35 @@
+#ifndef ANTIC_SIMD_H_
+#define ANTIC_SIMD_H_
+
+#include "atari.h"
+
+/* Vector kernels for the playfield modes drawn with 2 bit fields
+   (ANTIC 2, 3, 4, 5, E and F). They draw the runs of characters that no
+   player or missile overlaps; antic.c draws the rest and stays the
+   reference. SSE2 (with AVX2 when the CPU has it) on x86-64, NEON on
+   arm64. Not used with DIRTYRECT, which must see every screen write. */
+#if !defined(DIRTYRECT) && (defined(__SSE2__) || (defined(__aarch64__) && defined(__ARM_NEON)))
+#define ANTIC_SIMD
+#endif
+
+#ifdef ANTIC_SIMD
+
+/* FALSE when disabled with -no-simd */
+extern int ANTIC_SIMD_enabled;
+
+/* Colours as 2-pixel words, as in the lookup tables of antic.c */
+#define ANTIC_SIMD_COLOUR_INVERSE3	4	/* field value 3 if ATTRIB bit 7 is set */
+#define ANTIC_SIMD_COLOUR_BACKGROUND	5	/* whole character when DATA is 0 */
+#define ANTIC_SIMD_COLOURS			6
+
+void ANTIC_SIMD_Initialise(int enable);
+
+/* Draws 4 pixel pairs for each byte of DATA, the 2 bit fields from the top
+   down as COLOURS[field]. ATTRIB may be NULL. Stops at the first character
+   whose PM ULONG is not 0 and returns the number of characters drawn. */
+int ANTIC_SIMD_Draw(int nchars, const UBYTE *data, const UBYTE *attrib,
+                    const UWORD *colours, UWORD *ptr, const ULONG *pm);
+
+#endif /* ANTIC_SIMD */
+
+#endif /* ANTIC_SIMD_H_ */
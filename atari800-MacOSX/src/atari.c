@@ -72,6 +72,7 @@ biteme!
 #include "akey.h"
 #include "antic.h"
 #include "atari.h"
+#include "bench.h"
 #include "binload.h"
 #include "bit3.h"
 #include "cartridge.h"
@@ -85,12 +86,20 @@ biteme!
 #include "log.h"
 #include "memory.h"
 #include "monitor.h"
+#include "movie.h"
 #include "pia.h"
 #include "pclink.h"
 #include "platform.h"
 #include "pokey.h"
+#ifdef MONITOR_PROF
+#include "profile.h"
+#endif
 #include "rtime.h"
+#ifdef MONITOR_TRACELOG
+#include "tracelog.h"
+#endif
 #include "pbi.h"
+#include "rewind.h"
 #include "sio.h"
 #include "side2.h"
 #include "ui.h"
@@ -108,6 +117,9 @@ void MacSoundReset(void);
 void MacCapsLockStateReset(void);
 int MediaManagerCartSelect(int nbytes);
 int Atari_Help_Key_Pressed();
+/* Set by -idleskip and -noidleskip, which then win over the IdleSkip
+   preference of the Mac front end */
+int idle_skip_arg = FALSE;
 #if defined(SOUND) && !defined(__PLUS)
 #include "pokeysnd.h"
 #include "sndsave.h"
@@ -153,6 +165,7 @@ int Atari800_builtin_game = FALSE;
 int Atari800_keyboard_detached = FALSE;
 
 int Atari800_display_screen = FALSE;
+int Atari800_turbo = FALSE;
 int Atari800_nframes = 0;
 int Atari800_refresh_rate = 1;
 int Atari800_collisions_in_skipped_frames = FALSE;
@@ -165,6 +178,7 @@ int emuos_mode = 1;	/* 0 = never use EmuOS, 1 = use EmuOS if real OS not availab
 
 void Atari800_Warmstart(void)
 {
+	MOVIE_Event(MOVIE_EVENT_WARMSTART);
 #ifdef MACOSX
 	MacCapsLockStateReset();
     if (XEP80_enabled)
@@ -212,6 +226,7 @@ void Atari800_Warmstart(void)
 
 void Atari800_Coldstart(void)
 {
+	MOVIE_Event(MOVIE_EVENT_COLDSTART);
 #ifdef MACOSX
 	ANTIC_screenline_cpu_clock = 0;
 	MacSoundReset();
@@ -231,6 +246,8 @@ void Atari800_Coldstart(void)
 	   because Reset routine vector must be read from OS ROM */
 	CPU_Reset();
     CARTRIDGE_ColdStart();
+    /* snapshots from before a cold start may be of another machine */
+    REWIND_Reset();
     /* set Atari OS Coldstart flag */
     MEMORY_dPutByte(0x244, 1);
     /* handle Option key (disable BASIC in XL/XE)
@@ -582,6 +599,14 @@ int Atari800_Initialise(int *argc, char *argv[])
 			else if (strcmp(argv[i], "-axlon0f") == 0) {
 				MEMORY_axlon_0f_mirror = TRUE;
 			}
+			else if (strcmp(argv[i], "-idleskip") == 0) {
+				CPU_idle_skip = TRUE;
+				idle_skip_arg = TRUE;
+			}
+			else if (strcmp(argv[i], "-noidleskip") == 0) {
+				CPU_idle_skip = FALSE;
+				idle_skip_arg = TRUE;
+			}
 #ifndef BASIC
 			/* The BASIC version does not support state files, because:
 			   1. It has no ability to save state files, because of lack of UI.
@@ -643,6 +668,8 @@ int Atari800_Initialise(int *argc, char *argv[])
 					Log_print("\t-c               Enable RAM between 0xc000 and 0xcfff in Atari 800");
 					Log_print("\t-axlon <n>       Use Atari 800 Axlon memory expansion: <n> k total RAM");
 					Log_print("\t-axlon0f         Use Axlon shadow at 0x0fc0-0x0fff");
+					Log_print("\t-idleskip        Skip side effect free busy-wait loops");
+					Log_print("\t-noidleskip      Run busy-wait loops instruction by instruction");
 					Log_print("\t-mosaic <n>      Use 400/800 Mosaic memory expansion: <n> k total RAM");
 #ifdef R_IO_DEVICE
 					Log_print("\t-rdevice [<dev>] Enable R: emulation (using serial device <dev>)");
@@ -679,6 +706,11 @@ int Atari800_Initialise(int *argc, char *argv[])
 	Devices_Initialise(argc, argv);
 	RTIME_Initialise(argc, argv);
 	SIO_Initialise (argc, argv);
+	REWIND_Initialise(argc, argv);
+	MOVIE_Initialise(argc, argv);
+#ifdef MONITOR_TRACELOG
+	TRACELOG_Initialise(argc, argv);
+#endif
 	CASSETTE_Initialise(argc, argv);
 	PBI_Initialise(argc,argv);
 	INPUT_Initialise(argc, argv);
@@ -810,6 +842,14 @@ int Atari800_Exit(int run_monitor)
 
 	restart = PLATFORM_Exit(run_monitor);
 	if (!restart) {
+		MOVIE_Exit();
+		REWIND_Exit();
+#ifdef MONITOR_PROF
+		PROFILE_Exit();
+#endif
+#ifdef MONITOR_TRACELOG
+		TRACELOG_Exit();
+#endif
 		SIO_Exit();	/* umount disks, so temporary files are deleted */
 		INPUT_Exit();	/* finish event recording */
 #ifdef R_IO_DEVICE
@@ -902,13 +942,20 @@ void Atari800_Frame(void)
 #ifdef PBI_XLD
 	PBI_XLD_VFrame(); /* for the Votrax */
 #endif
+	BENCH_SECTION(BENCH_SIO);
 	Devices_Frame();
+	SIO_Frame();
+	BENCH_SECTION(BENCH_OTHER);
 	INPUT_Frame();
+	MOVIE_StartFrame();
 	GTIA_Frame();
 
 	if (++refresh_counter >= Atari800_refresh_rate) {
 		refresh_counter = 0;
+		BENCH_SECTION(BENCH_ANTIC);
 		ANTIC_Frame(TRUE);
+		BENCH_SECTION(BENCH_OTHER);
+		MOVIE_EndFrame();
 		INPUT_DrawMousePointer();
 		Screen_DrawAtariSpeed(Atari_time());
         Screen_DrawDiskLED();
@@ -916,16 +963,23 @@ void Atari800_Frame(void)
 		Atari800_display_screen = TRUE;
 	}
 	else {
+		BENCH_SECTION(BENCH_ANTIC);
 		ANTIC_Frame(Atari800_collisions_in_skipped_frames);
+		BENCH_SECTION(BENCH_OTHER);
+		MOVIE_EndFrame();
 		Atari800_display_screen = FALSE;
 	}
+	BENCH_SECTION(BENCH_POKEY);
 	POKEY_Frame();
 #ifdef SOUND
 	Sound_Update();
 #endif
+	BENCH_SECTION(BENCH_OTHER);
 	Atari800_nframes++;
+	REWIND_Frame();
 
-    Atari800_Sync();
+	if (!Atari800_turbo)
+		Atari800_Sync();
 }
 
 void Atari800_SetTVMode(int mode)
@@ -959,6 +1013,11 @@ void Atari800_StateSave(void)
 
 void Atari800_StateRead(UBYTE version)
 {
+    /* what load_roms puts in MEMORY_os depends on */
+    int old_machine_type = Atari800_machine_type;
+    int old_builtin_game = Atari800_builtin_game;
+    int old_keyboard_leds = Atari800_keyboard_leds;
+
     if (version >= 7) {
         UBYTE temp;
         StateSav_ReadUBYTE(&temp, 1);
@@ -1055,7 +1114,14 @@ void Atari800_StateRead(UBYTE version)
         StateSav_ReadINT(&default_system, 1);
         Atari800_SetMachineType(Atari800_machine_type);
     }
-    load_roms();
+    /* A rewind or run-ahead snapshot restores the machine it was taken
+       from, whose ROMs are in place. Reloading them would read the ROM
+       files on every restore and undo writes to flash ROMs. */
+    if (!StateSav_IsMemorySnapshot()
+        || Atari800_machine_type != old_machine_type
+        || Atari800_builtin_game != old_builtin_game
+        || Atari800_keyboard_leds != old_keyboard_leds)
+        load_roms();
     /* XXX: what about patches? */
 }
 
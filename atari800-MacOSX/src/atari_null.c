@@ -0,0 +1,481 @@
+/*
+ * atari_null.c - Headless port code, for benchmarks and automated runs
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/* There is no window and no audio device, but the screen is converted and
+   the sound is rendered each frame as a real port would, so that -bench
+   measures the whole emulation. */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "akey.h"
+#include "atari.h"
+#include "bench.h"
+#include "input.h"
+#include "log.h"
+#include "monitor.h"
+#include "platform.h"
+#include "screen.h"
+#include "util.h"
+#ifdef SOUND
+#include "mzpokeysnd.h"
+#include "pokeysnd.h"
+#include "sound.h"
+#endif
+#ifdef ATARI800MACX
+#include <stdint.h>
+#include <stdio.h>
+#include "cartridge.h"
+#include "img_disk.h"
+/* The palette of mac_colours.c */
+extern int colortable[256];
+#define Colours_table colortable
+#else
+#include "colours.h"
+#endif
+
+/* The screen converted to 32-bit pixels, as a true colour port would */
+static ULONG display[Screen_HEIGHT * Screen_WIDTH];
+/* The RGB565 surface and streaming texture of -bench-display rows and
+   surface, which the Mac port converted through before it drew ARGB8888 */
+static UWORD surface[Screen_HEIGHT * Screen_WIDTH];
+static UWORD texture16[Screen_HEIGHT * Screen_WIDTH];
+static UWORD palette16[256];
+static int palette16_made = FALSE;
+
+#ifdef SOUND
+#define SAMPLE_RATE 44100
+#ifndef SYNCHRONIZED_SOUND
+/* One frame of 8-bit mono samples, thrown away */
+static UBYTE sound_buffer[SAMPLE_RATE / 49];
+#endif
+#endif
+
+void PLATFORM_Initialise(int *argc, char *argv[])
+{
+	BENCH_Initialise(argc, argv);
+#ifdef SOUND
+	POKEYSND_Init(POKEYSND_FREQ_17_EXACT, SAMPLE_RATE, 1, 0);
+#endif
+}
+
+int PLATFORM_Exit(int run_monitor)
+{
+	Log_flushlog();
+
+#ifndef ATARI800MACX
+	if (run_monitor && MONITOR_Run())
+		return TRUE;
+#endif
+
+	return FALSE;
+}
+
+int PLATFORM_Keyboard(void)
+{
+	return AKEY_NONE;
+}
+
+/* Converts rows first to last of the visible screen to the RGB565 surface */
+static void ConvertToSurface(int first, int last)
+{
+	const UBYTE *src = (const UBYTE *) Screen_atari + first * Screen_WIDTH;
+	UWORD *dest = surface + first * Screen_WIDTH;
+	int y;
+
+	if (!palette16_made) {
+		int i;
+		for (i = 0; i < 256; i++)
+			palette16[i] = (UWORD) ((Colours_table[i] >> 8 & 0xf800)
+			                        | (Colours_table[i] >> 5 & 0x07e0)
+			                        | (Colours_table[i] >> 3 & 0x001f));
+		palette16_made = TRUE;
+	}
+	for (y = first; y <= last; y++) {
+		int x;
+		for (x = 24; x < 360; x++)
+			dest[x] = palette16[src[x]];
+		src += Screen_WIDTH;
+		dest += Screen_WIDTH;
+	}
+}
+
+/* The Mac port before the streaming texture: the whole surface each frame,
+   converted again to ARGB8888 by a texture made and thrown away for it */
+static void DisplaySurface(void)
+{
+	ULONG *texture = (ULONG *) Util_malloc(sizeof(display));
+	int i;
+
+	ConvertToSurface(0, Screen_HEIGHT - 1);
+	for (i = 0; i < Screen_HEIGHT * Screen_WIDTH; i++) {
+		UWORD c = surface[i];
+		texture[i] = 0xff000000 | (c & 0xf800) << 8 | (c & 0x07e0) << 5 | (c & 0x001f) << 3;
+	}
+	free(texture);
+	BENCH_display_pixels += (double) Screen_HEIGHT * 336;
+}
+
+/* The streaming texture: whole redrawn rows through the surface */
+static void DisplayRows(int first, int last)
+{
+	if (first > last)
+		return;
+	ConvertToSurface(first, last);
+	memcpy(texture16 + first * Screen_WIDTH, surface + first * Screen_WIDTH,
+	       (last - first + 1) * Screen_WIDTH * sizeof(UWORD));
+	BENCH_display_pixels += (double) (last - first + 1) * 336;
+}
+
+/* The direct ARGB8888 path: the box around the dirty spans, straight into
+   the texture */
+static void DisplayARGB8888(int first, int last, int left, int right)
+{
+	const UBYTE *src = (const UBYTE *) Screen_atari + first * Screen_WIDTH;
+	ULONG *dest = display + first * Screen_WIDTH;
+	int y;
+
+	if (first > last || left >= right)
+		return;
+	BENCH_display_pixels += (double) (last - first + 1) * (right - left);
+	for (y = first; y <= last; y++) {
+		int x;
+		for (x = left; x < right; x++)
+			dest[x] = Colours_table[src[x]];
+		src += Screen_WIDTH;
+		dest += Screen_WIDTH;
+	}
+}
+
+void PLATFORM_DisplayScreen(void)
+{
+	int first = 0;
+	int last = Screen_HEIGHT - 1;
+	int left = 24;
+	int right = 360;
+
+#ifdef DIRTYSPAN
+	{
+		int y;
+
+		left = Screen_WIDTH;
+		right = 0;
+		first = Screen_HEIGHT;
+		last = -1;
+		for (y = 0; y < Screen_HEIGHT; y++) {
+			if (Screen_dirty_left[y] >= Screen_dirty_right[y])
+				continue;
+			if (first > y)
+				first = y;
+			last = y;
+			if (left > Screen_dirty_left[y])
+				left = Screen_dirty_left[y];
+			if (right < Screen_dirty_right[y])
+				right = Screen_dirty_right[y];
+		}
+		Screen_ClearDirtySpans();
+		if (left < 24)
+			left = 24;
+		if (right > 360)
+			right = 360;
+	}
+#endif
+	switch (BENCH_display_path) {
+	case BENCH_DISPLAY_SURFACE:
+		DisplaySurface();
+		break;
+	case BENCH_DISPLAY_ROWS:
+		DisplayRows(first, last);
+		break;
+	default:
+		DisplayARGB8888(first, last, left, right);
+		break;
+	}
+}
+
+int PLATFORM_PORT(int num)
+{
+	return 0xff;
+}
+
+int PLATFORM_TRIG(int num)
+{
+	return 1;
+}
+
+#ifdef SYNCHRONIZED_SOUND
+double PLATFORM_AdjustSpeed(void)
+{
+	return 1.0;
+}
+#endif
+
+#ifdef SOUND
+
+#ifndef ATARI800MACX
+/* The Mac core has these in mac_screen.c */
+void Sound_Pause(void)
+{
+}
+
+void Sound_Continue(void)
+{
+}
+#endif
+
+void Sound_Update(void)
+{
+#ifdef SYNCHRONIZED_SOUND
+	/* as the Mac front end does, so the POKEY time is what it pays */
+	MZPOKEYSND_UpdateProcessBuffer();
+#else
+	POKEYSND_Process(sound_buffer, Atari800_tv_mode == Atari800_TV_PAL
+	                               ? SAMPLE_RATE / 50 : SAMPLE_RATE / 60);
+#endif
+}
+
+void Sound_Reinit(void)
+{
+}
+
+#endif /* SOUND */
+
+#ifdef ATARI800MACX
+
+/* The Mac core calls back into its Cocoa front end. A headless build has
+   none, so these stand in for it. pclink.c, img_vhd.c and capslock.c need
+   clang, CoreFoundation and IOKit, so there is no PCLink and no VHD image
+   support either. */
+
+int PLATFORM_80col = FALSE;
+int currPrinter = 0;
+int speed_limit = FALSE;
+int requestLimitChange = 0;
+double emulationSpeed = 1.0;
+double sound_volume = 1.0;
+int helpFunctionPressed = FALSE;
+int fujinet_enabled = FALSE;
+int PCLink_Enabled = FALSE;
+char atari_print_dir[FILENAME_MAX];
+
+void PLATFORM_Switch80Col(void)
+{
+}
+
+int Atari_Help_Key_Pressed(void)
+{
+	return FALSE;
+}
+
+void CreateWindowCaption(void)
+{
+}
+
+void loadMacPrefs(int firstTime)
+{
+}
+
+void MacSoundReset(void)
+{
+}
+
+void MacCapsLockStateReset(void)
+{
+}
+
+void SetDisplayManagerDisableAF80(void)
+{
+}
+
+void SetDisplayManagerDisableBit3(void)
+{
+}
+
+void PrintOutputControllerPrintChar(char character)
+{
+}
+
+int MediaManagerCartSelect(int nbytes)
+{
+	/* the first type that fits, as for an unknown image */
+	return CARTRIDGE_NONE;
+}
+
+int MediaManagerDirtyCartridgeSave(CARTRIDGE_image_t *cart)
+{
+	return 0;
+}
+
+/* Where Log_print ends up */
+void ControlManagerMessagePrint(char *string)
+{
+	fputs(string, stdout);
+}
+
+void ControlManagerDualError(char *error1, char *error2)
+{
+	printf("%s\n%s\n", error1, error2);
+}
+
+int ControlManagerMonitorPrintf(const char *format, ...)
+{
+	return 0;
+}
+
+void ControlManagerMonitorSetLabelsDirty(void)
+{
+}
+
+void BreakpointsControllerSetDirty(void)
+{
+}
+
+int BreakpointsControllerGetBreakpointNumForConditionNum(int num)
+{
+	return 0;
+}
+
+void NSBeep(void)
+{
+}
+
+void Link_Device_Init(void)
+{
+}
+
+void Link_Device_Cold_Reset(void)
+{
+}
+
+int Link_Device_WriteFrame(char *data)
+{
+	return 'N';
+}
+
+UBYTE Link_Device_On_Serial_Begin_Command(UBYTE *commandFrame, int *read,
+                                          int *ExpectedBytes, char *buffer)
+{
+	return 'N';
+}
+
+void *VHD_Image_Open(const char *path, int write, int solidState)
+{
+	return NULL;
+}
+
+void VHD_Image_Close(void *img)
+{
+}
+
+int VHD_Is_Read_Only(void *img)
+{
+	return TRUE;
+}
+
+void VHD_Read_Sectors(void *img, void *data, uint32_t lba, uint32_t n)
+{
+}
+
+void VHD_Write_Sectors(void *img, const void *data, uint32_t lba, uint32_t n)
+{
+}
+
+void VHD_Flush(void *img)
+{
+}
+
+uint32_t VHD_Get_Serial_Number(void *img)
+{
+	return 0;
+}
+
+uint32_t VHD_Get_Sector_Count(void *img)
+{
+	return 0;
+}
+
+BlockDeviceGeometry *VHD_Get_Geometry(void *img)
+{
+	return NULL;
+}
+
+#endif /* ATARI800MACX */
+
+int main(int argc, char **argv)
+{
+	/* initialise Atari800 core */
+	if (!Atari800_Initialise(&argc, argv))
+		return 3;
+
+	if (BENCH_bank_switches > 0) {
+		BENCH_Banks();
+		Atari800_Exit(FALSE);
+		return 0;
+	}
+	if (BENCH_simd_frames > 0) {
+		int ok = BENCH_CheckSIMD();
+
+		Atari800_Exit(FALSE);
+		return ok ? 0 : 1;
+	}
+	if (BENCH_netsio_commands > 0) {
+		int ok = BENCH_NetSIO();
+
+		Atari800_Exit(FALSE);
+		return ok ? 0 : 1;
+	}
+	if (BENCH_pokey_seconds > 0) {
+		BENCH_Pokey();
+		Atari800_Exit(FALSE);
+		return 0;
+	}
+	if (BENCH_frames > 0)
+		BENCH_Start();
+
+	/* main loop */
+	for (;;) {
+		INPUT_key_code = PLATFORM_Keyboard();
+		Atari800_Frame();
+		if (Atari800_display_screen) {
+			double start = BENCH_Now();
+
+			BENCH_SECTION(BENCH_DISPLAY);
+			PLATFORM_DisplayScreen();
+			BENCH_SECTION(BENCH_OTHER);
+			BENCH_display_time += BENCH_Now() - start;
+		}
+		if (BENCH_runahead_frames > 0)
+			BENCH_RunAhead();
+		if (BENCH_frames > 0 && !BENCH_Frame())
+			break;
+	}
+
+	BENCH_Report();
+	Atari800_Exit(FALSE);
+	return 0;
+}
+
+/*
+vim:ts=4:sw=4:
+*/
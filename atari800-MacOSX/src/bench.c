@@ -0,0 +1,233 @@
+/*
+ * bench.c - headless benchmark with a per-subsystem time breakdown
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "antic.h"
+#include "atari.h"
+#include "bench.h"
+#include "cpu.h"
+#include "log.h"
+#include "screen.h"
+#include "util.h"
+
+int BENCH_frames = 0;
+int BENCH_display_path = BENCH_DISPLAY_ARGB;
+double BENCH_display_pixels = 0.0;
+double BENCH_display_time = 0.0;
+
+static const char * const display_path_names[] = { "argb", "rows", "surface" };
+
+static int frame = 0;
+static double start_time;
+static uint64_t start_idle_cycles;
+
+#ifdef BENCHMARK
+static const char * const section_names[BENCH_SECTIONS] = {
+	"other", "CPU", "ANTIC", "POKEY", "SIO/devices", "display"
+};
+static double section_time[BENCH_SECTIONS];
+static int current = BENCH_OTHER;
+static double last_switch;
+#endif
+
+/* gettimeofday is too coarse for timing single CPU_GO calls */
+double BENCH_Now(void)
+{
+#if defined(_POSIX_TIMERS) && _POSIX_TIMERS > 0 && defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+#else
+	return Util_time();
+#endif
+}
+
+int BENCH_Initialise(int *argc, char *argv[])
+{
+	int i;
+	int j;
+
+	for (i = j = 1; i < *argc; i++) {
+		int i_a = (i + 1 < *argc);		/* is argument available? */
+		int a_m = FALSE;			/* error, argument missing! */
+
+		if (strcmp(argv[i], "-bench") == 0) {
+			if (i_a)
+				BENCH_frames = Util_sscandec(argv[++i]);
+			else a_m = TRUE;
+		}
+		else if (strcmp(argv[i], "-bench-display") == 0) {
+			if (i_a) {
+				int k;
+
+				i++;
+				for (k = 0; k < (int) (sizeof(display_path_names) / sizeof(display_path_names[0])); k++)
+					if (strcmp(argv[i], display_path_names[k]) == 0)
+						break;
+				if (k == (int) (sizeof(display_path_names) / sizeof(display_path_names[0]))) {
+					Log_print("Invalid -bench-display path '%s'", argv[i]);
+					return FALSE;
+				}
+				BENCH_display_path = k;
+			}
+			else a_m = TRUE;
+		}
+		else if (strcmp(argv[i], "-bench-runahead") == 0) {
+			if (i_a)
+				BENCH_runahead_frames = Util_sscandec(argv[++i]);
+			else a_m = TRUE;
+		}
+		else if (strcmp(argv[i], "-bench-banks") == 0) {
+			if (i_a)
+				BENCH_bank_switches = Util_sscandec(argv[++i]);
+			else a_m = TRUE;
+		}
+		else if (strcmp(argv[i], "-bench-simd") == 0) {
+			if (i_a)
+				BENCH_simd_frames = Util_sscandec(argv[++i]);
+			else a_m = TRUE;
+		}
+		else if (strcmp(argv[i], "-bench-pokey") == 0) {
+			if (i_a)
+				BENCH_pokey_seconds = Util_sscandec(argv[++i]);
+			else a_m = TRUE;
+		}
+		else if (strcmp(argv[i], "-bench-netsio") == 0) {
+			if (i_a)
+				BENCH_netsio_commands = Util_sscandec(argv[++i]);
+			else a_m = TRUE;
+		}
+		else {
+			if (strcmp(argv[i], "-help") == 0) {
+				Log_print("\t-bench <frames>  Run n frames at full speed and report the frame rate");
+				Log_print("\t-bench-display argb|rows|surface With -bench, convert the screen as the Mac port's");
+				Log_print("\t                 direct ARGB8888 path, its redrawn rows or its whole 16 bpp surface");
+				Log_print("\t-bench-runahead <n> With -bench, run n frames ahead after each frame");
+				Log_print("\t-bench-banks <n> Time n bank switches of each kind and report the rate");
+				Log_print("\t-bench-simd <n>  Check n frames drawn with the ANTIC vector kernels against the scalar code");
+				Log_print("\t-bench-pokey <s> Record s seconds of POKEY writes and time rendering them");
+				Log_print("\t-bench-netsio <n> Time n NetSIO command frames to a loopback FujiNet");
+			}
+			argv[j++] = argv[i];
+		}
+
+		if (a_m) {
+			Log_print("Missing argument for '%s'", argv[i]);
+			return FALSE;
+		}
+	}
+	*argc = j;
+
+	if (BENCH_frames < 0)
+		BENCH_frames = 0;
+	if (BENCH_runahead_frames < 0)
+		BENCH_runahead_frames = 0;
+	if (BENCH_bank_switches < 0)
+		BENCH_bank_switches = 0;
+	if (BENCH_simd_frames < 0)
+		BENCH_simd_frames = 0;
+	if (BENCH_pokey_seconds < 0)
+		BENCH_pokey_seconds = 0;
+	if (BENCH_netsio_commands < 0)
+		BENCH_netsio_commands = 0;
+
+	return TRUE;
+}
+
+#ifdef BENCHMARK
+int BENCH_Switch(int section)
+{
+	double now = BENCH_Now();
+	int prev = current;
+
+	section_time[current] += now - last_switch;
+	last_switch = now;
+	current = section;
+	return prev;
+}
+#endif
+
+void BENCH_Start(void)
+{
+	Atari800_turbo = TRUE;
+	frame = 0;
+	start_time = BENCH_Now();
+	start_idle_cycles = CPU_idle_skipped_cycles;
+	BENCH_display_pixels = 0.0;
+	BENCH_display_time = 0.0;
+	BENCH_RunAheadStart();
+#ifdef BENCHMARK
+	memset(section_time, 0, sizeof(section_time));
+	current = BENCH_OTHER;
+	last_switch = start_time;
+#endif
+}
+
+int BENCH_Frame(void)
+{
+	return ++frame < BENCH_frames;
+}
+
+void BENCH_Report(void)
+{
+	double total = BENCH_Now() - start_time;
+	double fps = Atari800_tv_mode == Atari800_TV_PAL ? Atari800_FPS_PAL : Atari800_FPS_NTSC;
+#ifdef BENCHMARK
+	int i;
+#endif
+
+	if (total <= 0.0)
+		total = 1e-9;
+	Log_print("Benchmark: %d frames in %.3f s, %.1f frames/s (%.1fx real time)",
+	          frame, total, frame / total, frame / total / fps);
+	if (CPU_idle_skip && frame > 0)
+		Log_print("  idle loops: %.1f%% of the cycles skipped",
+		          (CPU_idle_skipped_cycles - start_idle_cycles) * 100.0
+		          / ((double) frame * Atari800_tv_mode * ANTIC_LINE_C));
+	if (frame > 0)
+		Log_print("  display (%s): %.0f of %d pixels/frame converted (%.1f%%), %.2f us/frame",
+		          display_path_names[BENCH_display_path],
+		          BENCH_display_pixels / frame, Screen_HEIGHT * 336,
+		          BENCH_display_pixels * 100.0 / ((double) frame * Screen_HEIGHT * 336),
+		          BENCH_display_time * 1e6 / frame);
+	BENCH_RunAheadReport();
+#ifdef BENCHMARK
+	BENCH_Switch(BENCH_OTHER);
+	for (i = 0; i < BENCH_SECTIONS; i++)
+		Log_print("  %-12s %8.3f s %5.1f%% %8.1f us/frame", section_names[i], section_time[i],
+		          section_time[i] * 100.0 / total, frame > 0 ? section_time[i] * 1e6 / frame : 0.0);
+#else
+	Log_print("  (build with BENCHMARK defined for the time spent in each subsystem)");
+#endif
+	Log_flushlog();
+}
+
+/*
+vim:ts=4:sw=4:
+*/
@@ -0,0 +1,95 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include "atari.h"
+
+/* Headless benchmark: runs the emulation for BENCH_frames frames without
+   a speed limit, then reports the frame rate. Builds with BENCHMARK
+   defined also report the time spent in each subsystem. */
+
+enum {
+	BENCH_OTHER,
+	BENCH_CPU,
+	BENCH_ANTIC,
+	BENCH_POKEY,
+	BENCH_SIO,
+	BENCH_DISPLAY,
+	BENCH_SECTIONS
+};
+
+/* Frames to run, 0 if not benchmarking */
+extern int BENCH_frames;
+/* How PLATFORM_DisplayScreen converts the screen, chosen with
+   -bench-display: the Mac port's direct ARGB8888 path, its redrawn rows
+   through an RGB565 surface, or the whole surface each frame as before
+   the streaming texture */
+enum {
+	BENCH_DISPLAY_ARGB,
+	BENCH_DISPLAY_ROWS,
+	BENCH_DISPLAY_SURFACE
+};
+extern int BENCH_display_path;
+/* Pixels converted by PLATFORM_DisplayScreen since BENCH_Start */
+extern double BENCH_display_pixels;
+/* Seconds spent in PLATFORM_DisplayScreen since BENCH_Start */
+extern double BENCH_display_time;
+
+int BENCH_Initialise(int *argc, char *argv[]);
+/* Seconds from a monotonic clock */
+double BENCH_Now(void);
+void BENCH_Start(void);
+/* Called after each frame, returns FALSE after the last one */
+int BENCH_Frame(void);
+void BENCH_Report(void);
+
+/* The fixtures of the other subsystems live with the tests in util/ */
+
+/* util/runaheadbench.c: frames to run ahead after each benchmark frame
+   with -bench-runahead */
+extern int BENCH_runahead_frames;
+void BENCH_RunAheadStart(void);
+/* Runs BENCH_runahead_frames frames ahead and goes back, as the Mac
+   front end's run-ahead does after each frame, and times it */
+void BENCH_RunAhead(void);
+void BENCH_RunAheadReport(void);
+
+/* util/bankbench.c: bank switches to time with -bench-banks, 0 if not
+   timing them */
+extern int BENCH_bank_switches;
+/* Times BENCH_bank_switches switches of each kind of banked memory the
+   machine has, instead of running frames */
+void BENCH_Banks(void);
+
+/* util/anticbench.c: frames to draw both with and without the ANTIC vector
+   kernels with -bench-simd, 0 if not checking them */
+extern int BENCH_simd_frames;
+/* Draws BENCH_simd_frames frames of a test screen in every mode the
+   ANTIC vector kernels draw, once with the kernels and once without, and
+   compares the two byte for byte. Returns FALSE if any frame differed. */
+int BENCH_CheckSIMD(void);
+
+/* util/pokeysndbench.c: seconds of sound to render with -bench-pokey, 0 if
+   not timing it */
+extern int BENCH_pokey_seconds;
+/* Records the POKEY writes of BENCH_pokey_seconds of emulation, then
+   times rendering them to sound with one and with two POKEYs */
+void BENCH_Pokey(void);
+
+/* util/netsiobench.c: NetSIO command frames to time with -bench-netsio, 0
+   if not timing them */
+extern int BENCH_netsio_commands;
+/* Sends BENCH_netsio_commands command frames through NetSIO to a stand-in
+   FujiNet on the loopback interface and reports the turnaround times.
+   Returns FALSE if the frames did not get through or were too slow. */
+int BENCH_NetSIO(void);
+
+#ifdef BENCHMARK
+/* Charges the time since the last switch to the current section and
+   makes section the current one. Returns the previous section. */
+int BENCH_Switch(int section);
+#define BENCH_SECTION(section) BENCH_Switch(section)
+#else
+#define BENCH_SECTION(section) ((void) 0)
+#endif
+
+#endif /* BENCH_H_ */
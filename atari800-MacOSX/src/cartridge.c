@@ -2387,8 +2387,13 @@ void CARTRIDGE_StateRead(UBYTE version)
 	if (saved_type != CARTRIDGE_NONE) {
 		StateSav_ReadFNAME(filename);
 		if (filename[0]) {
+			/* A snapshot taken in this session refers to the cartridge
+			   that is still inserted - don't load it again */
+			if (StateSav_IsMemorySnapshot() && CARTRIDGE_main.type != CARTRIDGE_NONE
+			    && strcmp(filename, CARTRIDGE_main.filename) == 0)
+				CARTRIDGE_main.type = saved_type;
 			/* Insert the cartridge... */
-			if (CARTRIDGE_Insert(filename) >= 0) {
+			else if (CARTRIDGE_Insert(filename) >= 0) {
 				/* And set the type to the saved type, in case it was a raw cartridge image */
 				CARTRIDGE_main.type = saved_type;
 			}
@@ -2407,8 +2412,11 @@ void CARTRIDGE_StateRead(UBYTE version)
 		StateSav_ReadINT(&saved_type, 1);
 		StateSav_ReadFNAME(filename);
 		if (filename[0]) {
+			if (StateSav_IsMemorySnapshot() && CARTRIDGE_piggyback.type != CARTRIDGE_NONE
+			    && strcmp(filename, CARTRIDGE_piggyback.filename) == 0)
+				CARTRIDGE_piggyback.type = saved_type;
 			/* Insert the cartridge... */
-			if (CARTRIDGE_Insert_Second(filename) >= 0) {
+			else if (CARTRIDGE_Insert_Second(filename) >= 0) {
 				/* And set the type to the saved type, in case it was a raw cartridge image */
 				CARTRIDGE_piggyback.type = saved_type;
 			}
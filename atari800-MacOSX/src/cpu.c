@@ -58,6 +58,7 @@
 #include "config.h"
 #include <stdio.h>
 #include <stdlib.h>	/* exit() */
+#include <string.h>	/* memcmp() */
 
 #include "cpu.h"
 #ifdef ASAP /* external project, see http://asap.sf.net */
@@ -69,6 +70,15 @@
 #include "memory.h"
 #include "monitor.h"
 #include "emuio.h"
+#ifdef MONITOR_PROF
+#include "profile.h"
+#endif
+#ifdef MONITOR_TRACELOG
+#include "tracelog.h"
+#endif
+#ifdef MACOSX
+#include "util.h"
+#endif
 #ifndef BASIC
 #include "statesav.h"
 #ifndef __PLUS
@@ -167,7 +177,13 @@ void CPU_PutStatus(void)
 			ANTIC_xpos++; \
 		} \
 	} else \
-		x = MEMORY_dGetByte(addr);
+		RMW_GetRAMByte(x, addr);
+#ifdef MEMORY_WATCHPOINTS
+#define RMW_GetRAMByte(x, addr) \
+	x = (MEMORY_attrib[addr] & MEMORY_WATCH) ? MEMORY_TrapGetByte(addr, FALSE) : MEMORY_dGetByte(addr)
+#else
+#define RMW_GetRAMByte(x, addr) x = MEMORY_dGetByte(addr)
+#endif
 #else /* PAGED_ATTRIB */
 #define RMW_GetByte(x, addr) \
 	x = MEMORY_GetByte(addr); \
@@ -255,6 +271,15 @@ unsigned int CPU_remember_jmp_curpos = 0;
 #define INC_RET_NESTING
 #endif /* MONITOR_BREAK */
 
+/* Tell the profiler about calls and returns, S is the new stack pointer */
+#ifdef MONITOR_PROF
+#define PROFILE_CALL(target)	do { if (PROFILE_active) PROFILE_Call(target, S); } while (0)
+#define PROFILE_RETURN			do { if (PROFILE_active) PROFILE_Return(S); } while (0)
+#else
+#define PROFILE_CALL(target)
+#define PROFILE_RETURN
+#endif
+
 #ifdef MACOSX
 #ifdef MONITOR_BREAKPOINTS
 int CPU_hit_breakpoint = FALSE;
@@ -277,6 +302,43 @@ static int (*CheckBreakFuncs[16])() =
 CheckBreak4, CheckBreak5, CheckBreak6, CheckBreak7,
 CheckBreak8, CheckBreakDefault, CheckBreakDefault, CheckBreakDefault,
 CheckBreakDefault, CheckBreakDefault, CheckBreakDefault, CheckBreakDefault,};
+
+/* Breakpoint index. CheckBreak() walks the whole breakpoint table, so it is
+   only called for instructions which the index says could fire:
+   - groups containing PC=addr are gated by a 64K bitmap of addresses,
+   - groups containing READ/WRITE/ACCESS=addr by a 256 entry page trap map,
+   - all other groups are compiled into a list of simple predicates. */
+typedef struct {
+	UBYTE kind;
+	UBYTE op;
+	UWORD addr;
+	UBYTE val;
+} break_pred;
+#define BREAK_PRED_END    0
+#define BREAK_PRED_FLAG   1
+#define BREAK_PRED_PC     2
+#define BREAK_PRED_A      3
+#define BREAK_PRED_X      4
+#define BREAK_PRED_Y      5
+#define BREAK_PRED_S      6
+#define BREAK_PRED_MEM    7
+#define BREAK_PRED_ACCESS 8
+static UBYTE break_pc_map[0x10000 >> 3];
+static UBYTE break_page_map[256];
+static UBYTE break_page_types;
+static break_pred break_preds[2 * MONITOR_BREAKPOINT_TABLE_MAX];
+static int break_pred_count;
+static int break_always;
+static MONITOR_breakpoint_cond break_index_table[MONITOR_BREAKPOINT_TABLE_MAX];
+static int break_index_size = -1;
+static void UpdateBreakIndex(void);
+static int CheckBreakIndex(UBYTE insn);
+
+int CPU_break_bench = FALSE;
+double CPU_break_bench_time;
+uint64_t CPU_break_bench_cycles;
+uint64_t CPU_break_bench_insns;
+uint64_t CPU_break_bench_checks;
 #endif /* MONITOR_BREAKPOINTS */
 #endif /* MACOSX */
 
@@ -358,6 +420,8 @@ CheckBreakDefault, CheckBreakDefault, CheckBreakDefault, CheckBreakDefault,};
 		if ((addr ^ GET_PC()) & 0xff00) \
 			ANTIC_xpos++; \
 		ANTIC_xpos++; \
+		if (CPU_idle_skip && addr <= (UWORD) (GET_PC() - 2)) \
+			IdleLoop(addr, (UWORD) (GET_PC() - 2), A, X, Y, S); \
 		SET_PC(addr); \
 		DONE \
 	} \
@@ -382,6 +446,7 @@ void CPU_NMI(void)
 	CPU_regS = S;
 	ANTIC_xpos += 7; /* handling an interrupt by 6502 takes 7 cycles */
 	INC_RET_NESTING;
+	PROFILE_CALL(CPU_regPC);
 }
 
 /* Check pending IRQ, helps in (not only) Lucasfilm games */
@@ -393,8 +458,18 @@ void CPU_NMI(void)
 		SET_PC(MEMORY_dGetWordAligned(0xfffe)); \
 		ANTIC_xpos += 7; \
 		INC_RET_NESTING; \
+		PROFILE_CALL(GET_PC()); \
 	}
 
+#if defined(MACOSX) && defined(MONITOR_BREAKPOINTS)
+/* the breakpoint table may have been edited in the monitor */
+#define BREAK_INDEX_REFRESH \
+	if (MONITOR_breakpoint_table_size && MONITOR_breakpoints_enabled) \
+		UpdateBreakIndex();
+#else
+#define BREAK_INDEX_REFRESH
+#endif
+
 /* Enter monitor */
 #ifdef __PLUS
 #define ENTER_MONITOR  Atari800_Exit(TRUE)
@@ -407,7 +482,8 @@ void CPU_NMI(void)
 	ENTER_MONITOR; \
     CPU_hit_breakpoint = TRUE; \
 	CPU_PutStatus(); \
-	UPDATE_LOCAL_REGS;
+	UPDATE_LOCAL_REGS; \
+	BREAK_INDEX_REFRESH;
 
 
 /*	0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F */
@@ -438,6 +514,335 @@ static const int cycles[256] =
 	2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7		/* Fx */
 };
 
+/* Idle loop skipping.
+   When a jump back to the head of a short loop is taken twice in a row
+   with the same registers, the loop is run once more in IdleLoopPeriod,
+   on copies of the registers. If that pass only reads memory that cannot
+   change before CPU_GO returns, writes nothing and ends at the head with
+   the same registers, every further pass is the same, and ANTIC_xpos is
+   moved forward by whole passes up to the limit. Interrupts are only
+   taken at the start of CPU_GO or after CLI/PLP/RTI, none of which can be
+   in such a loop, and ANTIC raises NMIs between calls to CPU_GO. */
+int CPU_idle_skip = FALSE;
+uint64_t CPU_idle_skipped_cycles = 0;
+
+/* Longest loop considered, in bytes and instructions */
+#define IDLE_MAX_LENGTH 32
+#define IDLE_MAX_INSNS  16
+
+static int idle_head = -1;
+static UWORD idle_end;
+static UBYTE idle_A, idle_X, idle_Y, idle_N, idle_Z, idle_C;
+#ifndef NO_V_FLAG_VARIABLE
+static UBYTE idle_V;
+#endif
+
+/* Reads a byte that cannot change during CPU_GO, returns FALSE if addr
+   is not such a byte */
+static int IdleRead(UWORD addr, UBYTE *data)
+{
+#ifdef PAGED_ATTRIB
+	return FALSE;
+#else
+	switch (MEMORY_attrib[addr]) {
+	case MEMORY_RAM:
+	case MEMORY_ROM:
+		*data = MEMORY_dGetByte(addr);
+		return TRUE;
+	case MEMORY_HARDWARE:
+		/* VCOUNT and NMIST only change between calls to CPU_GO */
+		if ((addr & 0xff0f) == 0xd40b || (addr & 0xff0f) == 0xd40f) {
+			*data = ANTIC_GetByte(addr, TRUE);
+			return TRUE;
+		}
+		return FALSE;
+	default:
+		return FALSE;
+	}
+#endif
+}
+
+/* Runs one pass of the loop from head to the jump at end with the given
+   registers. Returns the cycles it takes, or 0 if the pass is not a side
+   effect free repeat. *insn_cycles gets the cycles counted in
+   CPU_cycle_count, which leaves out the extra cycles of branches and page
+   crossings. */
+static int IdleLoopPeriod(UWORD head, UWORD end, UBYTE A, UBYTE X, UBYTE Y, UBYTE S, int *insn_cycles)
+{
+	UBYTE n = N;
+	UBYTE z = Z;
+	UBYTE c = C;
+#ifndef NO_V_FLAG_VARIABLE
+	UBYTE v = V;
+#endif
+	UWORD pc = head;
+	UWORD addr = 0;
+	int period = 0;
+	int count = 0;
+	int insns;
+
+	*insn_cycles = 0;
+	for (insns = 0; insns < IDLE_MAX_INSNS; insns++) {
+		UBYTE insn;
+		UBYTE data = 0;
+		int taken = FALSE;
+
+		if (pc > end)
+			return 0;
+#ifndef PAGED_ATTRIB
+		if (MEMORY_attrib[pc] == MEMORY_HARDWARE || MEMORY_attrib[(UWORD) (pc + 2)] == MEMORY_HARDWARE)
+			return 0;
+#endif
+		insn = MEMORY_dGetByte(pc);
+		period += cycles[insn];
+		count += cycles[insn];
+		switch (insn) {
+		/* implied */
+		case 0xea:				/* NOP */
+			break;
+		case 0xaa:				/* TAX */
+			z = n = X = A;
+			break;
+		case 0xa8:				/* TAY */
+			z = n = Y = A;
+			break;
+		case 0x8a:				/* TXA */
+			z = n = A = X;
+			break;
+		case 0x98:				/* TYA */
+			z = n = A = Y;
+			break;
+		case 0xba:				/* TSX */
+			z = n = X = S;
+			break;
+		case 0x18:				/* CLC */
+			c = 0;
+			break;
+		case 0x38:				/* SEC */
+			c = 1;
+			break;
+#ifndef NO_V_FLAG_VARIABLE
+		case 0xb8:				/* CLV */
+			v = 0;
+			break;
+#endif
+		default:
+			goto operand;
+		}
+		pc++;
+		continue;
+
+	operand:
+		switch (insn) {
+		/* immediate */
+		case 0xa9: case 0xa2: case 0xa0: case 0xc9: case 0xe0: case 0xc0:
+		case 0x29: case 0x09: case 0x49:
+			data = MEMORY_dGetByte((UWORD) (pc + 1));
+			pc += 2;
+			break;
+		/* zero page */
+		case 0xa5: case 0xa6: case 0xa4: case 0xc5: case 0xe4: case 0xc4:
+		case 0x25: case 0x05: case 0x45: case 0x24:
+			data = MEMORY_dGetByte(MEMORY_dGetByte((UWORD) (pc + 1)));
+			pc += 2;
+			break;
+		/* absolute */
+		case 0xad: case 0xae: case 0xac: case 0xcd: case 0xec: case 0xcc:
+		case 0x2d: case 0x0d: case 0x4d: case 0x2c:
+			addr = MEMORY_dGetWord((UWORD) (pc + 1));
+			if (!IdleRead(addr, &data))
+				return 0;
+			pc += 3;
+			break;
+		/* absolute,X and absolute,Y loads and compares */
+		case 0xbd: case 0xdd:
+		case 0xb9: case 0xd9:
+			addr = MEMORY_dGetWord((UWORD) (pc + 1));
+			addr += (insn & 0x04) ? X : Y;
+			if ((UBYTE) addr < ((insn & 0x04) ? X : Y))
+				period++;
+			if (!IdleRead(addr, &data))
+				return 0;
+			pc += 3;
+			break;
+		/* branches */
+		case 0x10: case 0x30: case 0x50: case 0x70:
+		case 0x90: case 0xb0: case 0xd0: case 0xf0:
+			addr = (UWORD) (pc + 2 + (SBYTE) MEMORY_dGetByte((UWORD) (pc + 1)));
+			switch (insn >> 6) {
+			case 0:
+				taken = (n & 0x80) != 0;
+				break;
+			case 1:
+#ifndef NO_V_FLAG_VARIABLE
+				taken = v != 0;
+				break;
+#else
+				return 0;
+#endif
+			case 2:
+				taken = c != 0;
+				break;
+			default:
+				taken = z == 0;
+				break;
+			}
+			if (insn & 0x20)
+				; /* branch if set */
+			else
+				taken = !taken;
+			if (taken) {
+				period++;
+				if ((addr ^ (pc + 2)) & 0xff00)
+					period++;
+				if (pc == end)
+					goto loop_end;
+				/* only forward branches inside the loop */
+				if (addr <= pc || addr > end)
+					return 0;
+				pc = addr;
+			}
+			else {
+				if (pc == end)
+					return 0;
+				pc += 2;
+			}
+			continue;
+		case 0x4c:				/* JMP abcd */
+			if (pc != end)
+				return 0;
+			addr = MEMORY_dGetWord((UWORD) (pc + 1));
+			goto loop_end;
+		default:
+			return 0;
+		}
+
+		switch (insn & 0xe3) {
+		case 0xa1:				/* LDA */
+			z = n = A = data;
+			break;
+		case 0xa2:				/* LDX */
+			z = n = X = data;
+			break;
+		case 0xa0:				/* LDY */
+			z = n = Y = data;
+			break;
+		case 0xc1:				/* CMP */
+			z = n = A - data;
+			c = (A >= data);
+			break;
+		case 0xe0:				/* CPX */
+			z = n = X - data;
+			c = (X >= data);
+			break;
+		case 0xc0:				/* CPY */
+			z = n = Y - data;
+			c = (Y >= data);
+			break;
+		case 0x21:				/* AND */
+			z = n = A &= data;
+			break;
+		case 0x01:				/* ORA */
+			z = n = A |= data;
+			break;
+		case 0x41:				/* EOR */
+			z = n = A ^= data;
+			break;
+		case 0x20:				/* BIT */
+#ifndef NO_V_FLAG_VARIABLE
+			n = data;
+			v = data & 0x40;
+			z = A & data;
+			break;
+#else
+			return 0;
+#endif
+		default:
+			return 0;
+		}
+	}
+	return 0;
+
+loop_end:
+	if (addr != head)
+		return 0;
+	if (A != idle_A || X != idle_X || Y != idle_Y || n != idle_N || z != idle_Z || c != idle_C)
+		return 0;
+#ifndef NO_V_FLAG_VARIABLE
+	if (v != idle_V)
+		return 0;
+#endif
+	*insn_cycles = count;
+	return period;
+}
+
+/* Called when a jump from end back to head has been taken */
+static void IdleLoop(UWORD head, UWORD end, UBYTE A, UBYTE X, UBYTE Y, UBYTE S)
+{
+	int period;
+	int insn_cycles;
+	int passes;
+
+#ifdef MONITOR_BREAK
+	if (MONITOR_break_step || MONITOR_histon)
+		return;
+#endif
+#ifdef MONITOR_TRACE
+	if (MONITOR_tron)
+		return;
+#endif
+#ifdef MONITOR_BREAKPOINTS
+	if (MONITOR_breakpoint_table_size && MONITOR_breakpoints_enabled)
+		return;
+#endif
+#ifdef MONITOR_PROFILE
+	return;
+#endif
+#ifdef MONITOR_TRACELOG
+	if (TRACELOG_active)
+		return;
+#endif
+#ifdef MONITOR_PROF
+	if (PROFILE_active)
+		return;
+#endif
+	if (end - head > IDLE_MAX_LENGTH) {
+		idle_head = -1;
+		return;
+	}
+	if (idle_head != head || idle_end != end || A != idle_A || X != idle_X || Y != idle_Y
+	    || N != idle_N || Z != idle_Z || C != idle_C
+#ifndef NO_V_FLAG_VARIABLE
+	    || V != idle_V
+#endif
+	    ) {
+		idle_head = head;
+		idle_end = end;
+		idle_A = A;
+		idle_X = X;
+		idle_Y = Y;
+		idle_N = N;
+		idle_Z = Z;
+		idle_C = C;
+#ifndef NO_V_FLAG_VARIABLE
+		idle_V = V;
+#endif
+		return;
+	}
+
+	idle_head = -1;
+	period = IdleLoopPeriod(head, end, A, X, Y, S, &insn_cycles);
+	if (period <= 0)
+		return;
+	/* stop short of the limit, the last pass is run as usual */
+	passes = (ANTIC_xpos_limit - 1 - ANTIC_xpos) / period;
+	if (passes <= 0)
+		return;
+	ANTIC_xpos += passes * period;
+	CPU_cycle_count += (uint64_t) passes * insn_cycles;
+	CPU_idle_skipped_cycles += passes * period;
+}
+
 /* 6502 emulation routine */
 #ifndef NO_GOTO
 __extension__ /* suppress -ansi -pedantic warnings */
@@ -553,6 +958,16 @@ void CPU_GO(int limit)
 	UWORD addr;
 	UBYTE data;
 #define insn data
+#if defined(MACOSX) && defined(MONITOR_BREAKPOINTS)
+	double bench_time = 0.0;
+	uint64_t bench_cycles = 0;
+#endif
+#ifdef MONITOR_PROF
+	/* the instruction being profiled */
+	UWORD profile_pc = 0;
+	int profile_xpos = 0;
+	int profile_node = 0;
+#endif
 
 /*
    This used to be in the main loop but has been removed to improve
@@ -597,6 +1012,15 @@ void CPU_GO(int limit)
 		ANTIC_wsync_halt = 0;
 	}
 	ANTIC_xpos_limit = limit;			/* needed for WSYNC store inside ANTIC */
+	idle_head = -1;						/* a loop can not span calls */
+
+#if defined(MACOSX) && defined(MONITOR_BREAKPOINTS)
+	if (CPU_break_bench) {
+		bench_time = Util_time();
+		bench_cycles = CPU_cycle_count;
+	}
+	BREAK_INDEX_REFRESH;
+#endif
 
 	UPDATE_LOCAL_REGS;
 
@@ -706,6 +1130,34 @@ void CPU_GO(int limit)
 		MEMORY_mem[0x10000] = MEMORY_mem[0];
 #endif
 
+#ifdef MONITOR_TRACELOG
+		if (TRACELOG_active) {
+			TRACELOG_record *r = TRACELOG_next;
+			r->pc = GET_PC();
+			r->opcode = MEMORY_dGetByte(r->pc);
+			r->has_addr = (MONITOR_optype6502[r->opcode] & 0x0c) != 0;
+			r->a = A;
+			r->x = X;
+			r->y = Y;
+			r->s = S;
+#ifndef NO_V_FLAG_VARIABLE
+			r->p = (N & 0x80) + (V ? 0x40 : 0) + (CPU_regP & 0x3c) + ((Z == 0) ? 0x02 : 0) + C;
+#else
+			r->p = (N & 0x80) + (CPU_regP & 0x7c) + ((Z == 0) ? 0x02 : 0) + C;
+#endif
+			r->ypos = (UWORD) ANTIC_ypos;
+			r->xpos = (UBYTE) ANTIC_xpos;
+		}
+#endif
+
+#ifdef MONITOR_PROF
+		if (PROFILE_active) {
+			profile_pc = GET_PC();
+			profile_xpos = ANTIC_xpos;
+			profile_node = PROFILE_node;
+		}
+#endif
+
 		insn = GET_CODE_BYTE();
 
 #ifdef MONITOR_BREAKPOINTS
@@ -715,7 +1167,7 @@ void CPU_GO(int limit)
 					check_break_addr = addr;
 					check_break_insn = insn;
 					UPDATE_GLOBAL_REGS;
-					if ((*CheckBreakFuncs[MONITOR_optype6502[insn]>>4])())
+					if (CheckBreakIndex(insn) && (*CheckBreakFuncs[MONITOR_optype6502[insn]>>4])())
 					{
 						/* fire breakpoint */
 						PC--;
@@ -927,6 +1379,7 @@ void CPU_GO(int limit)
 			CPU_SetI;
 			SET_PC(MEMORY_dGetWordAligned(0xfffe));
 			INC_RET_NESTING;
+			PROFILE_CALL(GET_PC());
 		}
 		DONE
 
@@ -1117,6 +1570,7 @@ void CPU_GO(int limit)
 			PHW(retaddr);
 		}
 		SET_PC(OP_WORD);
+		PROFILE_CALL(GET_PC());
 		DONE
 
 	OPCODE(21)				/* AND (ab,x) */
@@ -1291,6 +1745,7 @@ void CPU_GO(int limit)
 		PLP;
 		data = PL;
 		SET_PC((PL << 8) + data);
+		PROFILE_RETURN;
 		CPUCHECKIRQ;
 #ifdef MONITOR_BREAK
 		if (MONITOR_break_ret && --MONITOR_ret_nesting <= 0)
@@ -1363,6 +1818,8 @@ void CPU_GO(int limit)
 		CPU_remember_JMP[CPU_remember_jmp_curpos] = GET_PC() - 1;
 		CPU_remember_jmp_curpos = (CPU_remember_jmp_curpos + 1) % CPU_REMEMBER_JMP_STEPS;
 #endif
+		if (CPU_idle_skip && OP_WORD <= (UWORD) (GET_PC() - 1))
+			IdleLoop(OP_WORD, (UWORD) (GET_PC() - 1), A, X, Y, S);
 		SET_PC(OP_WORD);
 		DONE
 
@@ -1456,6 +1913,7 @@ void CPU_GO(int limit)
 	OPCODE(60)				/* RTS */
 		data = PL;
 		SET_PC((PL << 8) + data + 1);
+		PROFILE_RETURN;
 #ifdef MONITOR_BREAK
 		if (MONITOR_break_ret && --MONITOR_ret_nesting <= 0)
 			MONITOR_break_step = TRUE;
@@ -2308,6 +2766,7 @@ void CPU_GO(int limit)
 		UPDATE_LOCAL_REGS;
 		data = PL;
 		SET_PC((PL << 8) + data + 1);
+		PROFILE_RETURN;
 #ifdef MONITOR_BREAK
 		if (MONITOR_break_ret && --MONITOR_ret_nesting <= 0)
 			MONITOR_break_step = TRUE;
@@ -2456,6 +2915,18 @@ void CPU_GO(int limit)
 	next:
 #endif
 
+#ifdef MONITOR_PROF
+		if (PROFILE_active)
+			PROFILE_Instruction(profile_pc, profile_node, ANTIC_xpos - profile_xpos);
+#endif
+#ifdef MONITOR_TRACELOG
+		if (TRACELOG_active) {
+			TRACELOG_next->addr = addr;
+			if (++TRACELOG_next == TRACELOG_end)
+				TRACELOG_Flush();
+		}
+#endif
+
 #ifdef MONITOR_PROFILE
 		{
 			int cyc = ANTIC_xpos - old_xpos;
@@ -2476,6 +2947,13 @@ void CPU_GO(int limit)
 	}
 
 	UPDATE_GLOBAL_REGS;
+
+#if defined(MACOSX) && defined(MONITOR_BREAKPOINTS)
+	if (CPU_break_bench) {
+		CPU_break_bench_time += Util_time() - bench_time;
+		CPU_break_bench_cycles += CPU_cycle_count - bench_cycles;
+	}
+#endif
 }
 
 void CPU_Initialise(void)
@@ -2867,6 +3345,239 @@ static int CheckBreak()
 		check_break_addr=(UBYTE)(MEMORY_dGetByte(CPU_regPC)+CPU_regY);
 		return(CheckBreak());
 	}
+
+static UWORD BreakEffectiveAddr(UBYTE optype)
+{
+	switch (optype >> 4) {
+	case 1:
+		return MEMORY_dGetWord(CPU_regPC);
+	case 2:
+		return MEMORY_dGetByte(CPU_regPC);
+	case 3:
+		return MEMORY_dGetWord(CPU_regPC) + CPU_regX;
+	case 4:
+		return MEMORY_dGetWord(CPU_regPC) + CPU_regY;
+	case 5:
+		return MEMORY_dGetWordZero(MEMORY_dGetByte(CPU_regPC) + CPU_regX);
+	case 6:
+		return MEMORY_dGetWordZero(MEMORY_dGetByte(CPU_regPC)) + CPU_regY;
+	case 7:
+		return (UBYTE) (MEMORY_dGetByte(CPU_regPC) + CPU_regX);
+	case 8:
+		return (UBYTE) (MEMORY_dGetByte(CPU_regPC) + CPU_regY);
+	default:
+		return 0;
+	}
+}
+
+/* Returns the predicate kind for a table condition, or BREAK_PRED_END
+   for conditions which are handled by handle_null() and never match. */
+static int BreakPredKind(int condition)
+{
+	int op = condition & 7;
+
+	if (condition >= MONITOR_BREAKPOINT_CLRN && condition <= MONITOR_BREAKPOINT_SETC)
+		return BREAK_PRED_FLAG;
+	if (op == 0 || op == 7)
+		return BREAK_PRED_END;
+	switch (condition & ~7) {
+	case MONITOR_BREAKPOINT_PC:
+		return BREAK_PRED_PC;
+	case MONITOR_BREAKPOINT_A:
+		return BREAK_PRED_A;
+	case MONITOR_BREAKPOINT_X:
+		return BREAK_PRED_X;
+	case MONITOR_BREAKPOINT_Y:
+		return BREAK_PRED_Y;
+	case MONITOR_BREAKPOINT_S:
+		return BREAK_PRED_S;
+	case MONITOR_BREAKPOINT_MEM:
+		return BREAK_PRED_MEM;
+	case MONITOR_BREAKPOINT_READ:
+	case MONITOR_BREAKPOINT_WRITE:
+	case MONITOR_BREAKPOINT_ACCESS:
+		return BREAK_PRED_ACCESS;
+	default:
+		return BREAK_PRED_END;
+	}
+}
+
+#define BREAK_COMPARE(val, op, ref) \
+	((((op) & MONITOR_BREAKPOINT_LESS) && (val) < (ref)) \
+	|| (((op) & MONITOR_BREAKPOINT_EQUAL) && (val) == (ref)) \
+	|| (((op) & MONITOR_BREAKPOINT_GREATER) && (val) > (ref)))
+
+/* Must give the same result as the matching break_handlers[] entry */
+static int BreakPredMatch(const break_pred *p, UBYTE optype)
+{
+	switch (p->kind) {
+	case BREAK_PRED_FLAG:
+		switch (p->op) {
+		case MONITOR_BREAKPOINT_CLRN:
+			return !(N & CPU_N_FLAG);
+		case MONITOR_BREAKPOINT_SETN:
+			return (N & CPU_N_FLAG) != 0;
+		case MONITOR_BREAKPOINT_CLRV:
+			return !V;
+		case MONITOR_BREAKPOINT_SETV:
+			return V != 0;
+		case MONITOR_BREAKPOINT_SETB:
+			return (CPU_regP & CPU_B_FLAG) != 0;
+		case MONITOR_BREAKPOINT_SETD:
+			return (CPU_regP & CPU_D_FLAG) != 0;
+		case MONITOR_BREAKPOINT_SETI:
+			return (CPU_regP & CPU_I_FLAG) != 0;
+		case MONITOR_BREAKPOINT_CLRZ:
+			return !Z;
+		case MONITOR_BREAKPOINT_SETZ:
+			return Z != 0;
+		case MONITOR_BREAKPOINT_CLRC:
+			return !C;
+		case MONITOR_BREAKPOINT_SETC:
+			return C != 0;
+		default:
+			/* handle_clr[bdi]_break() never fail */
+			return TRUE;
+		}
+	case BREAK_PRED_PC:
+		return BREAK_COMPARE(CPU_regPC - 1, p->op, p->addr);
+	case BREAK_PRED_A:
+		return BREAK_COMPARE(CPU_regA, p->op, p->val);
+	case BREAK_PRED_X:
+		return BREAK_COMPARE(CPU_regX, p->op, p->val);
+	case BREAK_PRED_Y:
+		return BREAK_COMPARE(CPU_regY, p->op, p->val);
+	case BREAK_PRED_S:
+		return BREAK_COMPARE(CPU_regS, p->op, p->val);
+	case BREAK_PRED_MEM:
+		return BREAK_COMPARE(MEMORY_mem[p->addr], p->op, p->val);
+	case BREAK_PRED_ACCESS:
+		if ((p->op & ((optype & 0xC) << 4)) == 0)
+			return FALSE;
+		return BREAK_COMPARE(BreakEffectiveAddr(optype), p->op, p->addr);
+	default:
+		return FALSE;
+	}
+}
+
+static void IndexBreakGroup(int start, int end)
+{
+	int first = break_pred_count;
+	int pc_gate = -1;
+	int access_gate = -1;
+	int i;
+
+	for (i = start; i < end; i++) {
+		const MONITOR_breakpoint_cond *cond = &MONITOR_breakpoint_table[i];
+		break_pred *p;
+		int kind;
+
+		if (!cond->on)
+			continue;
+		kind = BreakPredKind(cond->condition);
+		if (kind == BREAK_PRED_END) {
+			/* this group can never fire */
+			break_pred_count = first;
+			return;
+		}
+		if (cond->condition == (MONITOR_BREAKPOINT_PC | MONITOR_BREAKPOINT_EQUAL))
+			pc_gate = i;
+		else if (kind == BREAK_PRED_ACCESS && (cond->condition & 7) == MONITOR_BREAKPOINT_EQUAL)
+			access_gate = i;
+		p = &break_preds[break_pred_count++];
+		p->kind = kind;
+		p->op = cond->condition;
+		p->addr = cond->addr;
+		p->val = cond->val;
+	}
+
+	if (pc_gate >= 0) {
+		UWORD addr = MONITOR_breakpoint_table[pc_gate].addr;
+		break_pred_count = first;
+		break_pc_map[addr >> 3] |= 1 << (addr & 7);
+	}
+	else if (access_gate >= 0) {
+		int types = MONITOR_breakpoint_table[access_gate].condition & MONITOR_BREAKPOINT_ACCESS;
+		break_pred_count = first;
+		break_page_map[MONITOR_breakpoint_table[access_gate].addr >> 8] |= types;
+		break_page_types |= types;
+	}
+	else if (break_pred_count == first) {
+		/* an empty group always fires */
+		break_always = TRUE;
+	}
+	else
+		break_preds[break_pred_count++].kind = BREAK_PRED_END;
+}
+
+static void UpdateBreakIndex(void)
+{
+	int start;
+	int i;
+
+	if (break_index_size == MONITOR_breakpoint_table_size
+		&& memcmp(break_index_table, MONITOR_breakpoint_table,
+		          MONITOR_breakpoint_table_size * sizeof(MONITOR_breakpoint_cond)) == 0)
+		return;
+	memcpy(break_index_table, MONITOR_breakpoint_table,
+	       MONITOR_breakpoint_table_size * sizeof(MONITOR_breakpoint_cond));
+	break_index_size = MONITOR_breakpoint_table_size;
+
+	memset(break_pc_map, 0, sizeof(break_pc_map));
+	memset(break_page_map, 0, sizeof(break_page_map));
+	break_page_types = 0;
+	break_pred_count = 0;
+	break_always = FALSE;
+
+	/* split the table into AND-connected groups the same way CheckBreak() does */
+	start = 0;
+	for (i = 0; i <= MONITOR_breakpoint_table_size; i++) {
+		if (i == MONITOR_breakpoint_table_size
+			|| (MONITOR_breakpoint_table[i].condition == MONITOR_BREAKPOINT_OR
+			    && MONITOR_breakpoint_table[i].on)) {
+			IndexBreakGroup(start, i);
+			start = i + 1;
+		}
+	}
+}
+
+/* Returns TRUE if CheckBreak() has to be run for the current instruction */
+static int CheckBreakIndex(UBYTE insn)
+{
+	UWORD pc = CPU_regPC - 1;
+	UBYTE optype;
+	int type;
+	const break_pred *p;
+	const break_pred *end;
+
+	if (CPU_break_bench)
+		CPU_break_bench_insns++;
+	if (break_always || MONITOR_break_fired)
+		goto check;
+	if (break_pc_map[pc >> 3] & (1 << (pc & 7)))
+		goto check;
+	optype = MONITOR_optype6502[insn];
+	type = (optype & 0xC) << 4;
+	if (break_page_types & type) {
+		if (break_page_map[BreakEffectiveAddr(optype) >> 8] & type)
+			goto check;
+	}
+	end = break_preds + break_pred_count;
+	for (p = break_preds; p < end; p++) {
+		while (p->kind != BREAK_PRED_END && BreakPredMatch(p, optype))
+			p++;
+		if (p->kind == BREAK_PRED_END)
+			goto check;
+		while (p->kind != BREAK_PRED_END)
+			p++;
+	}
+	return FALSE;
+
+check:
+	if (CPU_break_bench)
+		CPU_break_bench_checks++;
+	return TRUE;
+}
 	
 #endif /* MONITOR_BREAKPOINTS */	
 #endif /* MACOSX */	
@@ -72,6 +72,14 @@ extern UBYTE CPU_remember_X[CPU_REMEMBER_PC_STEPS];
 extern UBYTE CPU_remember_Y[CPU_REMEMBER_PC_STEPS];
 extern UBYTE CPU_remember_S[CPU_REMEMBER_PC_STEPS];
 extern UBYTE CPU_remember_P[CPU_REMEMBER_PC_STEPS];
+#ifdef MONITOR_BREAKPOINTS
+/* Breakpoint speed measurement, started by the monitor "B BENCH" command */
+extern int CPU_break_bench;
+extern double CPU_break_bench_time;
+extern uint64_t CPU_break_bench_cycles;
+extern uint64_t CPU_break_bench_insns;
+extern uint64_t CPU_break_bench_checks;
+#endif
 #endif
 
 #define CPU_REMEMBER_JMP_STEPS 16
@@ -84,4 +92,9 @@ extern int CPU_instruction_count[256];
 
 extern uint64_t CPU_cycle_count;
 
+/* Set to skip the passes of side effect free busy-wait loops */
+extern int CPU_idle_skip;
+/* Cycles skipped that way */
+extern uint64_t CPU_idle_skipped_cycles;
+
 #endif /* CPU_H_ */
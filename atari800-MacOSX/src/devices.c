@@ -3011,6 +3011,19 @@ static UWORD r_entry_address = 0;
 #define D_DEVICE_END    0xd0e5
 #endif
 
+#ifdef ATARI800MACX
+int Devices_HostFilesOpen(void)
+{
+	if (Devices_H_CountOpen() > 0 || binfile != NULL)
+		return TRUE;
+#ifdef HAVE_SYSTEM
+	if (phf != NULL)
+		return TRUE;
+#endif
+	return FALSE;
+}
+#endif
+
 void Devices_Frame(void)
 {
 	if (Devices_enable_h_patch)
@@ -29,6 +29,10 @@ extern char Devices_h_current_dir[4][FILENAME_MAX];
 
 int Devices_H_CountOpen(void);
 void Devices_H_CloseAll(void);
+#ifdef ATARI800MACX
+/* Returns TRUE while a host file is open through H: or P: */
+int Devices_HostFilesOpen(void);
+#endif
 
 extern char Devices_print_command[256];
 
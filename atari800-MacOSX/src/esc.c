@@ -41,6 +41,8 @@
 #endif
 
 int ESC_enable_sio_patch = TRUE;
+ULONG ESC_calls = 0;
+int ESC_hold = FALSE;
 #ifdef MACOSX
 extern int fujinet_enabled;
 #endif
@@ -140,7 +142,9 @@ void ESC_Remove(UBYTE esc_code)
 void ESC_Run(UBYTE esc_code)
 {
 	if (esc_address[esc_code] == CPU_regPC - 2 && esc_function[esc_code] != NULL) {
-		esc_function[esc_code]();
+		ESC_calls++;
+		if (!ESC_hold)
+			esc_function[esc_code]();
 		return;
 	}
 #ifdef CRASH_MENU
@@ -1,9 +1,19 @@
 #ifndef ESC_H_
 #define ESC_H_
 
+#include "atari.h" /* ULONG */
+
 /* TRUE to enable patched (fast) Serial I/O. */
 extern int ESC_enable_sio_patch;
 
+/* Counts the escape sequences met by the CPU, whether handled or held,
+   so that the caller can tell if the emulated code called the host. */
+extern ULONG ESC_calls;
+
+/* While TRUE, escape sequences are counted but their functions are not
+   called.  Frames that are thrown away afterwards must not touch the host. */
+extern int ESC_hold;
+
 /* Escape codes used to mark places in 6502 code that must
    be handled specially by the emulator. An escape sequence
    is an illegal 6502 opcode 0xF2 or 0xD2 followed
@@ -102,7 +112,7 @@ void ESC_AddEscRts2(UWORD address, UBYTE esc_code, ESC_FunctionType function);
 /* Unregisters an escape sequence. You must cleanup the Atari memory yourself. */
 void ESC_Remove(UBYTE esc_code);
 
-/* Handles an escape sequence. */
+/* Handles an escape sequence, unless ESC_hold is set. */
 void ESC_Run(UBYTE esc_code);
 
 /* Installs SIO patch and disables ROM checksum test. */
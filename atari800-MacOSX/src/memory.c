@@ -36,6 +36,9 @@
 #include "gtia.h"
 #include "log.h"
 #include "memory.h"
+#ifdef MONITOR_BREAK
+#include "monitor.h"
+#endif
 #include "pbi.h"
 #include "pia.h"
 #include "pokey.h"
@@ -375,6 +378,20 @@ void MEMORY_StateSave(UBYTE SaveVerbose)
 	StateSav_SaveUBYTE(&MEMORY_mem[0], 65536);
 	STATESAV_TAG(base_ram_attrib);
 #ifndef PAGED_ATTRIB
+#ifdef MEMORY_WATCHPOINTS
+	if (MEMORY_num_watches > 0) {
+		/* the watch flags are not part of the machine state */
+		UBYTE attrib_page[256];
+		int i;
+		int j;
+		for (i = 0; i < 65536; i += 256) {
+			for (j = 0; j < 256; j++)
+				attrib_page[j] = MEMORY_attrib[i + j] & ~MEMORY_WATCH;
+			StateSav_SaveUBYTE(&attrib_page[0], 256);
+		}
+	}
+	else
+#endif
 	StateSav_SaveUBYTE(&MEMORY_attrib[0], 65536);
 #else
 	{
@@ -492,6 +509,9 @@ void MEMORY_StateRead(UBYTE SaveVerbose, UBYTE StateVersion)
 	StateSav_ReadUBYTE(&MEMORY_mem[0], 65536);
 #ifndef PAGED_ATTRIB
 	StateSav_ReadUBYTE(&MEMORY_attrib[0], 65536);
+#ifdef MEMORY_WATCHPOINTS
+	MEMORY_RefreshWatches();
+#endif
 #else
 	{
 		UBYTE attrib_page[256];
@@ -1307,3 +1327,162 @@ void MEMORY_FlashPutByte(UWORD addr, UBYTE byte)
 }
 
 #endif /* PAGED_MEM */
+
+#ifdef MEMORY_WATCHPOINTS
+
+MEMORY_watch MEMORY_watches[MEMORY_WATCH_MAX];
+int MEMORY_num_watches = 0;
+int MEMORY_watch_dma = FALSE;
+int MEMORY_watch_hit = -1;
+UWORD MEMORY_watch_hit_addr;
+int MEMORY_watch_hit_type;
+UBYTE MEMORY_watch_hit_value;
+
+/* XE bank the CPU sees at ADDR */
+static int CpuBank(UWORD addr)
+{
+	if (addr >= 0x4000 && addr < 0x8000 && Atari800_machine_type == Atari800_MACHINE_XLXE
+	    && MEMORY_ram_size > 64 && ((PIA_PORTB | PIA_PORTB_mask) & 0x10) == 0)
+		return MEMORY_xe_bank;
+	return 0;
+}
+
+/* XE bank ANTIC sees at ADDR */
+static int AnticBank(UWORD addr)
+{
+	if (ANTIC_xe_ptr != NULL && addr >= 0x4000 && addr < 0x8000)
+		return (int) ((ANTIC_xe_ptr - atarixe_memory) >> 14);
+	return CpuBank(addr);
+}
+
+static void Hit(int index, UWORD addr, int type, UBYTE value)
+{
+	if (MEMORY_watch_hit >= 0)
+		return;
+	MEMORY_watch_hit = index;
+	MEMORY_watch_hit_addr = addr;
+	MEMORY_watch_hit_type = type;
+	MEMORY_watch_hit_value = value;
+	/* stop after the current instruction */
+	MONITOR_break_step = TRUE;
+}
+
+static void CheckWatches(UWORD addr, int type, UBYTE value)
+{
+	int i;
+	for (i = 0; i < MEMORY_num_watches; i++) {
+		const MEMORY_watch *w = &MEMORY_watches[i];
+		if (w->addr == addr && (w->types & type)
+		    && (w->bank == MEMORY_WATCH_ANY_BANK || w->bank == CpuBank(addr))) {
+			Hit(i, addr, type, value);
+			return;
+		}
+	}
+}
+
+void MEMORY_RefreshWatches(void)
+{
+	int i;
+	MEMORY_watch_dma = FALSE;
+	for (i = 0; i < MEMORY_num_watches; i++) {
+		/* DMA only watches are checked by ANTIC and need no trap */
+		if (MEMORY_watches[i].types & (MEMORY_WATCH_READ | MEMORY_WATCH_WRITE))
+			MEMORY_attrib[MEMORY_watches[i].addr] |= MEMORY_WATCH;
+		if (MEMORY_watches[i].types & MEMORY_WATCH_DMA)
+			MEMORY_watch_dma = TRUE;
+	}
+}
+
+int MEMORY_AddWatch(UWORD addr, int types, int bank)
+{
+	MEMORY_watch *w;
+	if (MEMORY_num_watches >= MEMORY_WATCH_MAX)
+		return -1;
+	w = &MEMORY_watches[MEMORY_num_watches++];
+	w->addr = addr;
+	w->types = (UBYTE) types;
+	w->bank = bank;
+	MEMORY_RefreshWatches();
+	return MEMORY_num_watches - 1;
+}
+
+void MEMORY_DeleteWatch(int index)
+{
+	UWORD addr;
+	if (index < 0 || index >= MEMORY_num_watches)
+		return;
+	addr = MEMORY_watches[index].addr;
+	MEMORY_attrib[addr] &= ~MEMORY_WATCH;
+	memmove(MEMORY_watches + index, MEMORY_watches + index + 1,
+	        (MEMORY_num_watches - index - 1) * sizeof(MEMORY_watch));
+	MEMORY_num_watches--;
+	/* another watch may be on the same address */
+	MEMORY_RefreshWatches();
+}
+
+void MEMORY_ClearWatches(void)
+{
+	while (MEMORY_num_watches > 0)
+		MEMORY_attrib[MEMORY_watches[--MEMORY_num_watches].addr] &= ~MEMORY_WATCH;
+	MEMORY_watch_dma = FALSE;
+	MEMORY_watch_hit = -1;
+}
+
+UBYTE MEMORY_TrapGetByte(UWORD addr, int no_side_effects)
+{
+	int attrib = MEMORY_attrib[addr];
+	UBYTE byte;
+	switch (attrib & ~MEMORY_WATCH) {
+	case MEMORY_HARDWARE:
+		byte = MEMORY_HwGetByte(addr, no_side_effects);
+		break;
+	case MEMORY_FLASH:
+		byte = MEMORY_FlashGetByte(addr);
+		break;
+	default:
+		byte = MEMORY_mem[addr];
+		break;
+	}
+	/* the monitor looks at memory without side effects */
+	if ((attrib & MEMORY_WATCH) && !no_side_effects)
+		CheckWatches(addr, MEMORY_WATCH_READ, byte);
+	return byte;
+}
+
+void MEMORY_TrapPutByte(UWORD addr, UBYTE byte)
+{
+	int attrib = MEMORY_attrib[addr];
+	switch (attrib & ~MEMORY_WATCH) {
+	case MEMORY_RAM:
+		MEMORY_mem[addr] = byte;
+		break;
+	case MEMORY_HARDWARE:
+		MEMORY_HwPutByte(addr, byte);
+		break;
+	case MEMORY_FLASH:
+		MEMORY_FlashPutByte(addr, byte);
+		break;
+	default:
+		break;
+	}
+	if (attrib & MEMORY_WATCH)
+		CheckWatches(addr, MEMORY_WATCH_WRITE, byte);
+}
+
+void MEMORY_WatchDMA(UWORD addr, int len)
+{
+	int i;
+	for (i = 0; i < MEMORY_num_watches; i++) {
+		const MEMORY_watch *w = &MEMORY_watches[i];
+		if ((w->types & MEMORY_WATCH_DMA) && ((w->addr ^ addr) & 0xf000) == 0
+		    && ((w->addr - addr) & 0xfff) < len
+		    && (w->bank == MEMORY_WATCH_ANY_BANK || w->bank == AnticBank(w->addr))) {
+			const UBYTE *p = ANTIC_xe_ptr != NULL && w->addr >= 0x4000 && w->addr < 0x8000
+			                 ? ANTIC_xe_ptr + (w->addr - 0x4000) : MEMORY_mem + w->addr;
+			Hit(i, w->addr, MEMORY_WATCH_DMA, *p);
+			return;
+		}
+	}
+}
+
+#endif /* MEMORY_WATCHPOINTS */
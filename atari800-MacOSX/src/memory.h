@@ -54,21 +54,44 @@ extern int MEMORY_ram_size;
 #define MEMORY_HARDWARE  2
 #define MEMORY_FLASH     3
 
+#if defined(MONITOR_BREAK) && !defined(PAGED_ATTRIB) && !defined(PAGED_MEM)
+/* Set in MEMORY_attrib on top of the type of every watched address, so only
+   accesses to those addresses leave the fast path of the macros below. */
+#define MEMORY_WATCHPOINTS
+#define MEMORY_WATCH     0x80
+#endif
+
 #ifndef PAGED_ATTRIB
 
 extern UBYTE MEMORY_attrib[65536];
+#ifdef MEMORY_WATCHPOINTS
+/* Reads a byte from ADDR. Can potentially have side effects, when reading
+   from hardware area. */
+#define MEMORY_GetByte(addr)		(MEMORY_attrib[addr] == MEMORY_HARDWARE ? MEMORY_HwGetByte(addr, FALSE) : (MEMORY_attrib[addr] >= MEMORY_FLASH ? MEMORY_TrapGetByte(addr, FALSE) : MEMORY_mem[addr]))
+/* Reads a byte from ADDR, but without any side effects. */
+#define MEMORY_SafeGetByte(addr)        (MEMORY_attrib[addr] == MEMORY_HARDWARE ? MEMORY_HwGetByte(addr, TRUE) : (MEMORY_attrib[addr] >= MEMORY_FLASH ? MEMORY_TrapGetByte(addr, TRUE) : MEMORY_mem[addr]))
+#define MEMORY_PutByte(addr, byte)	 do { if (MEMORY_attrib[addr] == MEMORY_RAM) MEMORY_mem[addr] = byte; else if (MEMORY_attrib[addr] == MEMORY_HARDWARE) MEMORY_HwPutByte(addr, byte); else if (MEMORY_attrib[addr] >= MEMORY_FLASH) MEMORY_TrapPutByte(addr, byte);} while (0)
+/* Changing the type of memory drops the watch flags, so put them back */
+#define MEMORY_SetAttrib(addr1, addr2, type) do { \
+		memset(MEMORY_attrib + (addr1), type, (addr2) - (addr1) + 1); \
+		if (MEMORY_num_watches > 0) \
+			MEMORY_RefreshWatches(); \
+	} while (0)
+#else /* MEMORY_WATCHPOINTS */
 /* Reads a byte from ADDR. Can potentially have side effects, when reading
    from hardware area. */
 #define MEMORY_GetByte(addr)		(MEMORY_attrib[addr] == MEMORY_HARDWARE ? MEMORY_HwGetByte(addr, FALSE) : (MEMORY_attrib[addr] == MEMORY_FLASH ? MEMORY_FlashGetByte(addr) : MEMORY_mem[addr]))
-#define MEMORY_GetWord(x)                (MEMORY_GetByte(x) + (MEMORY_GetByte((x) + 1) << 8))
-#define MEMORY_PutWord(x, y)            MEMORY_PutByte(x, (UBYTE) (y)); MEMORY_PutByte((x) + 1, (UBYTE) ((y) >> 8));
 /* Reads a byte from ADDR, but without any side effects. */
 #define MEMORY_SafeGetByte(addr)        (MEMORY_attrib[addr] == MEMORY_HARDWARE ? MEMORY_HwGetByte(addr, TRUE) : (MEMORY_attrib[addr] == MEMORY_FLASH ? MEMORY_FlashGetByte(addr) : MEMORY_mem[addr]))
 #define MEMORY_PutByte(addr, byte)	 do { if (MEMORY_attrib[addr] == MEMORY_RAM) MEMORY_mem[addr] = byte; else if (MEMORY_attrib[addr] == MEMORY_HARDWARE) MEMORY_HwPutByte(addr, byte); else if (MEMORY_attrib[addr] == MEMORY_FLASH) MEMORY_FlashPutByte(addr, byte);} while (0)
-#define MEMORY_SetRAM(addr1, addr2) memset(MEMORY_attrib + (addr1), MEMORY_RAM, (addr2) - (addr1) + 1)
-#define MEMORY_SetROM(addr1, addr2) memset(MEMORY_attrib + (addr1), MEMORY_ROM, (addr2) - (addr1) + 1)
-#define MEMORY_SetHARDWARE(addr1, addr2) memset(MEMORY_attrib + (addr1), MEMORY_HARDWARE, (addr2) - (addr1) + 1)
-#define MEMORY_SetFlash(addr1, addr2) memset(MEMORY_attrib + (addr1), MEMORY_FLASH, (addr2) - (addr1) + 1)
+#define MEMORY_SetAttrib(addr1, addr2, type) memset(MEMORY_attrib + (addr1), type, (addr2) - (addr1) + 1)
+#endif /* MEMORY_WATCHPOINTS */
+#define MEMORY_GetWord(x)                (MEMORY_GetByte(x) + (MEMORY_GetByte((x) + 1) << 8))
+#define MEMORY_PutWord(x, y)            MEMORY_PutByte(x, (UBYTE) (y)); MEMORY_PutByte((x) + 1, (UBYTE) ((y) >> 8));
+#define MEMORY_SetRAM(addr1, addr2) MEMORY_SetAttrib(addr1, addr2, MEMORY_RAM)
+#define MEMORY_SetROM(addr1, addr2) MEMORY_SetAttrib(addr1, addr2, MEMORY_ROM)
+#define MEMORY_SetHARDWARE(addr1, addr2) MEMORY_SetAttrib(addr1, addr2, MEMORY_HARDWARE)
+#define MEMORY_SetFlash(addr1, addr2) MEMORY_SetAttrib(addr1, addr2, MEMORY_FLASH)
 
 #else /* PAGED_ATTRIB */
 
@@ -157,4 +180,44 @@ UBYTE MEMORY_FlashGetByte(UWORD addr);
 void MEMORY_FlashPutByte(UWORD addr, UBYTE byte);
 #endif /* PAGED_MEM */
 
+#ifdef MEMORY_WATCHPOINTS
+/* Watchpoints stop the emulation (through MONITOR_break_step) after the
+   instruction that accessed a watched address. Zero page and stack
+   accesses of the CPU bypass MEMORY_attrib and can not be watched. */
+#define MEMORY_WATCH_READ   0x01
+#define MEMORY_WATCH_WRITE  0x02
+#define MEMORY_WATCH_DMA    0x04	/* ANTIC display list and playfield fetches */
+#define MEMORY_WATCH_ANY_BANK (-1)
+#define MEMORY_WATCH_MAX    64
+
+typedef struct MEMORY_watch_t {
+	UWORD addr;
+	UBYTE types;
+	int bank;				/* XE bank for $4000-$7fff (0 is the main memory),
+							   or MEMORY_WATCH_ANY_BANK */
+} MEMORY_watch;
+
+extern MEMORY_watch MEMORY_watches[MEMORY_WATCH_MAX];
+extern int MEMORY_num_watches;
+/* TRUE if a watch has MEMORY_WATCH_DMA, tested by ANTIC for each mode line */
+extern int MEMORY_watch_dma;
+/* The first watch that fired since the monitor was entered, or -1 */
+extern int MEMORY_watch_hit;
+extern UWORD MEMORY_watch_hit_addr;
+extern int MEMORY_watch_hit_type;
+extern UBYTE MEMORY_watch_hit_value;
+
+/* Returns the index of the new watch, or -1 if the table is full */
+int MEMORY_AddWatch(UWORD addr, int types, int bank);
+void MEMORY_DeleteWatch(int index);
+void MEMORY_ClearWatches(void);
+/* Sets MEMORY_WATCH again for all watches, after MEMORY_attrib was changed */
+void MEMORY_RefreshWatches(void);
+/* Accesses to FLASH and watched addresses */
+UBYTE MEMORY_TrapGetByte(UWORD addr, int no_side_effects);
+void MEMORY_TrapPutByte(UWORD addr, UBYTE byte);
+/* ANTIC fetches of LEN bytes at ADDR, wrapping at a 4K boundary */
+void MEMORY_WatchDMA(UWORD addr, int len);
+#endif /* MEMORY_WATCHPOINTS */
+
 #endif /* MEMORY_H_ */
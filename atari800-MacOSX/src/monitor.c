@@ -35,6 +35,12 @@
 #include "monitor.h"
 #include "pia.h"
 #include "pokey.h"
+#ifdef MONITOR_PROF
+#include "profile.h"
+#endif
+#ifdef MONITOR_TRACELOG
+#include "tracelog.h"
+#endif
 #include "util.h"
 #ifdef STEREO_SOUND
 #include "pokeysnd.h"
@@ -485,6 +491,14 @@ static void load_user_labels(const char *filename)
 	printf("Loaded %d labels\n", symtable_user_size);
 }
 
+#ifdef MONITOR_PROF
+/* Names the functions in the profiler's call tree */
+static const char *profile_label_name(UWORD addr)
+{
+	return find_label_name(addr, FALSE);
+}
+#endif
+
 #endif /* MONITOR_HINTS */
 
 static const char instr6502[256][10] = {
@@ -1318,6 +1332,15 @@ int MONITOR_Run(void)
 	MONITOR_break_step = FALSE;
 	MONITOR_break_ret = FALSE;
 #endif /* MONITOR_BREAK */
+#ifdef MEMORY_WATCHPOINTS
+	if (MEMORY_watch_hit >= 0) {
+		printf("(watchpoint #%d: %s %04X, value %02X)\n", MEMORY_watch_hit,
+		       MEMORY_watch_hit_type == MEMORY_WATCH_READ ? "read of" :
+		       MEMORY_watch_hit_type == MEMORY_WATCH_WRITE ? "write to" : "DMA read of",
+		       (unsigned int) MEMORY_watch_hit_addr, (unsigned int) MEMORY_watch_hit_value);
+		MEMORY_watch_hit = -1;
+	}
+#endif
 
 	show_state();
 
@@ -1328,6 +1351,13 @@ int MONITOR_Run(void)
 
 		printf("> ");
 		safe_gets(s, sizeof(s));
+#ifdef MEMORY_WATCHPOINTS
+		/* a watch hit by a monitor command must not stop the emulation */
+		if (MEMORY_watch_hit >= 0) {
+			MEMORY_watch_hit = -1;
+			MONITOR_break_step = FALSE;
+		}
+#endif
 		if (s[0] != '\0')
 			strcpy(old_s, s);
 		else {
@@ -1381,6 +1411,61 @@ int MONITOR_Run(void)
 			else
 				printf("Breakpoint at PC=%04X\n", MONITOR_break_addr);
 		}
+#ifdef MEMORY_WATCHPOINTS
+		else if (strcmp(t, "WATCH") == 0) {
+			UWORD addr;
+			int num;
+			t = get_token();
+			if (t == NULL) {
+				int i;
+				if (MEMORY_num_watches == 0)
+					printf("No watchpoints\n");
+				for (i = 0; i < MEMORY_num_watches; i++) {
+					const MEMORY_watch *w = &MEMORY_watches[i];
+					printf("%2d: %04X %s%s%s", i, (unsigned int) w->addr,
+					       (w->types & MEMORY_WATCH_READ) ? "R" : "",
+					       (w->types & MEMORY_WATCH_WRITE) ? "W" : "",
+					       (w->types & MEMORY_WATCH_DMA) ? " DMA" : "");
+					if (w->bank != MEMORY_WATCH_ANY_BANK)
+						printf(" bank %d", w->bank);
+					printf("\n");
+				}
+			}
+			else if (Util_stricmp(t, "CLEAR") == 0)
+				MEMORY_ClearWatches();
+			else if (Util_stricmp(t, "DEL") == 0) {
+				if (get_dec(&num) && num < MEMORY_num_watches)
+					MEMORY_DeleteWatch(num);
+				else
+					printf("Usage: WATCH DEL n\n");
+			}
+			else if (parse_hex(t, &addr)) {
+				int types = MEMORY_WATCH_READ | MEMORY_WATCH_WRITE;
+				int bank = MEMORY_WATCH_ANY_BANK;
+				t = get_token();
+				if (t == NULL)
+					t = "RW";
+				if (Util_stricmp(t, "R") == 0)
+					types = MEMORY_WATCH_READ;
+				else if (Util_stricmp(t, "W") == 0)
+					types = MEMORY_WATCH_WRITE;
+				else if (Util_stricmp(t, "DMA") == 0)
+					types = MEMORY_WATCH_DMA;
+				else if (Util_stricmp(t, "RW") != 0)
+					types = 0;
+				if (get_dec(&num))
+					bank = num;
+				if (types == 0)
+					printf("Usage: WATCH addr [R|W|RW|DMA] [bank]\n");
+				else if ((types & MEMORY_WATCH_DMA) == 0 && addr < 0x200)
+					printf("Zero page and stack can not be watched\n");
+				else if (MEMORY_AddWatch(addr, types, bank) < 0)
+					printf("Too many watchpoints\n");
+			}
+			else
+				printf("Usage: WATCH addr [R|W|RW|DMA] [bank], WATCH DEL n or WATCH CLEAR\n");
+		}
+#endif
 		else if (strcmp(t, "HISTORY") == 0 || strcmp(t, "H") == 0) {
 			int i;
 			for (i = 0; i < CPU_REMEMBER_PC_STEPS; i++) {
@@ -1603,6 +1688,85 @@ int MONITOR_Run(void)
 			}
 		}
 #endif /* MONITOR_TRACE */
+#ifdef MONITOR_TRACELOG
+		else if (strcmp(t, "TRACELOG") == 0) {
+			const char *filename = get_token();
+			if (filename == NULL)
+				printf("Trace log is %s, %llu instructions written\n",
+				       TRACELOG_active ? "on" : "off", (unsigned long long) TRACELOG_count);
+			else if (Util_stricmp(filename, "OFF") == 0)
+				TRACELOG_Stop();
+			else {
+				const char *mode = get_token();
+				if (mode != NULL && Util_stricmp(mode, "RAW") != 0)
+					printf("Usage: TRACELOG filename [RAW] or TRACELOG OFF\n");
+				else if (!TRACELOG_Start(filename, mode == NULL))
+					perror(filename);
+			}
+		}
+#endif /* MONITOR_TRACELOG */
+#ifdef MONITOR_PROF
+		else if (strcmp(t, "PROF") == 0) {
+			t = get_token();
+			if (t == NULL) {
+				ULONG insns;
+				uint64_t cyc, stolen;
+				PROFILE_Totals(&insns, &cyc, &stolen);
+				printf("Profiler is %s: %lu instructions, %llu cycles, %llu stolen by ANTIC\n",
+				       PROFILE_active ? "on" : "off", (unsigned long) insns,
+				       (unsigned long long) cyc, (unsigned long long) stolen);
+			}
+			else if (Util_stricmp(t, "ON") == 0)
+				PROFILE_Start();
+			else if (Util_stricmp(t, "OFF") == 0)
+				PROFILE_Stop();
+			else if (Util_stricmp(t, "CLEAR") == 0)
+				PROFILE_Clear();
+			else if (Util_stricmp(t, "TOP") == 0) {
+				PROFILE_entry top[64];
+				int num = 16;
+				int n, i;
+				t = get_token();
+				if (t != NULL)
+					num = Util_sscandec(t);
+				if (num <= 0 || num > 64)
+					num = 64;
+				n = PROFILE_Top(top, num);
+				if (n == 0)
+					printf("No profile. Type PROF ON and continue emulation.\n");
+				else
+					printf("Bank      Count       Cycles       Stolen  Instruction\n");
+				for (i = 0; i < n; i++) {
+					printf("%4d %10lu %12llu %12llu  ", top[i].bank, (unsigned long) top[i].count,
+					       (unsigned long long) top[i].cycles, (unsigned long long) top[i].stolen);
+					if (top[i].bank == 0)
+						show_instruction(stdout, top[i].addr);
+					else
+						printf("%04X\n", top[i].addr);
+				}
+			}
+			else if (Util_stricmp(t, "SAVE") == 0) {
+				const char *filename = get_token();
+				if (filename == NULL)
+					printf("Usage: PROF SAVE filename\n");
+#ifdef MONITOR_HINTS
+				else if (!PROFILE_SaveFolded(filename, profile_label_name))
+#else
+				else if (!PROFILE_SaveFolded(filename, NULL))
+#endif
+					perror(filename);
+			}
+			else if (Util_stricmp(t, "HIST") == 0) {
+				const char *filename = get_token();
+				if (filename == NULL)
+					printf("Usage: PROF HIST filename\n");
+				else if (!PROFILE_SaveHistogram(filename))
+					perror(filename);
+			}
+			else
+				printf("Usage: PROF [ON|OFF|CLEAR|TOP [n]|SAVE filename|HIST filename]\n");
+		}
+#endif /* MONITOR_PROF */
 #ifdef MONITOR_PROFILE
 		else if (strcmp(t, "PROFILE") == 0) {
 			int i;
@@ -2031,11 +2195,20 @@ int MONITOR_Run(void)
 			printf(
 				"TRACE [filename]               - Output 6502 trace on/off\n");
 #endif
+#ifdef MONITOR_TRACELOG
+			printf(
+				"TRACELOG filename [RAW]        - Stream every instruction to a file\n"
+				"TRACELOG OFF                   - Stop the trace log\n");
+#endif
 #ifdef MONITOR_BREAK
 			printf(
 				"BPC [addr]                     - Set breakpoint at address\n"
 				"BLINE [ypos] or [1000+ypos]    - Break at scanline or blink scanline\n"
 				"BBRK ON or OFF                 - Breakpoint on BRK on/off\n"
+#ifdef MEMORY_WATCHPOINTS
+				"WATCH addr [R|W|RW|DMA] [bank] - Break after an access to addr\n"
+				"WATCH [DEL n|CLEAR]            - List or delete watchpoints\n"
+#endif
 				"HISTORY or H                   - List last %d executed instructions\n", CPU_REMEMBER_PC_STEPS);
 			printf(
 				"JUMPS                          - List last %d executed JMP/JSR\n", CPU_REMEMBER_JMP_STEPS);
@@ -2065,6 +2238,12 @@ int MONITOR_Run(void)
 #ifdef MONITOR_PROFILE
 				"PROFILE                        - Display profiling statistics\n"
 #endif
+#ifdef MONITOR_PROF
+				"PROF [ON|OFF|CLEAR]            - Profile 6502 cycles per address and call\n"
+				"PROF TOP [n]                   - List the n addresses with most cycles\n"
+				"PROF SAVE filename             - Write call stacks for a flame graph\n"
+				"PROF HIST filename             - Write cycles per address as CSV\n"
+#endif
 #ifdef MONITOR_HINTS
 				"LABELS [command] [filename]    - Configure labels\n"
 #endif
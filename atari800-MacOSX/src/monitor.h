@@ -44,6 +44,7 @@ void load_user_labels(const char *filename);
 void add_user_label(const char *name, UWORD addr);
 void free_user_labels(void);
 symtable_rec *find_user_label(const char *name);
+void set_user_label_addr(symtable_rec *p, UWORD addr);
 int get_val_gui(char *s, UWORD *hexval);
 int get_hex(char *string, UWORD *hexval);
 #endif /* MACOSX */
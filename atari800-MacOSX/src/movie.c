@@ -0,0 +1,427 @@
+/*
+ * movie.c - recording and replaying the input of a session
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "antic.h"
+#include "atari.h"
+#include "cpu.h"
+#include "crc32.h"
+#include "gtia.h"
+#include "input.h"
+#include "log.h"
+#include "movie.h"
+#include "pia.h"
+#include "pokey.h"
+#include "screen.h"
+#include "statesav.h"
+#include "util.h"
+
+/* Movie file layout, all numbers little-endian:
+     "ATARIMOV"     magic
+     UBYTE          version
+     ULONG          POKEY random counter (not part of the state)
+     ULONG          snapshot size, followed by a StateSav_SaveMem snapshot
+   and then for each frame:
+     3 bytes        mask of the input bytes that changed since the frame before
+     n bytes        the changed input bytes
+     ULONG          CRC32 of the frame's screen */
+#define MOVIE_VERSION 1
+
+/* The input bytes, in file order */
+enum {
+	IN_KBCODE,
+	IN_SKSTAT,
+	IN_IRQST,
+	IN_CPU_IRQ,
+	IN_PORTA,
+	IN_PORTB,
+	IN_TRIG0, IN_TRIG1, IN_TRIG2, IN_TRIG3,
+	IN_CONSOL,
+	IN_POT0, IN_POT1, IN_POT2, IN_POT3, IN_POT4, IN_POT5, IN_POT6, IN_POT7,
+	IN_PENH,
+	IN_PENV,
+	IN_EVENTS,
+	IN_SIZE
+};
+
+int MOVIE_mismatches = 0;
+
+static FILE *moviefp = NULL;
+static int recording = FALSE;
+static int playingback = FALSE;
+static int verifying = FALSE;
+static UBYTE last_input[IN_SIZE];
+static int events = 0;
+static ULONG frame = 0;
+static ULONG recorded_crc = 0;
+
+/* Movie to start on the first frame, from the command line */
+static char pending_filename[FILENAME_MAX];
+static enum { PENDING_NONE, PENDING_RECORD, PENDING_PLAY, PENDING_VERIFY } pending = PENDING_NONE;
+
+/* Log at most this many mismatching frames */
+#define MAX_LOGGED_MISMATCHES 10
+
+int MOVIE_Initialise(int *argc, char *argv[])
+{
+	int i;
+	int j;
+
+	for (i = j = 1; i < *argc; i++) {
+		int i_a = (i + 1 < *argc);		/* is argument available? */
+		int a_m = FALSE;			/* error, argument missing! */
+
+		if (strcmp(argv[i], "-movie-record") == 0) {
+			if (i_a) {
+				Util_strlcpy(pending_filename, argv[++i], sizeof(pending_filename));
+				pending = PENDING_RECORD;
+			}
+			else a_m = TRUE;
+		}
+		else if (strcmp(argv[i], "-movie-play") == 0) {
+			if (i_a) {
+				Util_strlcpy(pending_filename, argv[++i], sizeof(pending_filename));
+				pending = PENDING_PLAY;
+			}
+			else a_m = TRUE;
+		}
+		else if (strcmp(argv[i], "-movie-verify") == 0) {
+			if (i_a) {
+				Util_strlcpy(pending_filename, argv[++i], sizeof(pending_filename));
+				pending = PENDING_VERIFY;
+			}
+			else a_m = TRUE;
+		}
+		else {
+			if (strcmp(argv[i], "-help") == 0) {
+				Log_print("\t-movie-record <file> Record the input to a movie");
+				Log_print("\t-movie-play <file>   Replay a movie");
+				Log_print("\t-movie-verify <file> Replay a movie and check the screen of each frame");
+			}
+			argv[j++] = argv[i];
+		}
+
+		if (a_m) {
+			Log_print("Missing argument for '%s'", argv[i]);
+			return FALSE;
+		}
+	}
+	*argc = j;
+
+	return TRUE;
+}
+
+void MOVIE_Exit(void)
+{
+	MOVIE_Stop();
+}
+
+static void WriteULONG(ULONG value)
+{
+	UBYTE buf[4];
+
+	buf[0] = value & 0xff;
+	buf[1] = (value >> 8) & 0xff;
+	buf[2] = (value >> 16) & 0xff;
+	buf[3] = (value >> 24) & 0xff;
+	fwrite(buf, 1, 4, moviefp);
+}
+
+static int ReadULONG(ULONG *value)
+{
+	UBYTE buf[4];
+
+	if (fread(buf, 1, 4, moviefp) != 4)
+		return FALSE;
+	*value = buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((ULONG) buf[3] << 24);
+	return TRUE;
+}
+
+static void GetInput(UBYTE *input)
+{
+	int i;
+
+	input[IN_KBCODE] = POKEY_KBCODE;
+	input[IN_SKSTAT] = POKEY_SKSTAT;
+	input[IN_IRQST] = POKEY_IRQST;
+	input[IN_CPU_IRQ] = CPU_IRQ;
+	input[IN_PORTA] = PIA_PORT_input[0];
+	input[IN_PORTB] = PIA_PORT_input[1];
+	for (i = 0; i < 4; i++)
+		input[IN_TRIG0 + i] = GTIA_TRIG[i];
+	input[IN_CONSOL] = (UBYTE) INPUT_key_consol;
+	for (i = 0; i < 8; i++)
+		input[IN_POT0 + i] = POKEY_POT_input[i];
+	input[IN_PENH] = ANTIC_PENH_input;
+	input[IN_PENV] = ANTIC_PENV_input;
+	input[IN_EVENTS] = (UBYTE) events;
+}
+
+static void SetInput(const UBYTE *input)
+{
+	int i;
+
+	/* Resets first, they clear some of the registers set below */
+	if (input[IN_EVENTS] & MOVIE_EVENT_COLDSTART)
+		Atari800_Coldstart();
+	if (input[IN_EVENTS] & MOVIE_EVENT_WARMSTART)
+		Atari800_Warmstart();
+
+	POKEY_KBCODE = input[IN_KBCODE];
+	POKEY_SKSTAT = input[IN_SKSTAT];
+	POKEY_IRQST = input[IN_IRQST];
+	CPU_IRQ = input[IN_CPU_IRQ];
+	PIA_PORT_input[0] = input[IN_PORTA];
+	PIA_PORT_input[1] = input[IN_PORTB];
+	for (i = 0; i < 4; i++)
+		GTIA_TRIG[i] = input[IN_TRIG0 + i];
+	INPUT_key_consol = input[IN_CONSOL];
+	for (i = 0; i < 8; i++)
+		POKEY_POT_input[i] = input[IN_POT0 + i];
+	ANTIC_PENH_input = input[IN_PENH];
+	ANTIC_PENV_input = input[IN_PENV];
+}
+
+static ULONG ScreenCRC(void)
+{
+	ULONG crc = 0xffffffff;
+	int y;
+
+	/* Only the visible part, 24..360 horizontally */
+	for (y = 0; y < Screen_HEIGHT; y++)
+		crc = CRC32_Update(crc, (const UBYTE *) Screen_atari + 24 + Screen_WIDTH * y, 360 - 24);
+	return crc ^ 0xffffffff;
+}
+
+int MOVIE_StartRecording(const char *filename)
+{
+	UBYTE *snapshot = NULL;
+	ULONG capacity = 0;
+	ULONG size;
+	UBYTE version = MOVIE_VERSION;
+
+	MOVIE_Stop();
+	size = StateSav_SaveMem(&snapshot, &capacity);
+	if (size == 0) {
+		free(snapshot);
+		return FALSE;
+	}
+	moviefp = fopen(filename, "wb");
+	if (moviefp == NULL) {
+		Log_print("Cannot open movie file %s", filename);
+		free(snapshot);
+		return FALSE;
+	}
+	fwrite("ATARIMOV", 1, 8, moviefp);
+	fwrite(&version, 1, 1, moviefp);
+	WriteULONG(POKEY_GetRandomCounter());
+	WriteULONG(size);
+	fwrite(snapshot, 1, size, moviefp);
+	free(snapshot);
+
+	/* The first frame stores all the input, see RecordFrame */
+	memset(last_input, 0, sizeof(last_input));
+	events = 0;
+	frame = 0;
+	recording = TRUE;
+	Log_print("Recording movie %s", filename);
+	return TRUE;
+}
+
+int MOVIE_StartPlayback(const char *filename, int verify)
+{
+	char magic[8];
+	UBYTE version;
+	ULONG random_counter;
+	ULONG size;
+	UBYTE *snapshot;
+	int result;
+
+	MOVIE_Stop();
+	moviefp = fopen(filename, "rb");
+	if (moviefp == NULL) {
+		Log_print("Cannot open movie file %s", filename);
+		return FALSE;
+	}
+	if (fread(magic, 1, 8, moviefp) != 8 || memcmp(magic, "ATARIMOV", 8) != 0
+	    || fread(&version, 1, 1, moviefp) != 1) {
+		Log_print("%s is not a movie file", filename);
+		MOVIE_Stop();
+		return FALSE;
+	}
+	if (version > MOVIE_VERSION) {
+		Log_print("Newer version of movie file than this version of Atari800 can handle");
+		MOVIE_Stop();
+		return FALSE;
+	}
+	if (!ReadULONG(&random_counter) || !ReadULONG(&size)) {
+		Log_print("Invalid movie file");
+		MOVIE_Stop();
+		return FALSE;
+	}
+	snapshot = (UBYTE *) Util_malloc(size);
+	result = fread(snapshot, 1, size, moviefp) == size && StateSav_ReadMem(snapshot, size);
+	free(snapshot);
+	if (!result) {
+		Log_print("Cannot restore the state stored in the movie");
+		MOVIE_Stop();
+		return FALSE;
+	}
+	POKEY_SetRandomCounter(random_counter);
+
+	memset(last_input, 0, sizeof(last_input));
+	frame = 0;
+	MOVIE_mismatches = 0;
+	playingback = TRUE;
+	verifying = verify;
+	Log_print("Playing movie %s", filename);
+	return TRUE;
+}
+
+void MOVIE_Stop(void)
+{
+	if (moviefp != NULL) {
+		fclose(moviefp);
+		moviefp = NULL;
+	}
+	if (playingback) {
+		if (verifying)
+			Log_print("Movie verified: %lu frames, %d did not match",
+			          (unsigned long) frame, MOVIE_mismatches);
+		else
+			Log_print("Movie finished after %lu frames", (unsigned long) frame);
+	}
+	recording = FALSE;
+	playingback = FALSE;
+	verifying = FALSE;
+}
+
+int MOVIE_Recording(void)
+{
+	return recording;
+}
+
+int MOVIE_Playingback(void)
+{
+	return playingback;
+}
+
+void MOVIE_Event(int event)
+{
+	if (recording)
+		events |= event;
+}
+
+static void RecordFrame(void)
+{
+	UBYTE input[IN_SIZE];
+	UBYTE changed[IN_SIZE];
+	ULONG mask = 0;
+	int n = 0;
+	int i;
+
+	GetInput(input);
+	events = 0;
+	for (i = 0; i < IN_SIZE; i++) {
+		if (input[i] != last_input[i] || frame == 0) {
+			mask |= 1 << i;
+			changed[n++] = input[i];
+		}
+	}
+	memcpy(last_input, input, IN_SIZE);
+	fputc(mask & 0xff, moviefp);
+	fputc((mask >> 8) & 0xff, moviefp);
+	fputc((mask >> 16) & 0xff, moviefp);
+	fwrite(changed, 1, n, moviefp);
+}
+
+static int PlayFrame(void)
+{
+	UBYTE buf[3];
+	ULONG mask;
+	int i;
+
+	if (fread(buf, 1, 3, moviefp) != 3)
+		return FALSE;
+	mask = buf[0] | (buf[1] << 8) | (buf[2] << 16);
+	/* Events only last for one frame */
+	last_input[IN_EVENTS] = 0;
+	for (i = 0; i < IN_SIZE; i++) {
+		if (mask & (1 << i)) {
+			int c = fgetc(moviefp);
+			if (c == EOF)
+				return FALSE;
+			last_input[i] = (UBYTE) c;
+		}
+	}
+	if (!ReadULONG(&recorded_crc))
+		return FALSE;
+	SetInput(last_input);
+	return TRUE;
+}
+
+void MOVIE_StartFrame(void)
+{
+	switch (pending) {
+	case PENDING_RECORD:
+		MOVIE_StartRecording(pending_filename);
+		break;
+	case PENDING_PLAY:
+	case PENDING_VERIFY:
+		MOVIE_StartPlayback(pending_filename, pending == PENDING_VERIFY);
+		break;
+	default:
+		break;
+	}
+	pending = PENDING_NONE;
+
+	if (recording)
+		RecordFrame();
+	else if (playingback && !PlayFrame())
+		MOVIE_Stop();
+}
+
+void MOVIE_EndFrame(void)
+{
+	ULONG crc;
+
+	if (!recording && !verifying)
+		return;
+	crc = ScreenCRC();
+	if (recording)
+		WriteULONG(crc);
+	else if (crc != recorded_crc) {
+		if (++MOVIE_mismatches <= MAX_LOGGED_MISMATCHES)
+			Log_print("Movie frame %lu: screen CRC %08lX, recorded %08lX",
+			          (unsigned long) frame, (unsigned long) crc, (unsigned long) recorded_crc);
+	}
+	frame++;
+}
+
+/*
+vim:ts=4:sw=4:
+*/
@@ -0,0 +1,34 @@
+#ifndef MOVIE_H_
+#define MOVIE_H_
+
+#include "atari.h"
+
+/* Input movies: a snapshot of the machine followed by the input seen by
+   the emulated hardware in each frame, and a CRC of each frame's screen.
+   Playing a movie back reproduces the session frame by frame; in verify
+   mode the screen CRCs are compared with the recorded ones. */
+
+#define MOVIE_EVENT_COLDSTART 0x01
+#define MOVIE_EVENT_WARMSTART 0x02
+
+/* Number of frames whose screen did not match in the last playback */
+extern int MOVIE_mismatches;
+
+int MOVIE_Initialise(int *argc, char *argv[]);
+void MOVIE_Exit(void);
+
+int MOVIE_StartRecording(const char *filename);
+int MOVIE_StartPlayback(const char *filename, int verify);
+void MOVIE_Stop(void);
+int MOVIE_Recording(void);
+int MOVIE_Playingback(void);
+
+/* Called when the machine is reset, so the reset can be replayed */
+void MOVIE_Event(int event);
+/* Called before the frame, once all the input for it has been set:
+   records the input, or replaces it with the recorded one */
+void MOVIE_StartFrame(void);
+/* Called after ANTIC_Frame, records or checks the screen CRC */
+void MOVIE_EndFrame(void);
+
+#endif /* MOVIE_H_ */
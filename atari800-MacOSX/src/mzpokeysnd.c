@@ -24,6 +24,7 @@
 
 #include "config.h"
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 #ifdef ASAP /* external project, see http://asap.sf.net */
@@ -306,6 +307,9 @@ static int tick_pos;
 static double samp_pos;
 static int start_sample;
 static double ticks_per_sample;
+/* ticks_per_sample before the rate adjustment, and the adjustment itself */
+static double nominal_ticks_per_sample;
+static double rate_adjust = 1.0;
 UBYTE *MZPOKEYSND_process_buffer = NULL;
 static void render_to_tick(int last_tick);
 #endif
@@ -2535,9 +2539,11 @@ void init_mzpokeysnd_sync(void)
 		ticks_per_frame = Atari800_tv_mode*114;
 	else
 		ticks_per_frame = (int)(deltatime / 0.00006375)*114;
-	ticks_per_sample = (double)ticks_per_frame / samples_per_frame;
+	nominal_ticks_per_sample = (double)ticks_per_frame / samples_per_frame;
+	ticks_per_sample = nominal_ticks_per_sample / rate_adjust;
     tick_pos = 0;
-    bytes_per_frame = (int)ceil(num_cur_pokeys*samples_per_frame*((snd_flags & POKEYSND_BIT16) ? 2:1));
+    /* leave room for the most samples a rate adjustment can add */
+    bytes_per_frame = (int)ceil(num_cur_pokeys*(samples_per_frame*(1.0 + MZPOKEYSND_MAX_RATE_ADJUST) + 1)*((snd_flags & POKEYSND_BIT16) ? 2:1));
     free(MZPOKEYSND_process_buffer);
     MZPOKEYSND_process_buffer = (UBYTE *)Util_malloc(bytes_per_frame);
     memset(MZPOKEYSND_process_buffer, 0, bytes_per_frame);
@@ -2546,6 +2552,17 @@ void init_mzpokeysnd_sync(void)
     start_sample = 0;
 }
 
+void MZPOKEYSND_SetRateAdjust(double ratio)
+{
+    if (ratio > 1.0 + MZPOKEYSND_MAX_RATE_ADJUST)
+        ratio = 1.0 + MZPOKEYSND_MAX_RATE_ADJUST;
+    else if (ratio < 1.0 - MZPOKEYSND_MAX_RATE_ADJUST)
+        ratio = 1.0 - MZPOKEYSND_MAX_RATE_ADJUST;
+    rate_adjust = ratio;
+    if (nominal_ticks_per_sample > 0)
+        ticks_per_sample = nominal_ticks_per_sample / rate_adjust;
+}
+
 /* render sound into the buffer up to the specified tick position */
 static void render_to_tick(int last_tick)
 {
@@ -2620,6 +2637,39 @@ int MZPOKEYSND_UpdateProcessBuffer(void)
 #endif
     return result;
 }
+
+/* Sound generator state saved around run-ahead frames */
+static PokeyState saved_pokey_states[NPOKEYS];
+static int saved_tick_pos;
+static double saved_samp_pos;
+static int saved_start_sample;
+
+void MZPOKEYSND_SaveSoundState(void)
+{
+    memcpy(saved_pokey_states, pokey_states, sizeof(pokey_states));
+    saved_tick_pos = tick_pos;
+    saved_samp_pos = samp_pos;
+    saved_start_sample = start_sample;
+}
+
+void MZPOKEYSND_RestoreSoundState(void)
+{
+    memcpy(pokey_states, saved_pokey_states, sizeof(pokey_states));
+    tick_pos = saved_tick_pos;
+    samp_pos = saved_samp_pos;
+    start_sample = saved_start_sample;
+}
+
+int MZPOKEYSND_DiscardProcessBuffer(void)
+{
+    int result;
+    render_to_tick(ticks_per_frame);
+    samp_pos = samp_pos - (double)ticks_per_frame;
+    tick_pos = tick_pos - ticks_per_frame;
+    result = start_sample;
+    start_sample = 0;
+    return result;
+}
 #endif /* SYNCHRONIZED_SOUND */
 
 #ifdef SERIO_SOUND
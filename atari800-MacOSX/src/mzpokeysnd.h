@@ -16,6 +16,18 @@ int MZPOKEYSND_Init(ULONG freq17,
                        );
 
 #ifdef SYNCHRONIZED_SOUND
+/* Largest fraction by which MZPOKEYSND_SetRateAdjust may trim the rate */
+#define MZPOKEYSND_MAX_RATE_ADJUST 0.005
+/* Makes MZPOKEYSND_UpdateProcessBuffer produce RATIO times the nominal
+   number of samples per frame, for dynamic rate control */
+void MZPOKEYSND_SetRateAdjust(double ratio);
+/* Save and restore the sound generator around frames that are emulated
+   but not heard, e.g. for run-ahead */
+void MZPOKEYSND_SaveSoundState(void);
+void MZPOKEYSND_RestoreSoundState(void);
+/* Ends a frame like MZPOKEYSND_UpdateProcessBuffer without passing the
+   samples on */
+int MZPOKEYSND_DiscardProcessBuffer(void);
 #endif /* SYNCHRONIZED_SOUND */
 int MZPOKEYSND_UpdateProcessBuffer(void);
 extern UBYTE *MZPOKEYSND_process_buffer;
@@ -14,11 +14,12 @@
 #include <pthread.h>
 #include <sys/types.h>
 #include <sys/socket.h>
-#include <sys/ioctl.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <time.h>
+#include <sys/time.h>
+#include <stdatomic.h>
 #include "netsio.h"
 #include "log.h"
 #include "pia.h" /* For toggling PROC & INT */
@@ -42,8 +43,19 @@ int netsio_cmd_state = 0;
 /* data frame size for SIO write commands */
 volatile int netsio_next_write_size = 0;
 
-/* FIFO pipe: fds0: FujiNet->emulator */
-int fds0[2];
+/* FujiNet->emulator byte FIFO.  fujinet_rx_thread is the only writer and
+   the emulator the only reader, so the two indices are enough to share it
+   without a lock.  They run freely and are masked on access. */
+#define RX_RING_SIZE 65536
+static uint8_t rx_ring[RX_RING_SIZE];
+static atomic_uint rx_head; /* next byte to write, owned by the rx thread */
+static atomic_uint rx_tail; /* next byte to read, owned by the emulator */
+
+/* Signalled by fujinet_rx_thread when the sync response clears netsio_sync_wait */
+static pthread_mutex_t sync_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sync_cond = PTHREAD_COND_INITIALIZER;
+/* how long netsio_wait_for_sync waits for FujiNet-PC to answer */
+#define SYNC_TIMEOUT_MS 40
 
 /* UDP socket for NetSIO and return address holder */
 static int sockfd = -1;
@@ -88,23 +100,35 @@ char *buf_to_hex(const uint8_t *buf, size_t offset, size_t len) {
 
 /* write data to emulator FIFO (fujinet_rx_thread) */
 static void enqueue_to_emulator(const uint8_t *pkt, size_t len) {
-    ssize_t n;
+    unsigned int head = atomic_load_explicit(&rx_head, memory_order_relaxed);
     while (len > 0)
     {
-        n = write(fds0[1], pkt, len);
-        if (n < 0)
+        unsigned int tail = atomic_load_explicit(&rx_tail, memory_order_acquire);
+        if (head - tail >= RX_RING_SIZE)
         {
-            if (errno == EINTR) continue;
-#ifdef DEBUG
-            Log_print("netsio: write to emulator FIFO");
-#endif
-            /*exit(1);*/
+            /* full: the emulator has fallen behind, let it catch up */
+            millisleep(1);
+            if (!netsio_enabled && sockfd < 0)
+                return;
+            continue;
         }
-        pkt += n;
-        len -= n;
+        rx_ring[head & (RX_RING_SIZE - 1)] = *pkt++;
+        head++;
+        len--;
+        /* publish each byte so the emulator can start on it */
+        atomic_store_explicit(&rx_head, head, memory_order_release);
     }
 }
 
+/* clear netsio_sync_wait and wake netsio_wait_for_sync */
+static void release_sync_wait(void)
+{
+    pthread_mutex_lock(&sync_mutex);
+    netsio_sync_wait = 0;
+    pthread_cond_broadcast(&sync_cond);
+    pthread_mutex_unlock(&sync_mutex);
+}
+
 /* send a packet to FujiNet socket */
 static void send_to_fujinet(const uint8_t *pkt, size_t len) {
     ssize_t n;
@@ -216,16 +240,9 @@ int netsio_init(uint16_t port) {
     /* Store the configured port */
     netsio_port = port;
 
-    /* create emulator <-> netsio FIFOs */
-    if (pipe(fds0) < 0)
-    {
-#ifdef DEBUG
-        Log_print("netsio: pipe creation error");
-#endif
-        return -1;
-    }
-
-    /* fcntl(fds0[0], F_SETFL, O_NONBLOCK); */
+    /* empty the FujiNet -> emulator FIFO */
+    atomic_store(&rx_head, 0);
+    atomic_store(&rx_tail, 0);
 
     /* connect socket to FujiNet */
     sockfd = socket(AF_INET, SOCK_DGRAM, 0);
@@ -321,57 +338,53 @@ void netsio_shutdown(void) {
         sockfd = -1;
     }
     
-    /* Close FIFO pipes if they're open */
-    if (fds0[0] >= 0) {
-        close(fds0[0]);
-        fds0[0] = -1;
-    }
-    if (fds0[1] >= 0) {
-        close(fds0[1]);
-        fds0[1] = -1;
-    }
+    /* Drop anything still queued for the emulator */
+    atomic_store(&rx_tail, atomic_load(&rx_head));
     
     /* Reset state variables */
     fujinet_known = 0;
-    netsio_sync_wait = 0;
+    release_sync_wait();
     netsio_cmd_state = 0;
     netsio_next_write_size = 0;
     netsio_sync_num = 0;
 }
 
-/* Called when a command frame with sync response is sent to FujiNet */
+/* Called when a command frame with sync response is sent to FujiNet.
+   Returns as soon as fujinet_rx_thread handles the response, or gives up
+   after SYNC_TIMEOUT_MS. */
 void netsio_wait_for_sync(void)
 {
-    int ticker = 0;
+    struct timeval now;
+    struct timespec deadline;
+
+    gettimeofday(&now, NULL);
+    deadline.tv_sec = now.tv_sec + SYNC_TIMEOUT_MS / 1000;
+    deadline.tv_nsec = (now.tv_usec + (SYNC_TIMEOUT_MS % 1000) * 1000L) * 1000L;
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&sync_mutex);
     while (netsio_sync_wait)
     {
 #ifdef DEBUG
-        Log_print("netsio: waiting for sync response - %d", ticker);
+        Log_print("netsio: waiting for sync response");
 #endif
-        millisleep(5);
-        if (ticker > 7)
+        if (pthread_cond_timedwait(&sync_cond, &sync_mutex, &deadline) == ETIMEDOUT)
         {
             netsio_sync_wait = 0;
             break;
         }
-        ticker++;
     }
+    pthread_mutex_unlock(&sync_mutex);
 }
 
 /* Return number of bytes waiting from FujiNet to emulator */
 int netsio_available(void) {
-    int avail = 0;
-    if (fds0[0] >= 0)
-    {
-        if (ioctl(fds0[0], FIONREAD, &avail) < 0)
-        {
-#ifdef DEBUG
-            Log_print("netsio_avail: ioctl error");
-#endif
-            return -1;
-        }
-    }
-    return avail;
+    return (int)(atomic_load_explicit(&rx_head, memory_order_acquire) -
+                 atomic_load_explicit(&rx_tail, memory_order_relaxed));
 }
 
 /* COMMAND ON */
@@ -409,8 +422,9 @@ int netsio_cmd_off_sync(void)
 #ifdef DEBUG
     Log_print("netsio: CMD OFF SYNC");
 #endif
-    send_to_fujinet(p, sizeof(p));
+    /* set before sending, the response may arrive before send returns */
     netsio_sync_wait = 1; /* pause emulation until we hear back or timeout */
+    send_to_fujinet(p, sizeof(p));
     return 0;
 }
 
@@ -479,24 +493,18 @@ int netsio_send_byte_sync(uint8_t b)
 #ifdef DEBUG
     Log_print("netsio: send byte: 0x%02X sync: %d", b, netsio_sync_num);
 #endif
+    netsio_sync_wait = 1; /* pause emulation until we hear back or timeout */
     send_to_fujinet(p, sizeof(p));
-    netsio_sync_wait = 1; /* pause emulation until we hear back or timeout s*/
     return 0;
 }
 
 /* The emulator calls this to receive a data byte from FujiNet */
 int netsio_recv_byte(uint8_t *b) {
-    ssize_t n = read(fds0[0], b, 1);
-    if (n < 0)
-    {
-        if (errno == EINTR) return netsio_recv_byte(b);
-#ifdef DEBUG
-        Log_print("netsio: read from rx FIFO");
-#endif
-        return -1;
-    }
-    if (n == 0)
-        return -1; /* FIFO closed? */
+    unsigned int tail = atomic_load_explicit(&rx_tail, memory_order_relaxed);
+    if (atomic_load_explicit(&rx_head, memory_order_acquire) == tail)
+        return -1; /* FIFO empty */
+    *b = rx_ring[tail & (RX_RING_SIZE - 1)];
+    atomic_store_explicit(&rx_tail, tail + 1, memory_order_release);
 #ifdef DEBUG2
     Log_print("netsio: read to emu: %02X", (unsigned)*b);
 #endif
@@ -735,7 +743,7 @@ static void *fujinet_rx_thread(void *arg) {
 #endif
                     }
                 }
-                netsio_sync_wait = 0; /* continue emulation */
+                release_sync_wait(); /* continue emulation */
                 break;
             }
 
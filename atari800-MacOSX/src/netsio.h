@@ -53,10 +53,6 @@ extern volatile int netsio_sync_wait;
 extern int netsio_cmd_state;
 extern volatile int netsio_next_write_size;
 
-/* FIFO pipes: fds0: FujiNet->emulator
-*/
-extern int fds0[2];
-
 /* Initialize NetSIO subsystem, connecting to FujiNet-PC at host:port. */
 /* Returns 0 on success, non-zero on error. */
 int netsio_init(uint16_t port);
@@ -79,6 +75,7 @@ int netsio_send_byte_sync(uint8_t b);
 
 /* Dequeue one byte received from FujiNet-PC. */
 /* Returns 0 on success, -1 if FIFO is empty. */
+/* Safe to call without a lock: only the emulator thread reads the FIFO. */
 int netsio_recv_byte(uint8_t *b);
 
 int netsio_cmd_on(void);
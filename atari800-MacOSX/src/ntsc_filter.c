@@ -0,0 +1,322 @@
+/*
+ * ntsc_filter.c - Threaded and vectorised atari_ntsc blitter
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "config.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ntsc_filter.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#define NTSC_SSE2
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define NTSC_NEON
+#endif
+
+/* atari_ntsc_blit keeps the 8 kernels that overlap an output pixel in
+   k0-k7 and sums them pixel by pixel. Turned around, each input pixel adds
+   a 14 entry kernel, chosen by its colour and its position in its group of
+   4, to the 14 output pixels from 2 * position on in the group's 7. Here
+   the 4 kernels of a group are summed in vectors, then added to the row.
+   The sums only ever need the low 32 bits, so the kernels are ULONGs. */
+#define KERNEL_SIZE 14
+/* A kernel stored at lane 2 * position, the 4 of a group line up */
+#define GROUP_LANES 20
+/* atari_ntsc_blit starts and ends each row with 2 groups of colour 0 */
+#define LEAD_GROUPS 2
+#define TAIL_GROUPS 2
+#define MAX_GROUPS (NTSC_FILTER_MAX_IN_WIDTH / 4 + LEAD_GROUPS + TAIL_GROUPS)
+#define ROW_LANES (MAX_GROUPS * 7 + GROUP_LANES)
+/* Fewer rows than this per band are not worth waking a thread for */
+#define MIN_BAND_ROWS 16
+
+/* As in atari_ntsc.c */
+#define MAKE_KMASK(x) (((x) << 20) | ((x) << 10) | (x))
+#define CLAMP_RGB(io) {\
+	ULONG sub = (io) >> 7 & MAKE_KMASK(3);\
+	ULONG clamp = MAKE_KMASK(0x202) - sub;\
+	io = ((io) | clamp) & (clamp - sub);\
+}
+#define TO_RGB(in) (((in) >> 11 & 0xF800) | ((in) >> 6 & 0x07C0) | ((in) >> 2 & 0x001F))
+
+/* [colour][position][GROUP_LANES] */
+static ULONG *kernels = NULL;
+
+static pthread_t *helpers = NULL;
+static int helper_count = 0;
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+static unsigned int generation = 0;
+static int bands_left;
+static int stopping = FALSE;
+
+/* The blit the helpers work on */
+static UBYTE const *job_in;
+static long job_in_pitch;
+static int job_groups;
+static int job_height;
+static UWORD *job_out;
+static long job_out_pitch;
+static int job_bands;
+
+/* Adds the kernels of the 4 pixels of group IN to the 20 output pixels
+   from ACC on */
+static void AddGroup(UBYTE const *in, ULONG *acc)
+{
+	ULONG const *k0 = kernels + (in[0] * 4 + 0) * GROUP_LANES;
+	ULONG const *k1 = kernels + (in[1] * 4 + 1) * GROUP_LANES;
+	ULONG const *k2 = kernels + (in[2] * 4 + 2) * GROUP_LANES;
+	ULONG const *k3 = kernels + (in[3] * 4 + 3) * GROUP_LANES;
+	int i;
+
+#if defined(NTSC_SSE2)
+	for (i = 0; i < GROUP_LANES; i += 4) {
+		__m128i sum = _mm_add_epi32(
+			_mm_add_epi32(_mm_loadu_si128((__m128i const *) (k0 + i)),
+			              _mm_loadu_si128((__m128i const *) (k1 + i))),
+			_mm_add_epi32(_mm_loadu_si128((__m128i const *) (k2 + i)),
+			              _mm_loadu_si128((__m128i const *) (k3 + i))));
+		_mm_storeu_si128((__m128i *) (acc + i),
+		                 _mm_add_epi32(_mm_loadu_si128((__m128i const *) (acc + i)), sum));
+	}
+#elif defined(NTSC_NEON)
+	for (i = 0; i < GROUP_LANES; i += 4) {
+		uint32x4_t sum = vaddq_u32(vaddq_u32(vld1q_u32(k0 + i), vld1q_u32(k1 + i)),
+		                           vaddq_u32(vld1q_u32(k2 + i), vld1q_u32(k3 + i)));
+		vst1q_u32(acc + i, vaddq_u32(vld1q_u32(acc + i), sum));
+	}
+#else
+	for (i = 0; i < GROUP_LANES; i++)
+		acc[i] += k0[i] + k1[i] + k2[i] + k3[i];
+#endif
+}
+
+/* Clamps N sums and converts them to 5-6-5 */
+static void Convert(ULONG const *acc, int n, UWORD *out)
+{
+	int i = 0;
+
+#if defined(NTSC_SSE2)
+	__m128i const mask3 = _mm_set1_epi32(MAKE_KMASK(3));
+	__m128i const mask202 = _mm_set1_epi32(MAKE_KMASK(0x202));
+
+	for (; i + 8 <= n; i += 8) {
+		__m128i rgb[2];
+		int j;
+
+		for (j = 0; j < 2; j++) {
+			__m128i io = _mm_loadu_si128((__m128i const *) (acc + i + j * 4));
+			__m128i sub = _mm_and_si128(_mm_srli_epi32(io, 7), mask3);
+			__m128i clamp = _mm_sub_epi32(mask202, sub);
+
+			io = _mm_and_si128(_mm_or_si128(io, clamp), _mm_sub_epi32(clamp, sub));
+			io = _mm_or_si128(
+				_mm_or_si128(_mm_and_si128(_mm_srli_epi32(io, 11), _mm_set1_epi32(0xF800)),
+				             _mm_and_si128(_mm_srli_epi32(io, 6), _mm_set1_epi32(0x07C0))),
+				_mm_and_si128(_mm_srli_epi32(io, 2), _mm_set1_epi32(0x001F)));
+			/* sign extend, so the signed pack keeps the 16 bits */
+			rgb[j] = _mm_srai_epi32(_mm_slli_epi32(io, 16), 16);
+		}
+		_mm_storeu_si128((__m128i *) (out + i), _mm_packs_epi32(rgb[0], rgb[1]));
+	}
+#elif defined(NTSC_NEON)
+	uint32x4_t const mask3 = vdupq_n_u32(MAKE_KMASK(3));
+	uint32x4_t const mask202 = vdupq_n_u32(MAKE_KMASK(0x202));
+
+	for (; i + 8 <= n; i += 8) {
+		uint16x4_t rgb[2];
+		int j;
+
+		for (j = 0; j < 2; j++) {
+			uint32x4_t io = vld1q_u32(acc + i + j * 4);
+			uint32x4_t sub = vandq_u32(vshrq_n_u32(io, 7), mask3);
+			uint32x4_t clamp = vsubq_u32(mask202, sub);
+
+			io = vandq_u32(vorrq_u32(io, clamp), vsubq_u32(clamp, sub));
+			io = vorrq_u32(
+				vorrq_u32(vandq_u32(vshrq_n_u32(io, 11), vdupq_n_u32(0xF800)),
+				          vandq_u32(vshrq_n_u32(io, 6), vdupq_n_u32(0x07C0))),
+				vandq_u32(vshrq_n_u32(io, 2), vdupq_n_u32(0x001F)));
+			rgb[j] = vmovn_u32(io);
+		}
+		vst1q_u16(out + i, vcombine_u16(rgb[0], rgb[1]));
+	}
+#endif
+	for (; i < n; i++) {
+		ULONG io = acc[i];
+
+		CLAMP_RGB(io);
+		out[i] = (UWORD) TO_RGB(io);
+	}
+}
+
+static void FilterRow(UBYTE const *in, int groups, UWORD *out)
+{
+	ULONG acc[ROW_LANES];
+	UBYTE line[MAX_GROUPS * 4];
+	int total = LEAD_GROUPS + groups + TAIL_GROUPS;
+	int g;
+
+	memset(line, 0, LEAD_GROUPS * 4);
+	memcpy(line + LEAD_GROUPS * 4, in, groups * 4);
+	memset(line + (LEAD_GROUPS + groups) * 4, 0, TAIL_GROUPS * 4);
+	memset(acc, 0, (total * 7 + GROUP_LANES) * sizeof(ULONG));
+	for (g = 0; g < total; g++)
+		AddGroup(line + g * 4, acc + g * 7);
+	Convert(acc + LEAD_GROUPS * 7, NTSC_FILTER_OUT_WIDTH(groups * 4), out);
+}
+
+static void DrawBand(int band)
+{
+	int first = job_height * band / job_bands;
+	int last = job_height * (band + 1) / job_bands;
+	int y;
+
+	for (y = first; y < last; y++)
+		FilterRow(job_in + y * job_in_pitch, job_groups,
+		          (UWORD *) ((UBYTE *) job_out + y * job_out_pitch));
+}
+
+static void *Helper(void *arg)
+{
+	int band = (int) (intptr_t) arg;
+	unsigned int seen = 0;
+
+	pthread_mutex_lock(&pool_mutex);
+	for (;;) {
+		while (generation == seen && !stopping)
+			pthread_cond_wait(&pool_start, &pool_mutex);
+		if (stopping)
+			break;
+		seen = generation;
+		pthread_mutex_unlock(&pool_mutex);
+
+		if (band < job_bands)
+			DrawBand(band);
+
+		pthread_mutex_lock(&pool_mutex);
+		if (--bands_left == 0)
+			pthread_cond_signal(&pool_done);
+	}
+	pthread_mutex_unlock(&pool_mutex);
+	return NULL;
+}
+
+int NTSC_FILTER_Initialise(int threads)
+{
+	NTSC_FILTER_Exit();
+	kernels = (ULONG *) calloc(atari_ntsc_color_count * 4 * GROUP_LANES, sizeof(ULONG));
+	if (kernels == NULL)
+		return FALSE;
+	stopping = FALSE;
+	if (threads > 0) {
+		helpers = (pthread_t *) malloc(threads * sizeof(pthread_t));
+		if (helpers != NULL)
+			/* band 0 is drawn by the caller */
+			while (helper_count < threads &&
+			       pthread_create(&helpers[helper_count], NULL, Helper,
+			                      (void *) (intptr_t) (helper_count + 1)) == 0)
+				helper_count++;
+	}
+	return TRUE;
+}
+
+void NTSC_FILTER_SetKernels(atari_ntsc_t const *emu)
+{
+	int colour;
+	int position;
+	int i;
+
+	if (kernels == NULL)
+		return;
+	for (colour = 0; colour < atari_ntsc_color_count; colour++)
+		for (position = 0; position < 4; position++) {
+			ULONG *k = kernels + (colour * 4 + position) * GROUP_LANES;
+
+			memset(k, 0, GROUP_LANES * sizeof(ULONG));
+			for (i = 0; i < KERNEL_SIZE; i++)
+				k[position * 2 + i] = (ULONG) emu->table[colour][position * KERNEL_SIZE + i];
+		}
+}
+
+void NTSC_FILTER_Blit(UBYTE const *in, long in_pitch, int in_width, int height,
+                      UWORD *out, long out_pitch)
+{
+	if (kernels == NULL || height <= 0)
+		return;
+	job_in = in;
+	job_in_pitch = in_pitch;
+	job_groups = (in_width > NTSC_FILTER_MAX_IN_WIDTH ? NTSC_FILTER_MAX_IN_WIDTH : in_width) / 4;
+	job_height = height;
+	job_out = out;
+	job_out_pitch = out_pitch;
+	job_bands = height / MIN_BAND_ROWS;
+	if (job_bands > helper_count + 1)
+		job_bands = helper_count + 1;
+	if (job_bands <= 1) {
+		job_bands = 1;
+		DrawBand(0);
+		return;
+	}
+
+	pthread_mutex_lock(&pool_mutex);
+	bands_left = helper_count;
+	generation++;
+	pthread_cond_broadcast(&pool_start);
+	pthread_mutex_unlock(&pool_mutex);
+
+	DrawBand(0);
+
+	pthread_mutex_lock(&pool_mutex);
+	while (bands_left > 0)
+		pthread_cond_wait(&pool_done, &pool_mutex);
+	pthread_mutex_unlock(&pool_mutex);
+}
+
+void NTSC_FILTER_Exit(void)
+{
+	int i;
+
+	if (helper_count > 0) {
+		pthread_mutex_lock(&pool_mutex);
+		stopping = TRUE;
+		pthread_cond_broadcast(&pool_start);
+		pthread_mutex_unlock(&pool_mutex);
+		for (i = 0; i < helper_count; i++)
+			pthread_join(helpers[i], NULL);
+	}
+	free(helpers);
+	helpers = NULL;
+	helper_count = 0;
+	free(kernels);
+	kernels = NULL;
+}
+
+/*
+vim:ts=4:sw=4:
+*/
@@ -0,0 +1,28 @@
+#ifndef NTSC_FILTER_H_
+#define NTSC_FILTER_H_
+
+#include "atari.h"
+#include "atari_ntsc.h"
+
+/* The atari_ntsc composite filter for a whole screen. The rows are split
+   in bands drawn in parallel by a few threads, and the kernels of each
+   output pixel are summed with SSE2 on x86-64 and NEON on arm64. The
+   output is the same as atari_ntsc_blit's, which stays the reference.
+   util/ntscbench.c times it and checks it against atari_ntsc_blit. */
+
+/* Output pixels for IN_WIDTH input pixels (a multiple of 4) */
+#define NTSC_FILTER_OUT_WIDTH(in_width) ((in_width) / 4 * 7 + 10)
+#define NTSC_FILTER_MAX_IN_WIDTH 384
+
+/* Starts THREADS helper threads, 0 draws everything on the calling
+   thread. Returns FALSE if the kernel table can not be allocated. */
+int NTSC_FILTER_Initialise(int threads);
+/* Takes the kernels of EMU, to call again after each atari_ntsc_init */
+void NTSC_FILTER_SetKernels(atari_ntsc_t const *emu);
+/* Filters HEIGHT rows of IN_WIDTH pixels into
+   NTSC_FILTER_OUT_WIDTH(IN_WIDTH) 5-6-5 pixels each. Pitches in bytes. */
+void NTSC_FILTER_Blit(UBYTE const *in, long in_pitch, int in_width, int height,
+                      UWORD *out, long out_pitch);
+void NTSC_FILTER_Exit(void);
+
+#endif /* NTSC_FILTER_H_ */
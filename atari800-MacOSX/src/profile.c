@@ -0,0 +1,362 @@
+/*
+ * profile.c - 6502 execution profiler with a call tree
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "antic.h"
+#include "atari.h"
+#include "log.h"
+#include "memory.h"
+#include "pia.h"
+#include "profile.h"
+#include "util.h"
+
+#ifdef MONITOR_PROF
+
+/* 1088 KB has 64 XE banks, plus the main memory */
+#define MAX_BANKS 65
+
+/* Call tree size; calls beyond it are charged to the caller */
+#define MAX_NODES 16384
+#define NODE_HASH_SIZE 32768	/* power of 2, at least twice MAX_NODES */
+#define MAX_DEPTH 256
+
+typedef struct {
+	ULONG count;
+	ULONG cycles;
+	ULONG stolen;
+} counter;
+
+typedef struct {
+	int parent;
+	UWORD addr;
+	UBYTE bank;
+	uint64_t cycles;		/* own and stolen cycles spent in the node itself */
+} node;
+
+typedef struct {
+	int node;
+	UBYTE sp;
+} frame;
+
+int PROFILE_active = FALSE;
+int PROFILE_node = 0;
+
+/* counters[0] covers the whole 64 KB, counters[1..64] only $4000-$7FFF of
+   each XE bank. Allocated when first needed. */
+static counter *counters[MAX_BANKS];
+
+static node *nodes = NULL;
+static int num_nodes;
+static int *node_hash = NULL;
+static int nodes_full;
+
+static frame stack[MAX_DEPTH];
+static int depth;
+
+/* ANTIC_CPU_CLOCK at the end of the last instruction */
+static unsigned int last_clock;
+
+/* Bank the CPU sees at $4000-$7FFF */
+static int CpuBank(void)
+{
+	if (Atari800_machine_type == Atari800_MACHINE_XLXE && MEMORY_ram_size > 64
+	    && ((PIA_PORTB | PIA_PORTB_mask) & 0x10) == 0)
+		return MEMORY_xe_bank;
+	return 0;
+}
+
+static counter *Counter(UWORD pc, int bank)
+{
+	int index = 0;
+	int size = 0x10000;
+
+	if (bank != 0 && pc >= 0x4000 && pc < 0x8000) {
+		index = bank;
+		size = 0x4000;
+		pc -= 0x4000;
+	}
+	if (counters[index] == NULL) {
+		counters[index] = (counter *) Util_malloc(size * sizeof(counter));
+		memset(counters[index], 0, size * sizeof(counter));
+	}
+	return counters[index] + pc;
+}
+
+static unsigned int NodeHash(int parent, UWORD addr, int bank)
+{
+	return ((unsigned int) parent * 0x9e3779b1U ^ (bank << 16 | addr)) & (NODE_HASH_SIZE - 1);
+}
+
+/* The child of PARENT for a call to ADDR, created if new */
+static int Child(int parent, UWORD addr, int bank)
+{
+	unsigned int h = NodeHash(parent, addr, bank);
+	int n;
+
+	while ((n = node_hash[h]) >= 0) {
+		if (nodes[n].parent == parent && nodes[n].addr == addr && nodes[n].bank == bank)
+			return n;
+		h = (h + 1) & (NODE_HASH_SIZE - 1);
+	}
+	if (num_nodes >= MAX_NODES) {
+		nodes_full = TRUE;
+		return parent;
+	}
+	n = num_nodes++;
+	nodes[n].parent = parent;
+	nodes[n].addr = addr;
+	nodes[n].bank = (UBYTE) bank;
+	nodes[n].cycles = 0;
+	node_hash[h] = n;
+	return n;
+}
+
+void PROFILE_Clear(void)
+{
+	int i;
+
+	for (i = 0; i < MAX_BANKS; i++)
+		if (counters[i] != NULL)
+			memset(counters[i], 0, (i == 0 ? 0x10000 : 0x4000) * sizeof(counter));
+	if (nodes != NULL) {
+		/* node 0 is the code that runs outside any call seen */
+		nodes[0].parent = -1;
+		nodes[0].addr = 0;
+		nodes[0].bank = 0;
+		nodes[0].cycles = 0;
+		num_nodes = 1;
+		for (i = 0; i < NODE_HASH_SIZE; i++)
+			node_hash[i] = -1;
+	}
+	nodes_full = FALSE;
+	depth = 0;
+	PROFILE_node = 0;
+	last_clock = ANTIC_CPU_CLOCK;
+}
+
+void PROFILE_Start(void)
+{
+	if (nodes == NULL) {
+		nodes = (node *) Util_malloc(MAX_NODES * sizeof(node));
+		node_hash = (int *) Util_malloc(NODE_HASH_SIZE * sizeof(int));
+		PROFILE_Clear();
+	}
+	/* the calls made while stopped are not known */
+	depth = 0;
+	PROFILE_node = 0;
+	last_clock = ANTIC_CPU_CLOCK;
+	PROFILE_active = TRUE;
+}
+
+void PROFILE_Stop(void)
+{
+	PROFILE_active = FALSE;
+}
+
+void PROFILE_Instruction(UWORD pc, int node, int cycles)
+{
+	unsigned int clock = ANTIC_CPU_CLOCK;
+	/* the time since the last instruction that the CPU did not run for
+	   itself was spent halted by ANTIC, before this instruction */
+	int stolen = (int) (clock - last_clock) - cycles;
+	counter *c = Counter(pc, pc >= 0x4000 && pc < 0x8000 ? CpuBank() : 0);
+
+	if (stolen < 0 || stolen > ANTIC_LINE_C * 2)
+		stolen = 0;			/* frame boundaries, state loads */
+	last_clock = clock;
+	c->count++;
+	c->cycles += cycles;
+	c->stolen += stolen;
+	nodes[node].cycles += cycles + stolen;
+}
+
+void PROFILE_Call(UWORD target, UBYTE sp)
+{
+	int child = Child(PROFILE_node, target, target >= 0x4000 && target < 0x8000 ? CpuBank() : 0);
+
+	if (depth < MAX_DEPTH) {
+		stack[depth].node = PROFILE_node;
+		stack[depth].sp = sp;
+		depth++;
+		PROFILE_node = child;
+	}
+}
+
+void PROFILE_Return(UBYTE sp)
+{
+	/* pop every call whose return address is now above the stack, which
+	   also unwinds code that drops return addresses with PLA */
+	while (depth > 0 && stack[depth - 1].sp < sp) {
+		depth--;
+		PROFILE_node = stack[depth].node;
+	}
+}
+
+int PROFILE_Top(PROFILE_entry *entries, int max)
+{
+	int n = 0;
+	int bank;
+
+	if (max <= 0)
+		return 0;
+	for (bank = 0; bank < MAX_BANKS; bank++) {
+		const counter *c = counters[bank];
+		int size = bank == 0 ? 0x10000 : 0x4000;
+		int i;
+
+		if (c == NULL)
+			continue;
+		for (i = 0; i < size; i++) {
+			uint64_t total = (uint64_t) c[i].cycles + c[i].stolen;
+			int j;
+
+			if (c[i].count == 0)
+				continue;
+			if (n == max && entries[n - 1].cycles + entries[n - 1].stolen >= total)
+				continue;
+			/* insertion into the sorted list, dropping the last if full */
+			j = n < max ? n++ : n - 1;
+			for (; j > 0 && entries[j - 1].cycles + entries[j - 1].stolen < total; j--)
+				entries[j] = entries[j - 1];
+			entries[j].addr = (UWORD) (bank == 0 ? i : 0x4000 + i);
+			entries[j].bank = (UBYTE) bank;
+			entries[j].count = c[i].count;
+			entries[j].cycles = c[i].cycles;
+			entries[j].stolen = c[i].stolen;
+		}
+	}
+	return n;
+}
+
+void PROFILE_Totals(ULONG *instructions, uint64_t *cycles, uint64_t *stolen)
+{
+	int bank;
+
+	*instructions = 0;
+	*cycles = 0;
+	*stolen = 0;
+	for (bank = 0; bank < MAX_BANKS; bank++) {
+		const counter *c = counters[bank];
+		int size = bank == 0 ? 0x10000 : 0x4000;
+		int i;
+
+		if (c == NULL)
+			continue;
+		for (i = 0; i < size; i++) {
+			*instructions += c[i].count;
+			*cycles += c[i].cycles;
+			*stolen += c[i].stolen;
+		}
+	}
+}
+
+static void PrintFrame(FILE *fp, int n, const char *(*name)(UWORD addr))
+{
+	const char *label;
+
+	if (nodes[n].parent < 0) {
+		fputs("6502", fp);
+		return;
+	}
+	PrintFrame(fp, nodes[n].parent, name);
+	label = name != NULL ? name(nodes[n].addr) : NULL;
+	if (label != NULL)
+		fprintf(fp, ";%s", label);
+	else
+		fprintf(fp, ";$%04X", nodes[n].addr);
+	if (nodes[n].bank != 0)
+		fprintf(fp, "@%d", nodes[n].bank);
+}
+
+int PROFILE_SaveFolded(const char *filename, const char *(*name)(UWORD addr))
+{
+	FILE *fp;
+	int n;
+
+	if (nodes == NULL)
+		return FALSE;
+	fp = fopen(filename, "w");
+	if (fp == NULL)
+		return FALSE;
+	for (n = 0; n < num_nodes; n++) {
+		if (nodes[n].cycles == 0)
+			continue;
+		PrintFrame(fp, n, name);
+		fprintf(fp, " %llu\n", (unsigned long long) nodes[n].cycles);
+	}
+	if (nodes_full)
+		Log_print("Profile: call tree full, deeper calls were charged to their callers");
+	fclose(fp);
+	return TRUE;
+}
+
+int PROFILE_SaveHistogram(const char *filename)
+{
+	FILE *fp;
+	int bank;
+
+	fp = fopen(filename, "w");
+	if (fp == NULL)
+		return FALSE;
+	fputs("bank,address,count,cycles,stolen\n", fp);
+	for (bank = 0; bank < MAX_BANKS; bank++) {
+		const counter *c = counters[bank];
+		int size = bank == 0 ? 0x10000 : 0x4000;
+		int i;
+
+		if (c == NULL)
+			continue;
+		for (i = 0; i < size; i++)
+			if (c[i].count != 0)
+				fprintf(fp, "%d,%04X,%lu,%lu,%lu\n", bank, bank == 0 ? i : 0x4000 + i,
+				        (unsigned long) c[i].count, (unsigned long) c[i].cycles,
+				        (unsigned long) c[i].stolen);
+	}
+	fclose(fp);
+	return TRUE;
+}
+
+void PROFILE_Exit(void)
+{
+	int i;
+
+	PROFILE_active = FALSE;
+	for (i = 0; i < MAX_BANKS; i++) {
+		free(counters[i]);
+		counters[i] = NULL;
+	}
+	free(nodes);
+	nodes = NULL;
+	free(node_hash);
+	node_hash = NULL;
+}
+
+#endif /* MONITOR_PROF */
+
+/*
+vim:ts=4:sw=4:
+*/
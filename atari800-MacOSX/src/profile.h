@@ -0,0 +1,52 @@
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <stdint.h>
+#include "atari.h"
+
+/* 6502 execution profiler. While PROFILE_active is set, CPU_GO reports
+   every instruction: its cycles are added to the address it was fetched
+   from (per XE bank for $4000-$7FFF) and to the current node of a call
+   tree built from JSR/RTS and interrupts. Cycles the CPU spends halted by
+   ANTIC (DMA and WSYNC) are kept apart as "stolen" cycles. */
+
+extern int PROFILE_active;
+/* Call tree node of the code being run, 0 for the top level */
+extern int PROFILE_node;
+
+typedef struct PROFILE_entry_t {
+	UWORD addr;
+	UBYTE bank;				/* XE bank, 0 for the main memory */
+	ULONG count;
+	uint64_t cycles;
+	uint64_t stolen;
+} PROFILE_entry;
+
+void PROFILE_Start(void);
+void PROFILE_Stop(void);
+void PROFILE_Clear(void);
+
+/* Called by CPU_GO after the instruction at PC that was started in NODE,
+   CYCLES is how far it moved ANTIC_xpos */
+void PROFILE_Instruction(UWORD pc, int node, int cycles);
+/* A JSR or an interrupt to TARGET, SP is the stack pointer after the
+   return address has been pushed */
+void PROFILE_Call(UWORD target, UBYTE sp);
+/* An RTS or RTI, SP is the stack pointer after it */
+void PROFILE_Return(UBYTE sp);
+
+/* Fills ENTRIES with up to MAX addresses, most cycles first, and returns
+   how many there are */
+int PROFILE_Top(PROFILE_entry *entries, int max);
+/* Totals since the last clear */
+void PROFILE_Totals(ULONG *instructions, uint64_t *cycles, uint64_t *stolen);
+
+/* Writes the call tree as folded stacks ("a;b;c cycles" per line), which
+   flame graph tools read. NAME may return a label for an address or NULL. */
+int PROFILE_SaveFolded(const char *filename, const char *(*name)(UWORD addr));
+/* Writes the per-address histogram as CSV */
+int PROFILE_SaveHistogram(const char *filename);
+
+void PROFILE_Exit(void);
+
+#endif /* PROFILE_H_ */
@@ -0,0 +1,352 @@
+/*
+ * rewind.c - stepping the emulation back through in-memory snapshots
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "atari.h"
+#include "log.h"
+#include "rewind.h"
+#include "statesav.h"
+#include "util.h"
+
+/* Uncomment to log the average cost of taking a snapshot */
+/* #define REWIND_STATS */
+
+int REWIND_enabled = FALSE;
+int REWIND_interval = 1;
+int REWIND_budget = 32;
+
+/* Snapshots are stored in groups: a full keyframe followed by deltas
+   against it. A delta is the XOR of the snapshot and its keyframe, with
+   the runs of zeroes left out:
+     UWORD skip   bytes equal to the keyframe
+     UWORD count  followed by count XORed bytes
+   repeated until the end of the snapshot. */
+#define KEYFRAME_INTERVAL 60
+/* Equal bytes needed to end a run of XORed bytes */
+#define MIN_MATCH 4
+#define MAX_ENTRIES 4096
+
+typedef struct {
+	UBYTE *data;
+	ULONG length;   /* stored bytes */
+	ULONG size;     /* size of the snapshot */
+	int keyframe;
+} Entry;
+
+static Entry entries[MAX_ENTRIES];
+static int first = 0;
+static int count = 0;
+static ULONG total_bytes = 0;
+/* Entries after the newest keyframe, -1 if there is no keyframe */
+static int since_keyframe = -1;
+static int frame_count = 0;
+
+static UBYTE *snapshot = NULL;
+static ULONG snapshot_capacity = 0;
+static UBYTE *delta = NULL;
+static ULONG delta_capacity = 0;
+
+#ifdef REWIND_STATS
+static double stats_time = 0.0;
+static int stats_count = 0;
+#endif
+
+#define ENTRY(n) (&entries[(first + (n)) % MAX_ENTRIES])
+
+int REWIND_Initialise(int *argc, char *argv[])
+{
+	int i;
+	int j;
+
+	for (i = j = 1; i < *argc; i++) {
+		int i_a = (i + 1 < *argc);		/* is argument available? */
+		int a_m = FALSE;			/* error, argument missing! */
+
+		if (strcmp(argv[i], "-rewind") == 0)
+			REWIND_enabled = TRUE;
+		else if (strcmp(argv[i], "-norewind") == 0)
+			REWIND_enabled = FALSE;
+		else if (strcmp(argv[i], "-rewind-interval") == 0) {
+			if (i_a)
+				REWIND_interval = Util_sscandec(argv[++i]);
+			else a_m = TRUE;
+		}
+		else if (strcmp(argv[i], "-rewind-mem") == 0) {
+			if (i_a)
+				REWIND_budget = Util_sscandec(argv[++i]);
+			else a_m = TRUE;
+		}
+		else {
+			if (strcmp(argv[i], "-help") == 0) {
+				Log_print("\t-rewind           Keep snapshots for stepping back");
+				Log_print("\t-norewind         Disable rewind");
+				Log_print("\t-rewind-interval <n> Take a snapshot every n frames");
+				Log_print("\t-rewind-mem <mb>  Memory used for rewind snapshots");
+			}
+			argv[j++] = argv[i];
+		}
+
+		if (a_m) {
+			Log_print("Missing argument for '%s'", argv[i]);
+			return FALSE;
+		}
+	}
+	*argc = j;
+
+	if (REWIND_interval < 1)
+		REWIND_interval = 1;
+	if (REWIND_budget < 1)
+		REWIND_budget = 1;
+
+	return TRUE;
+}
+
+void REWIND_Reset(void)
+{
+	while (count > 0) {
+		free(ENTRY(0)->data);
+		first = (first + 1) % MAX_ENTRIES;
+		count--;
+	}
+	first = 0;
+	total_bytes = 0;
+	since_keyframe = -1;
+	frame_count = 0;
+}
+
+void REWIND_Exit(void)
+{
+	REWIND_Reset();
+	free(snapshot);
+	snapshot = NULL;
+	snapshot_capacity = 0;
+	free(delta);
+	delta = NULL;
+	delta_capacity = 0;
+}
+
+/* Returns TRUE if the MIN_MATCH bytes at pos are equal (or equal up to
+   the end of the snapshot) */
+static int Matches(const UBYTE *key, const UBYTE *cur, ULONG pos, ULONG size)
+{
+	ULONG end = pos + MIN_MATCH < size ? pos + MIN_MATCH : size;
+
+	for (; pos < end; pos++)
+		if (cur[pos] != key[pos])
+			return FALSE;
+	return TRUE;
+}
+
+/* Encodes cur against key into out. Returns the encoded length, or 0 if
+   the delta would not be smaller than the snapshot itself. */
+static ULONG EncodeDelta(const UBYTE *key, const UBYTE *cur, ULONG size, UBYTE *out)
+{
+	ULONG pos = 0;
+	ULONG length = 0;
+
+	while (pos < size) {
+		ULONG skip = 0;
+		ULONG run = 0;
+		ULONG start;
+
+		while (pos + sizeof(ULONG) <= size && skip + sizeof(ULONG) <= 0xffff
+		       && memcmp(cur + pos, key + pos, sizeof(ULONG)) == 0) {
+			pos += sizeof(ULONG);
+			skip += sizeof(ULONG);
+		}
+		while (pos < size && skip < 0xffff && cur[pos] == key[pos]) {
+			pos++;
+			skip++;
+		}
+		start = pos;
+		while (pos < size && run < 0xffff
+		       && !(cur[pos] == key[pos] && Matches(key, cur, pos, size))) {
+			pos++;
+			run++;
+		}
+		if (run == 0 && pos == size)
+			break;
+		if (length + 4 + run >= size)
+			return 0;
+		out[length++] = skip & 0xff;
+		out[length++] = skip >> 8;
+		out[length++] = run & 0xff;
+		out[length++] = run >> 8;
+		for (; start < pos; start++)
+			out[length++] = cur[start] ^ key[start];
+	}
+	return length;
+}
+
+static void DecodeDelta(const UBYTE *key, const UBYTE *in, ULONG length, UBYTE *out, ULONG size)
+{
+	ULONG pos = 0;
+	const UBYTE *end = in + length;
+
+	memcpy(out, key, size);
+	while (in < end) {
+		ULONG skip = in[0] | (in[1] << 8);
+		ULONG run = in[2] | (in[3] << 8);
+		in += 4;
+		pos += skip;
+		for (; run > 0; run--)
+			out[pos++] ^= *in++;
+	}
+}
+
+/* Frees the oldest keyframe and the deltas that depend on it */
+static void DropOldestGroup(void)
+{
+	do {
+		Entry *e = ENTRY(0);
+		total_bytes -= e->length;
+		free(e->data);
+		e->data = NULL;
+		first = (first + 1) % MAX_ENTRIES;
+		count--;
+	} while (count > 0 && !ENTRY(0)->keyframe);
+	if (count == 0)
+		since_keyframe = -1;
+}
+
+static void DropNewest(void)
+{
+	Entry *e = ENTRY(count - 1);
+	total_bytes -= e->length;
+	free(e->data);
+	e->data = NULL;
+	count--;
+
+	/* Find the keyframe the next snapshots have to refer to */
+	for (since_keyframe = 0; since_keyframe < count; since_keyframe++)
+		if (ENTRY(count - 1 - since_keyframe)->keyframe)
+			return;
+	since_keyframe = -1;
+}
+
+static void TakeSnapshot(void)
+{
+	ULONG size;
+	ULONG length = 0;
+	Entry *e;
+#ifdef REWIND_STATS
+	double start = Util_time();
+#endif
+
+	size = StateSav_SaveMem(&snapshot, &snapshot_capacity);
+	if (size == 0)
+		return;
+
+	if (since_keyframe >= 0 && since_keyframe + 1 < KEYFRAME_INTERVAL) {
+		Entry *key = ENTRY(count - 1 - since_keyframe);
+		if (key->size == size) {
+			if (delta_capacity < size) {
+				delta = (UBYTE *) Util_realloc(delta, size);
+				delta_capacity = size;
+			}
+			length = EncodeDelta(key->data, snapshot, size, delta);
+		}
+	}
+
+	if (count == MAX_ENTRIES)
+		DropOldestGroup();
+	e = ENTRY(count);
+	e->size = size;
+	if (length != 0) {
+		e->data = (UBYTE *) Util_malloc(length);
+		memcpy(e->data, delta, length);
+		e->length = length;
+		e->keyframe = FALSE;
+		since_keyframe++;
+	}
+	else {
+		e->data = (UBYTE *) Util_malloc(size);
+		memcpy(e->data, snapshot, size);
+		e->length = size;
+		e->keyframe = TRUE;
+		since_keyframe = 0;
+	}
+	count++;
+	total_bytes += e->length;
+
+	/* Keep within the budget, but never drop the group being built */
+	while (total_bytes > (ULONG) REWIND_budget * 1024 * 1024 && count > since_keyframe + 1)
+		DropOldestGroup();
+
+#ifdef REWIND_STATS
+	stats_time += Util_time() - start;
+	if (++stats_count == 300) {
+		Log_print("Rewind: %.3f ms per snapshot, %d snapshots in %lu KB",
+		          stats_time * 1000.0 / stats_count, count, (unsigned long) (total_bytes >> 10));
+		stats_time = 0.0;
+		stats_count = 0;
+	}
+#endif
+}
+
+void REWIND_Frame(void)
+{
+	if (!REWIND_enabled) {
+		if (count > 0)
+			REWIND_Reset();
+		return;
+	}
+	if (++frame_count < REWIND_interval)
+		return;
+	frame_count = 0;
+	TakeSnapshot();
+}
+
+int REWIND_StepBack(void)
+{
+	Entry *e;
+	int result;
+
+	if (!REWIND_enabled || count == 0)
+		return FALSE;
+
+	e = ENTRY(count - 1);
+	if (e->keyframe)
+		result = StateSav_ReadMem(e->data, e->size);
+	else {
+		Entry *key = ENTRY(count - 1 - since_keyframe);
+		if (snapshot_capacity < e->size) {
+			snapshot = (UBYTE *) Util_realloc(snapshot, e->size);
+			snapshot_capacity = e->size;
+		}
+		DecodeDelta(key->data, e->data, e->length, snapshot, e->size);
+		result = StateSav_ReadMem(snapshot, e->size);
+	}
+	DropNewest();
+	frame_count = 0;
+
+	return result;
+}
+
+/*
+vim:ts=4:sw=4:
+*/
@@ -0,0 +1,25 @@
+#ifndef REWIND_H_
+#define REWIND_H_
+
+#include "atari.h"
+
+/* Rewind keeps a ring of in-memory snapshots taken every REWIND_interval
+   frames, so that the emulation can be stepped back. */
+
+extern int REWIND_enabled;
+/* Frames between two snapshots */
+extern int REWIND_interval;
+/* Memory the ring may use, in megabytes */
+extern int REWIND_budget;
+
+int REWIND_Initialise(int *argc, char *argv[]);
+void REWIND_Exit(void);
+/* Drops all the snapshots, e.g. after a cold start */
+void REWIND_Reset(void);
+/* Called once per emulated frame */
+void REWIND_Frame(void);
+/* Restores the newest snapshot and removes it from the ring. Returns FALSE
+   if there is nothing to go back to. */
+int REWIND_StepBack(void);
+
+#endif /* REWIND_H_ */
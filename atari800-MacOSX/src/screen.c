@@ -46,6 +46,10 @@ ULONG *Screen_atari = NULL;
 #ifdef DIRTYRECT
 UBYTE *Screen_dirty = NULL;
 #endif
+#ifdef DIRTYSPAN
+UWORD Screen_dirty_left[Screen_HEIGHT];
+UWORD Screen_dirty_right[Screen_HEIGHT];
+#endif
 #ifdef BITPL_SCR
 ULONG *Screen_atari_b = NULL;
 ULONG *Screen_atari1 = NULL;
@@ -149,6 +153,9 @@ void Screen_Initialise(int *argc, char *argv[])
 		Screen_dirty = (UBYTE *) Util_malloc(Screen_HEIGHT * Screen_WIDTH / 8);
 		Screen_EntireDirty();
 #endif
+#ifdef DIRTYSPAN
+		Screen_EntireDirty();
+#endif
 #ifdef BITPL_SCR
 		Screen_atari_b = (ULONG *) Util_malloc(Screen_HEIGHT * Screen_WIDTH);
 		Screen_atari1 = Screen_atari;
@@ -160,6 +167,22 @@ void Screen_Initialise(int *argc, char *argv[])
 #define SMALLFONT_WIDTH    5
 #define SMALLFONT_HEIGHT   7
 #define SMALLFONT_PERCENT  10
+#define SMALLFONT_BLOCK    12
+#define SMALLFONT_SPACE    13
+#define SMALLFONT_A        14
+#define SMALLFONT_D        15
+#define SMALLFONT_E        16
+#define SMALLFONT_H        17
+#define SMALLFONT_I        18
+#define SMALLFONT_K        19
+#define SMALLFONT_N        20
+#define SMALLFONT_O        21
+#define SMALLFONT_P        22
+#define SMALLFONT_R        23
+#define SMALLFONT_S        24
+#define SMALLFONT_T        25
+#define SMALLFONT_U        26
+#define SMALLFONT_Y        27
 #define SMALLFONT_____ 0x00
 #define SMALLFONT___X_ 0x02
 #define SMALLFONT__X__ 0x04
@@ -171,7 +194,7 @@ void Screen_Initialise(int *argc, char *argv[])
 
 static void SmallFont_DrawChar(UBYTE *screen, int ch, UBYTE color1, UBYTE color2)
 {
-	static const UBYTE font[12][SMALLFONT_HEIGHT] = {
+	static const UBYTE font[28][SMALLFONT_HEIGHT] = {
 		{
 			SMALLFONT_____,
 			SMALLFONT__X__,
@@ -279,6 +302,150 @@ static void SmallFont_DrawChar(UBYTE *screen, int ch, UBYTE color1, UBYTE color2
 			SMALLFONT_X_X_,
 			SMALLFONT__X__,
 			SMALLFONT_____
+		},
+		{
+			SMALLFONT_____,
+			SMALLFONT_XXX_,
+			SMALLFONT_XXX_,
+			SMALLFONT_XXX_,
+			SMALLFONT_XXX_,
+			SMALLFONT_XXX_,
+			SMALLFONT_____
+		},
+		{
+			SMALLFONT_____,
+			SMALLFONT_____,
+			SMALLFONT_____,
+			SMALLFONT_____,
+			SMALLFONT_____,
+			SMALLFONT_____,
+			SMALLFONT_____
+		},
+		{
+			SMALLFONT_____,
+			SMALLFONT_XXX_,
+			SMALLFONT_X_X_,
+			SMALLFONT_XXX_,
+			SMALLFONT_X_X_,
+			SMALLFONT_X_X_,
+			SMALLFONT_____
+		},
+		{
+			SMALLFONT_____,
+			SMALLFONT_XX__,
+			SMALLFONT_X_X_,
+			SMALLFONT_X_X_,
+			SMALLFONT_X_X_,
+			SMALLFONT_XX__,
+			SMALLFONT_____
+		},
+		{
+			SMALLFONT_____,
+			SMALLFONT_XXX_,
+			SMALLFONT_X___,
+			SMALLFONT_XXX_,
+			SMALLFONT_X___,
+			SMALLFONT_XXX_,
+			SMALLFONT_____
+		},
+		{
+			SMALLFONT_____,
+			SMALLFONT_X_X_,
+			SMALLFONT_X_X_,
+			SMALLFONT_XXX_,
+			SMALLFONT_X_X_,
+			SMALLFONT_X_X_,
+			SMALLFONT_____
+		},
+		{
+			SMALLFONT_____,
+			SMALLFONT_XXX_,
+			SMALLFONT__X__,
+			SMALLFONT__X__,
+			SMALLFONT__X__,
+			SMALLFONT_XXX_,
+			SMALLFONT_____
+		},
+		{
+			SMALLFONT_____,
+			SMALLFONT_X_X_,
+			SMALLFONT_X_X_,
+			SMALLFONT_XX__,
+			SMALLFONT_X_X_,
+			SMALLFONT_X_X_,
+			SMALLFONT_____
+		},
+		{
+			SMALLFONT_____,
+			SMALLFONT_XX__,
+			SMALLFONT_X_X_,
+			SMALLFONT_X_X_,
+			SMALLFONT_X_X_,
+			SMALLFONT_X_X_,
+			SMALLFONT_____
+		},
+		{
+			SMALLFONT_____,
+			SMALLFONT_XXX_,
+			SMALLFONT_X_X_,
+			SMALLFONT_X_X_,
+			SMALLFONT_X_X_,
+			SMALLFONT_XXX_,
+			SMALLFONT_____
+		},
+		{
+			SMALLFONT_____,
+			SMALLFONT_XXX_,
+			SMALLFONT_X_X_,
+			SMALLFONT_XXX_,
+			SMALLFONT_X___,
+			SMALLFONT_X___,
+			SMALLFONT_____
+		},
+		{
+			SMALLFONT_____,
+			SMALLFONT_XXX_,
+			SMALLFONT_X_X_,
+			SMALLFONT_XXX_,
+			SMALLFONT_XX__,
+			SMALLFONT_X_X_,
+			SMALLFONT_____
+		},
+		{
+			SMALLFONT_____,
+			SMALLFONT__XX_,
+			SMALLFONT_X___,
+			SMALLFONT__X__,
+			SMALLFONT___X_,
+			SMALLFONT_XX__,
+			SMALLFONT_____
+		},
+		{
+			SMALLFONT_____,
+			SMALLFONT_XXX_,
+			SMALLFONT__X__,
+			SMALLFONT__X__,
+			SMALLFONT__X__,
+			SMALLFONT__X__,
+			SMALLFONT_____
+		},
+		{
+			SMALLFONT_____,
+			SMALLFONT_X_X_,
+			SMALLFONT_X_X_,
+			SMALLFONT_X_X_,
+			SMALLFONT_X_X_,
+			SMALLFONT_XXX_,
+			SMALLFONT_____
+		},
+		{
+			SMALLFONT_____,
+			SMALLFONT_X_X_,
+			SMALLFONT_X_X_,
+			SMALLFONT__X__,
+			SMALLFONT__X__,
+			SMALLFONT__X__,
+			SMALLFONT_____
 		}
 	};
 	int y;
@@ -303,6 +470,63 @@ static void SmallFont_DrawInt(UBYTE *screen, int n, UBYTE color1, UBYTE color2)
 	} while (n > 0);
 }
 
+/* Draws n right-aligned in a field of the given number of digits */
+static void SmallFont_DrawField(UBYTE *screen, int n, int digits, UBYTE color1, UBYTE color2)
+{
+	do {
+		SmallFont_DrawChar(screen, n % 10, color1, color2);
+		screen -= SMALLFONT_WIDTH;
+		n /= 10;
+		digits--;
+	} while (n > 0 && digits > 0);
+	for (; digits > 0; digits--) {
+		SmallFont_DrawChar(screen, SMALLFONT_SPACE, color1, color2);
+		screen -= SMALLFONT_WIDTH;
+	}
+}
+
+/* Returns the glyph for a stage name letter, or a space if the font lacks it */
+static int SmallFont_Letter(char c)
+{
+	switch (c) {
+	case 'a': return SMALLFONT_A;
+	case 'd': return SMALLFONT_D;
+	case 'e': return SMALLFONT_E;
+	case 'h': return SMALLFONT_H;
+	case 'i': return SMALLFONT_I;
+	case 'k': return SMALLFONT_K;
+	case 'n': return SMALLFONT_N;
+	case 'o': return SMALLFONT_O;
+	case 'p': return SMALLFONT_P;
+	case 'r': return SMALLFONT_R;
+	case 's': return SMALLFONT_S;
+	case 't': return SMALLFONT_T;
+	case 'u': return SMALLFONT_U;
+	case 'y': return SMALLFONT_Y;
+	default: return SMALLFONT_SPACE;
+	}
+}
+
+void Screen_DrawFrameTimes(int count, const char * const *names, const int *average, const int *peak, const UBYTE *colours)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		UBYTE *screen = (UBYTE *) Screen_atari + Screen_visible_x1 + 2
+		                + (Screen_visible_y1 + 2 + i * SMALLFONT_HEIGHT) * Screen_WIDTH;
+		int j;
+		SmallFont_DrawChar(screen, SMALLFONT_BLOCK, colours[i], 0x00);
+		/* first three letters of the stage name */
+		for (j = 0; j < 3; j++)
+			SmallFont_DrawChar(screen + (1 + j) * SMALLFONT_WIDTH,
+			                   names[i][j] == '\0' ? SMALLFONT_SPACE : SmallFont_Letter(names[i][j]),
+			                   colours[i], 0x00);
+		/* microseconds, up to 5 digits each */
+		SmallFont_DrawField(screen + 9 * SMALLFONT_WIDTH, average[i] > 99999 ? 99999 : average[i], 6, 0x0c, 0x00);
+		SmallFont_DrawField(screen + 15 * SMALLFONT_WIDTH, peak[i] > 99999 ? 99999 : peak[i], 6, 0x0f, 0x00);
+	}
+}
+
 void Screen_DrawAtariSpeed(double cur_time)
 {
 	if (Screen_show_atari_speed) {
@@ -569,7 +793,38 @@ void Screen_SaveNextScreenshot(int interlaced)
 
 void Screen_EntireDirty(void)
 {
+#ifdef DIRTYSPAN
+	int y;
+#endif
 #ifdef DIRTYRECT
 	memset(Screen_dirty, 1, Screen_WIDTH * Screen_HEIGHT / 8);
 #endif /* DIRTYRECT */
+#ifdef DIRTYSPAN
+	for (y = 0; y < Screen_HEIGHT; y++) {
+		Screen_dirty_left[y] = 0;
+		Screen_dirty_right[y] = Screen_WIDTH;
+	}
+#endif /* DIRTYSPAN */
+}
+
+#ifdef DIRTYSPAN
+void Screen_MarkDirtySpan(int y, int left, int right)
+{
+	if (Screen_dirty_left[y] >= Screen_dirty_right[y]) {
+		Screen_dirty_left[y] = (UWORD) left;
+		Screen_dirty_right[y] = (UWORD) right;
+	}
+	else {
+		if (left < Screen_dirty_left[y])
+			Screen_dirty_left[y] = (UWORD) left;
+		if (right > Screen_dirty_right[y])
+			Screen_dirty_right[y] = (UWORD) right;
+	}
+}
+
+void Screen_ClearDirtySpans(void)
+{
+	memset(Screen_dirty_left, 0, sizeof(Screen_dirty_left));
+	memset(Screen_dirty_right, 0, sizeof(Screen_dirty_right));
 }
+#endif /* DIRTYSPAN */
@@ -19,6 +19,18 @@ extern ULONG *Screen_atari;
 #define Screen_WIDTH  384
 #define Screen_HEIGHT 240
 
+#ifdef DIRTYSPAN
+/* The columns of scanline y that changed since the port last called
+   Screen_ClearDirtySpans are Screen_dirty_left[y] <= x < Screen_dirty_right[y].
+   Empty if Screen_dirty_left[y] >= Screen_dirty_right[y].
+   ANTIC_Frame finds them as it draws; code that writes to Screen_atari
+   directly must call Screen_MarkDirtySpan or Screen_EntireDirty. */
+extern UWORD Screen_dirty_left[Screen_HEIGHT];
+extern UWORD Screen_dirty_right[Screen_HEIGHT];
+void Screen_MarkDirtySpan(int y, int left, int right);
+void Screen_ClearDirtySpans(void);
+#endif /* DIRTYSPAN */
+
 #ifdef BITPL_SCR
 extern ULONG *Screen_atari_b;
 extern ULONG *Screen_atari1;
@@ -40,6 +52,10 @@ int Screen_ReadConfig(char *string, char *ptr);
 void Screen_WriteConfig(FILE *fp);
 void Screen_DrawAtariSpeed(int);
 void Screen_DrawDiskLED(void);
+/* Draws one row per entry in the top left corner: a block and the first
+   three letters of the entry's name in its colour, then the average and the
+   peak time in microseconds */
+void Screen_DrawFrameTimes(int count, const char * const *names, const int *average, const int *peak, const UBYTE *colours);
 void Screen_DrawHDDiskLED(void);
 void Screen_Draw1200LED(void);
 void Screen_DrawCapslock(int state);
@@ -158,6 +158,20 @@ typedef struct tagvapi_sector_header_t {
 /* Additional Info for all copy protected disk types */
 static void *additional_info[SIO_MAX_DRIVES];
 
+/* Whole-image cache.  With SIO_image_cache set, a disk image is read into
+   memory when it is mounted and sectors are served from the copy instead of
+   with an fseek/fread per sector.  Writes update the copy and widen a dirty
+   byte range, which SIO_FlushImages writes back to the file once the drive
+   has been idle for SIO_FLUSH_FRAMES frames, on dismount, and on demand. */
+int SIO_image_cache = TRUE;
+#define SIO_FLUSH_FRAMES 50
+static UBYTE *image_data[SIO_MAX_DRIVES];
+static ULONG image_length[SIO_MAX_DRIVES];
+static ULONG image_pos[SIO_MAX_DRIVES];
+static ULONG image_dirty_start[SIO_MAX_DRIVES];
+static ULONG image_dirty_end[SIO_MAX_DRIVES];
+static int image_idle_frames[SIO_MAX_DRIVES];
+
 SIO_UnitStatus SIO_drive_status[SIO_MAX_DRIVES];
 char SIO_filename[SIO_MAX_DRIVES][FILENAME_MAX];
 
@@ -200,6 +214,23 @@ int ignore_header_writeprotect = FALSE;
 int SIO_Initialise(int *argc, char *argv[])
 {
 	int i;
+	int j;
+
+	for (i = j = 1; i < *argc; i++) {
+		if (strcmp(argv[i], "-imagecache") == 0)
+			SIO_image_cache = TRUE;
+		else if (strcmp(argv[i], "-noimagecache") == 0)
+			SIO_image_cache = FALSE;
+		else {
+			if (strcmp(argv[i], "-help") == 0) {
+				Log_print("\t-imagecache      Keep mounted disk images in memory");
+				Log_print("\t-noimagecache    Access mounted disk images sector by sector");
+			}
+			argv[j++] = argv[i];
+		}
+	}
+	*argc = j;
+
 	for (i = 0; i < SIO_MAX_DRIVES; i++) {
 		strcpy(SIO_filename[i], "Off");
 		SIO_drive_status[i] = SIO_OFF;
@@ -229,6 +260,115 @@ int SIO_IsVapi(int diskno)
 }
 #endif
 
+/* Reads the whole image of a unit into memory.  On failure the unit is
+   simply left to use the file. */
+static void LoadImageCache(int unit, FILE *f)
+{
+	int length = Util_flen(f);
+
+	image_data[unit] = NULL;
+	image_pos[unit] = 0;
+	image_dirty_start[unit] = image_dirty_end[unit] = 0;
+	if (length <= 0)
+		return;
+	image_data[unit] = (UBYTE *)Util_malloc(length);
+	fseek(f, 0, SEEK_SET);
+	if (fread(image_data[unit], 1, length, f) != (size_t) length) {
+		Log_print("Cannot cache disk image %d, using the file", unit + 1);
+		free(image_data[unit]);
+		image_data[unit] = NULL;
+		return;
+	}
+	image_length[unit] = length;
+}
+
+/* Writes the dirty part of a cached image back to its file */
+static void FlushImageCache(int unit)
+{
+	ULONG start = image_dirty_start[unit];
+	ULONG end = image_dirty_end[unit];
+
+	if (image_data[unit] == NULL || start >= end)
+		return;
+	fseek(disk[unit], start, SEEK_SET);
+	if (fwrite(image_data[unit] + start, 1, end - start, disk[unit]) != end - start)
+		Log_print("Error writing back disk image %d", unit + 1);
+	fflush(disk[unit]);
+	image_dirty_start[unit] = image_dirty_end[unit] = 0;
+}
+
+/* fseek, fread and fwrite on the image of a unit, going to the cache
+   when there is one */
+static void ImageSeek(int unit, ULONG offset)
+{
+	if (image_data[unit] != NULL)
+		image_pos[unit] = offset;
+	else
+		fseek(disk[unit], offset, SEEK_SET);
+}
+
+static size_t ImageRead(int unit, UBYTE *buffer, size_t size)
+{
+	ULONG pos = image_pos[unit];
+
+	if (image_data[unit] == NULL)
+		return fread(buffer, 1, size, disk[unit]);
+	if (pos >= image_length[unit])
+		return 0;
+	if (size > image_length[unit] - pos)
+		size = image_length[unit] - pos;
+	memcpy(buffer, image_data[unit] + pos, size);
+	image_pos[unit] = pos + size;
+	return size;
+}
+
+static size_t ImageWrite(int unit, const UBYTE *buffer, size_t size)
+{
+	ULONG pos = image_pos[unit];
+
+	if (image_data[unit] == NULL)
+		return fwrite(buffer, 1, size, disk[unit]);
+	/* writing past the end grows the file, as fwrite would */
+	if (pos + size > image_length[unit]) {
+		image_data[unit] = (UBYTE *)Util_realloc(image_data[unit], pos + size);
+		if (pos > image_length[unit])
+			memset(image_data[unit] + image_length[unit], 0, pos - image_length[unit]);
+		image_length[unit] = pos + size;
+	}
+	memcpy(image_data[unit] + pos, buffer, size);
+	image_pos[unit] = pos + size;
+	if (image_dirty_start[unit] >= image_dirty_end[unit]) {
+		image_dirty_start[unit] = pos;
+		image_dirty_end[unit] = pos + size;
+	}
+	else {
+		if (pos < image_dirty_start[unit])
+			image_dirty_start[unit] = pos;
+		if (pos + size > image_dirty_end[unit])
+			image_dirty_end[unit] = pos + size;
+	}
+	image_idle_frames[unit] = 0;
+	return size;
+}
+
+void SIO_FlushImages(void)
+{
+	int i;
+	for (i = 0; i < SIO_MAX_DRIVES; i++)
+		FlushImageCache(i);
+}
+
+/* Writes back cached images whose drives have been idle for a while */
+void SIO_Frame(void)
+{
+	int i;
+	for (i = 0; i < SIO_MAX_DRIVES; i++) {
+		if (image_data[i] != NULL && image_dirty_start[i] < image_dirty_end[i]
+			&& ++image_idle_frames[i] >= SIO_FLUSH_FRAMES)
+			FlushImageCache(i);
+	}
+}
+
 int SIO_Mount(int diskno, const char *filename, int b_open_readonly)
 {
 	FILE *f = NULL;
@@ -591,12 +731,19 @@ int SIO_Mount(int diskno, const char *filename, int b_open_readonly)
 	strcpy(SIO_filename[diskno - 1], filename);
 	SIO_drive_status[diskno - 1] = status;
 	disk[diskno - 1] = f;
+	if (SIO_image_cache)
+		LoadImageCache(diskno - 1, f);
 	return TRUE;
 }
 
 void SIO_Dismount(int diskno)
 {
 	if (disk[diskno - 1] != NULL) {
+		if (image_data[diskno - 1] != NULL) {
+			FlushImageCache(diskno - 1);
+			free(image_data[diskno - 1]);
+			image_data[diskno - 1] = NULL;
+		}
 		Util_fclose(disk[diskno - 1], sio_tmpbuf[diskno - 1]);
 		disk[diskno - 1] = NULL;
 		SIO_drive_status[diskno - 1] = SIO_NO_DISK;
@@ -693,7 +840,7 @@ static int SeekSector(int unit, int sector)
 	SIO_last_sector = sector;
 	snprintf(SIO_status, sizeof(SIO_status), "%d: %d", unit + 1, sector);
 	SIO_SizeOfSector((UBYTE) unit, sector, &size, &offset);
-	fseek(disk[unit], offset, SEEK_SET);
+	ImageSeek(unit, offset);
 
 	return size;
 }
@@ -725,7 +872,7 @@ int SIO_ReadSector(int unit, int sector, UBYTE *buffer)
 		unsigned char *count;
 		info = (pro_additional_info_t *)additional_info[unit];
 		count = info->count;
-		if (fread(buffer, 1, 12, disk[unit]) < 12) {
+		if (ImageRead(unit, buffer, 12) < 12) {
 			Log_print("Error in header of .pro image: sector:%d", sector);
 			return 'E';
 		}
@@ -745,7 +892,7 @@ int SIO_ReadSector(int unit, int sector, UBYTE *buffer)
 				}
 				size = SeekSector(unit, sector);
 				/* read sector header */
-				if (fread(buffer, 1, 12, disk[unit]) < 12) {
+				if (ImageRead(unit, buffer, 12) < 12) {
 					Log_print("Error in header2 of .pro image: sector:%d dupnum:%d", sector, dupnum);
 					return 'E';
 				}
@@ -753,7 +900,7 @@ int SIO_ReadSector(int unit, int sector, UBYTE *buffer)
 		}
 		/* bad sector */
 		if (buffer[1] != 0xff) {
-			if (fread(buffer, 1, size, disk[unit]) < size) {
+			if (ImageRead(unit, buffer, size) < size) {
 				Log_print("Error in bad sector of .pro image: sector:%d", sector);
 			}
 			io_success[unit] = sector;
@@ -845,13 +992,13 @@ int SIO_ReadSector(int unit, int sector, UBYTE *buffer)
 		if (secinfo->sec_count > 1)
 			Log_print("duplicate sector:%d dupnum:%d delay:%d",sector, secindex,info->vapi_delay_time);
 #endif
-		fseek(disk[unit],secinfo->sec_offset[secindex],SEEK_SET);
+		ImageSeek(unit, secinfo->sec_offset[secindex]);
 		info->sec_stat_buff[0] = 0x8 | ((secinfo->sec_status[secindex] == 0xFF) ? 0 : 0x04);
 		info->sec_stat_buff[1] = secinfo->sec_status[secindex];
 		info->sec_stat_buff[2] = 0xe0;
 		info->sec_stat_buff[3] = 0;
 		if (secinfo->sec_status[secindex] != 0xFF) {
-			if (fread(buffer, 1, size, disk[unit]) < size) {
+			if (ImageRead(unit, buffer, size) < size) {
 				Log_print("error reading sector:%d", sector);
 			}
 			io_success[unit] = sector;
@@ -903,7 +1050,7 @@ int SIO_ReadSector(int unit, int sector, UBYTE *buffer)
 		}
 #endif
 	}
-	if (fread(buffer, 1, size, disk[unit]) < size) {
+	if (ImageRead(unit, buffer, size) < size) {
 		Log_print("incomplete sector num:%d", sector);
 	}
 	io_success[unit] = 0;
@@ -945,8 +1092,8 @@ int SIO_WriteSector(int unit, int sector, const UBYTE *buffer)
 		}
 		
 		size = SeekSector(unit, sector);
-		fseek(disk[unit],secinfo->sec_offset[0],SEEK_SET);
-		fwrite(buffer, 1, size, disk[unit]);
+		ImageSeek(unit, secinfo->sec_offset[0]);
+		ImageWrite(unit, buffer, size);
 		io_success[unit] = 0;
 		return 'C';
 #if 0		
@@ -968,7 +1115,7 @@ int SIO_WriteSector(int unit, int sector, const UBYTE *buffer)
 	} 
 #endif
 	size = SeekSector(unit, sector);
-	fwrite(buffer, 1, size, disk[unit]);
+	ImageWrite(unit, buffer, size);
 	io_success[unit] = 0;
 	return 'C';
 }
@@ -1175,7 +1322,7 @@ int SIO_DriveStatus(int unit, UBYTE *buffer)
 	if (io_success[unit] != 0  && image_type[unit] == IMAGE_TYPE_PRO) {
 		int sector = io_success[unit];
 		SeekSector(unit, sector);
-		if (fread(buffer, 1, 4, disk[unit]) < 4) {
+		if (ImageRead(unit, buffer, 4) < 4) {
 			Log_print("SIO_DriveStatus: failed to read sector header");
 		}
 		return 'C';
@@ -2087,9 +2234,14 @@ void SIO_StateRead(void)
 		char filename[FILENAME_MAX];
 
 		StateSav_ReadINT(&saved_drive_status, 1);
-		SIO_drive_status[i] = (SIO_UnitStatus)saved_drive_status;
 
 		StateSav_ReadFNAME(filename);
+		/* A snapshot taken in this session refers to the images that are
+		   still mounted - don't mount them again */
+		if (StateSav_IsMemorySnapshot() && saved_drive_status == SIO_drive_status[i]
+		    && strcmp(filename, SIO_filename[i]) == 0)
+			continue;
+		SIO_drive_status[i] = (SIO_UnitStatus)saved_drive_status;
 		if (filename[0] == 0)
 			continue;
 
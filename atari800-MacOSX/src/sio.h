@@ -43,6 +43,12 @@ int SIO_GetByte(void);
 int SIO_Initialise(int *argc, char *argv[]);
 void SIO_Exit(void);
 
+/* Keep mounted disk images in memory, written back by SIO_Frame when the
+   drive goes idle, on dismount, or by SIO_FlushImages */
+extern int SIO_image_cache;
+void SIO_Frame(void);
+void SIO_FlushImages(void);
+
 /* Some defines about the serial I/O timing. Currently fixed! */
 #define SIO_XMTDONE_INTERVAL  15
 #define SIO_SERIN_INTERVAL     8
@@ -108,52 +108,118 @@ static size_t mem_write(const void *buf, size_t len, gzFile stream);
 static gzFile StateFile = NULL;
 static int nFileError = Z_OK;
 
+#ifndef Z_BUF_ERROR
+#define Z_BUF_ERROR (-5)
+#endif
+
+/* In-memory snapshot target. While MemActive is set all the StateSav_Save*
+   and StateSav_Read* routines go to MemBuffer instead of StateFile. The
+   buffer is owned by the caller of StateSav_SaveMem/StateSav_ReadMem. */
+static int MemActive = FALSE;
+static UBYTE **MemBuffer = NULL;
+static const UBYTE *MemReadBuffer = NULL;
+static ULONG MemCapacity = 0;
+static ULONG MemOffset = 0;
+static ULONG MemSize = 0;
+
+/* Granularity in which a snapshot buffer grows */
+#define MEM_GROW_SIZE 0x10000
+
 static void GetGZErrorText(void)
 {
+	if (MemActive) {
+		Log_print("State snapshot buffer overrun.");
+		nFileError = Z_BUF_ERROR;
+		return;
+	}
 #ifdef GZERROR
-	const char *error = GZERROR(StateFile, &nFileError);
-	if (nFileError == Z_ERRNO) {
+	{
+		const char *error = GZERROR(StateFile, &nFileError);
+		if (nFileError == Z_ERRNO) {
 #ifdef HAVE_STRERROR
-		Log_print("The following general file I/O error occurred:");
-		Log_print(strerror(errno));
+			Log_print("The following general file I/O error occurred:");
+			Log_print(strerror(errno));
 #else
-		Log_print("A file I/O error occurred");
+			Log_print("A file I/O error occurred");
 #endif
-		return;
+			return;
+		}
+		Log_print("ZLIB returned the following error: %s", error);
 	}
-	Log_print("ZLIB returned the following error: %s", error);
 #endif /* GZERROR */
 	Log_print("State file I/O failed.");
 }
 
+/* Returns TRUE if there is an open state file or snapshot to transfer to */
+static int StateOpen(void)
+{
+	return (StateFile != NULL || MemActive) && nFileError == Z_OK;
+}
+
+/* Writes len bytes to the state file or snapshot. Returns 0 on failure. */
+static size_t StateWrite(const void *buf, size_t len)
+{
+	if (MemActive) {
+		if (MemOffset + len > MemCapacity) {
+			ULONG new_capacity = (MemOffset + len + MEM_GROW_SIZE - 1) & ~(ULONG) (MEM_GROW_SIZE - 1);
+			*MemBuffer = (UBYTE *) Util_realloc(*MemBuffer, new_capacity);
+			MemCapacity = new_capacity;
+		}
+		memcpy(*MemBuffer + MemOffset, buf, len);
+		MemOffset += len;
+		return len;
+	}
+	return GZWRITE(StateFile, buf, len);
+}
+
+/* Reads len bytes from the state file or snapshot. Returns 0 on failure. */
+static size_t StateRead(void *buf, size_t len)
+{
+	if (MemActive) {
+		if (MemOffset + len > MemSize)
+			return 0;
+		memcpy(buf, MemReadBuffer + MemOffset, len);
+		MemOffset += len;
+		return len;
+	}
+	return GZREAD(StateFile, buf, len);
+}
+
 /* Value is memory location of data, num is number of type to save */
 void StateSav_SaveUBYTE(const UBYTE *data, int num)
 {
-	if (!StateFile || nFileError != Z_OK)
+	if (!StateOpen() || num <= 0)
 		return;
 
 	/* Assumption is that UBYTE = 8bits and the pointer passed in refers
 	   directly to the active bits if in a padded location. If not (unlikely)
 	   you'll have to redefine this to save appropriately for cross-platform
 	   compatibility */
-	if (GZWRITE(StateFile, data, num) == 0)
+	if (StateWrite(data, num) == 0)
 		GetGZErrorText();
 }
 
 /* Value is memory location of data, num is number of type to save */
 void StateSav_ReadUBYTE(UBYTE *data, int num)
 {
-	if (!StateFile || nFileError != Z_OK)
+	if (!StateOpen() || num <= 0)
 		return;
 
-	if (GZREAD(StateFile, data, num) == 0)
+	if (StateRead(data, num) == 0)
 		GetGZErrorText();
 }
 
+/* Number of values packed into the local buffer before it is written out
+   in one go by StateSav_SaveUWORD/StateSav_SaveINT and their read
+   counterparts. */
+#define PACK_CHUNK 64
+
 /* Value is memory location of data, num is number of type to save */
 void StateSav_SaveUWORD(const UWORD *data, int num)
 {
-	if (!StateFile || nFileError != Z_OK)
+	UBYTE buf[PACK_CHUNK * 2];
+
+	if (!StateOpen())
 		return;
 
 	/* UWORDS are saved as 16bits, regardless of the size on this particular
@@ -161,53 +227,49 @@ void StateSav_SaveUWORD(const UWORD *data, int num)
 	   LSB order. The shifts here and in the read routines will work for both
 	   LSB and MSB architectures. */
 	while (num > 0) {
-		UWORD temp;
-		UBYTE byte;
+		int count = num > PACK_CHUNK ? PACK_CHUNK : num;
+		int i;
 
-		temp = *data++;
-		byte = temp & 0xff;
-		if (GZWRITE(StateFile, &byte, 1) == 0) {
-			GetGZErrorText();
-			break;
+		for (i = 0; i < count; i++) {
+			UWORD temp = *data++;
+			buf[i * 2] = temp & 0xff;
+			buf[i * 2 + 1] = (temp >> 8) & 0xff;
 		}
-
-		temp >>= 8;
-		byte = temp & 0xff;
-		if (GZWRITE(StateFile, &byte, 1) == 0) {
+		if (StateWrite(buf, count * 2) == 0) {
 			GetGZErrorText();
 			break;
 		}
-		num--;
+		num -= count;
 	}
 }
 
 /* Value is memory location of data, num is number of type to save */
 void StateSav_ReadUWORD(UWORD *data, int num)
 {
-	if (!StateFile || nFileError != Z_OK)
+	UBYTE buf[PACK_CHUNK * 2];
+
+	if (!StateOpen())
 		return;
 
 	while (num > 0) {
-		UBYTE byte1, byte2;
-
-		if (GZREAD(StateFile, &byte1, 1) == 0) {
-			GetGZErrorText();
-			break;
-		}
+		int count = num > PACK_CHUNK ? PACK_CHUNK : num;
+		int i;
 
-		if (GZREAD(StateFile, &byte2, 1) == 0) {
+		if (StateRead(buf, count * 2) == 0) {
 			GetGZErrorText();
 			break;
 		}
-
-		*data++ = (byte2 << 8) | byte1;
-		num--;
+		for (i = 0; i < count; i++)
+			*data++ = (buf[i * 2 + 1] << 8) | buf[i * 2];
+		num -= count;
 	}
 }
 
 void StateSav_SaveINT(const int *data, int num)
 {
-	if (!StateFile || nFileError != Z_OK)
+	UBYTE buf[PACK_CHUNK * 4];
+
+	if (!StateOpen())
 		return;
 
 	/* INTs are always saved as 32bits (4 bytes) in the file. They can be any size
@@ -215,88 +277,59 @@ void StateSav_SaveINT(const int *data, int num)
 	   for each int; on read it will be extended out to its proper position for the
 	   native INT size */
 	while (num > 0) {
-		UBYTE signbit = 0;
-		unsigned int temp;
-		UBYTE byte;
-		int temp0;
-
-		temp0 = *data++;
-		if (temp0 < 0) {
-			temp0 = -temp0;
-			signbit = 0x80;
-		}
-		temp = (unsigned int) temp0;
-
-		byte = temp & 0xff;
-		if (GZWRITE(StateFile, &byte, 1) == 0) {
-			GetGZErrorText();
-			break;
-		}
-
-		temp >>= 8;
-		byte = temp & 0xff;
-		if (GZWRITE(StateFile, &byte, 1) == 0) {
-			GetGZErrorText();
-			break;
-		}
+		int count = num > PACK_CHUNK ? PACK_CHUNK : num;
+		int i;
+
+		for (i = 0; i < count; i++) {
+			UBYTE signbit = 0;
+			unsigned int temp;
+			int temp0;
+
+			temp0 = *data++;
+			if (temp0 < 0) {
+				temp0 = -temp0;
+				signbit = 0x80;
+			}
+			temp = (unsigned int) temp0;
 
-		temp >>= 8;
-		byte = temp & 0xff;
-		if (GZWRITE(StateFile, &byte, 1) == 0) {
-			GetGZErrorText();
-			break;
+			buf[i * 4] = temp & 0xff;
+			buf[i * 4 + 1] = (temp >> 8) & 0xff;
+			buf[i * 4 + 2] = (temp >> 16) & 0xff;
+			buf[i * 4 + 3] = ((temp >> 24) & 0x7f) | signbit;
 		}
-
-		temp >>= 8;
-		byte = (temp & 0x7f) | signbit;
-		if (GZWRITE(StateFile, &byte, 1) == 0) {
+		if (StateWrite(buf, count * 4) == 0) {
 			GetGZErrorText();
 			break;
 		}
-
-		num--;
+		num -= count;
 	}
 }
 
 void StateSav_ReadINT(int *data, int num)
 {
-	if (!StateFile || nFileError != Z_OK)
+	UBYTE buf[PACK_CHUNK * 4];
+
+	if (!StateOpen())
 		return;
 
 	while (num > 0) {
-		UBYTE signbit = 0;
-		int temp;
-		UBYTE byte1, byte2, byte3, byte4;
+		int count = num > PACK_CHUNK ? PACK_CHUNK : num;
+		int i;
 
-		if (GZREAD(StateFile, &byte1, 1) == 0) {
+		if (StateRead(buf, count * 4) == 0) {
 			GetGZErrorText();
 			break;
 		}
-
-		if (GZREAD(StateFile, &byte2, 1) == 0) {
-			GetGZErrorText();
-			break;
-		}
-
-		if (GZREAD(StateFile, &byte3, 1) == 0) {
-			GetGZErrorText();
-			break;
-		}
-
-		if (GZREAD(StateFile, &byte4, 1) == 0) {
-			GetGZErrorText();
-			break;
+		for (i = 0; i < count; i++) {
+			const UBYTE *b = &buf[i * 4];
+			int temp;
+
+			temp = ((b[3] & 0x7f) << 24) | (b[2] << 16) | (b[1] << 8) | b[0];
+			if (b[3] & 0x80)
+				temp = -temp;
+			*data++ = temp;
 		}
-
-		signbit = byte4 & 0x80;
-		byte4 &= 0x7f;
-
-		temp = (byte4 << 24) | (byte3 << 16) | (byte2 << 8) | byte1;
-		if (signbit)
-			temp = -temp;
-		*data++ = temp;
-
-		num--;
+		num -= count;
 	}
 }
 
@@ -307,8 +340,9 @@ void StateSav_SaveFNAME(const char *filename)
 	char dirname[FILENAME_MAX]="";
 
 	/* Check to see if file is in application tree, if so, just save as
-	   relative path....*/
-	if (getcwd(dirname, FILENAME_MAX) != NULL) {
+	   relative path. In-memory snapshots keep the name as is, so that
+	   reading one back can recognise the already mounted images. */
+	if (!MemActive && getcwd(dirname, FILENAME_MAX) != NULL) {
 		if (strncmp(filename, dirname, strlen(dirname)) == 0)
 			/* XXX: check if '/' or '\\' follows dirname in filename? */
 			filename += strlen(dirname) + 1;
@@ -334,34 +368,12 @@ void StateSav_ReadFNAME(char *filename)
 	filename[namelen] = 0;
 }
 
-int StateSav_SaveAtariState(const char *filename, const char *mode, UBYTE SaveVerbose)
+/* Saves the state of all the emulated hardware. The order here is important.
+   Atari800_StateSave must be first because it saves the machine type, and
+   decisions on what to save/not save are made based off that later in the
+   process */
+static void SaveState(UBYTE SaveVerbose)
 {
-	UBYTE StateVersion = SAVE_VERSION_NUMBER;
-
-	if (StateFile != NULL) {
-		GZCLOSE(StateFile);
-		StateFile = NULL;
-	}
-	nFileError = Z_OK;
-
-	StateFile = GZOPEN(filename, mode);
-	if (StateFile == NULL) {
-		Log_print("Could not open %s for state save.", filename);
-		GetGZErrorText();
-		return FALSE;
-	}
-	if (GZWRITE(StateFile, "ATARI800", 8) == 0) {
-		GetGZErrorText();
-		GZCLOSE(StateFile);
-		StateFile = NULL;
-		return FALSE;
-	}
-
-	STATESAV_TAG(size);  /* initialize to 0, set to actual size if successful */
-	StateSav_SaveUBYTE(&StateVersion, 1);
-	StateSav_SaveUBYTE(&SaveVerbose, 1);
-	/* The order here is important. Atari800_StateSave must be first because it saves the machine type, and
-	   decisions on what to save/not save are made based off that later in the process */
 	Atari800_StateSave();
 	CARTRIDGE_StateSave();
 	SIO_StateSave();
@@ -403,6 +415,101 @@ int StateSav_SaveAtariState(const char *filename, const char *mode, UBYTE SaveVe
 		StateSav_SaveINT(&local_xld_enabled, 1);
 	}
 #endif /* PBI_XLD */
+}
+
+/* Reads back what SaveState wrote. Returns FALSE if the state contains
+   hardware this build does not support. */
+static int ReadState(UBYTE StateVersion, UBYTE SaveVerbose)
+{
+	Atari800_StateRead(StateVersion);
+	if (StateVersion >= 4) {
+		CARTRIDGE_StateRead(StateVersion);
+		SIO_StateRead();
+	}
+	ANTIC_StateRead();
+	CPU_StateRead(SaveVerbose, StateVersion);
+	GTIA_StateRead(StateVersion);
+	PIA_StateRead(StateVersion);
+	POKEY_StateRead();
+	if (StateVersion >= 6) {
+#ifdef XEP80_EMULATION
+		XEP80_StateRead();
+#else
+		int local_xep80_enabled = FALSE;
+		StateSav_ReadINT(&local_xep80_enabled,1);
+		if (local_xep80_enabled) {
+			Log_print("Cannot read this state file because this version does not support XEP80.");
+			return FALSE;
+		}
+#endif /* XEP80_EMULATION */
+		PBI_StateRead();
+#ifdef PBI_MIO
+		PBI_MIO_StateRead();
+#else
+		{
+			int local_mio_enabled;
+			StateSav_ReadINT(&local_mio_enabled,1);
+			if (local_mio_enabled) {
+				Log_print("Cannot read this state file because this version does not support MIO.");
+				return FALSE;
+			}
+		}
+#endif /* PBI_MIO */
+#ifdef PBI_BB
+		PBI_BB_StateRead();
+#else
+		{
+			int local_bb_enabled;
+			StateSav_ReadINT(&local_bb_enabled,1);
+			if (local_bb_enabled) {
+				Log_print("Cannot read this state file because this version does not support the Black Box.");
+				return FALSE;
+			}
+		}
+#endif /* PBI_BB */
+#ifdef PBI_XLD
+		PBI_XLD_StateRead();
+#else
+		{
+			int local_xld_enabled;
+			StateSav_ReadINT(&local_xld_enabled,1);
+			if (local_xld_enabled) {
+				Log_print("Cannot read this state file because this version does not support the 1400XL/1450XLD.");
+				return FALSE;
+			}
+		}
+#endif /* PBI_XLD */
+	}
+	return TRUE;
+}
+
+int StateSav_SaveAtariState(const char *filename, const char *mode, UBYTE SaveVerbose)
+{
+	UBYTE StateVersion = SAVE_VERSION_NUMBER;
+
+	if (StateFile != NULL) {
+		GZCLOSE(StateFile);
+		StateFile = NULL;
+	}
+	nFileError = Z_OK;
+
+	StateFile = GZOPEN(filename, mode);
+	if (StateFile == NULL) {
+		Log_print("Could not open %s for state save.", filename);
+		GetGZErrorText();
+		return FALSE;
+	}
+	if (GZWRITE(StateFile, "ATARI800", 8) == 0) {
+		GetGZErrorText();
+		GZCLOSE(StateFile);
+		StateFile = NULL;
+		return FALSE;
+	}
+
+	STATESAV_TAG(size);  /* initialize to 0, set to actual size if successful */
+	StateSav_SaveUBYTE(&StateVersion, 1);
+	StateSav_SaveUBYTE(&SaveVerbose, 1);
+	SaveState(SaveVerbose);
 #ifdef DREAMCAST
 	DCStateSave();
 #endif
@@ -468,72 +575,10 @@ int StateSav_ReadAtariState(const char *filename, const char *mode)
 		return FALSE;
 	}
 
-    Atari800_StateRead(StateVersion);
-	if (StateVersion >= 4) {
-        CARTRIDGE_StateRead(StateVersion);
-		SIO_StateRead();
-	}
-	ANTIC_StateRead();
-	CPU_StateRead(SaveVerbose, StateVersion);
-    GTIA_StateRead(StateVersion);
-    PIA_StateRead(StateVersion);
-	POKEY_StateRead();
-	if (StateVersion >= 6) {
-#ifdef XEP80_EMULATION
-		XEP80_StateRead();
-#else
-		int local_xep80_enabled = FALSE;
-		StateSav_ReadINT(&local_xep80_enabled,1);
-		if (local_xep80_enabled) {
-			Log_print("Cannot read this state file because this version does not support XEP80.");
-			GZCLOSE(StateFile);
-			StateFile = NULL;
-			return FALSE;
-		}
-#endif /* XEP80_EMULATION */
-		PBI_StateRead();
-#ifdef PBI_MIO
-		PBI_MIO_StateRead();
-#else
-		{
-			int local_mio_enabled;
-			StateSav_ReadINT(&local_mio_enabled,1);
-			if (local_mio_enabled) {
-				Log_print("Cannot read this state file because this version does not support MIO.");
-				GZCLOSE(StateFile);
-				StateFile = NULL;
-				return FALSE;
-			}
-		}
-#endif /* PBI_MIO */
-#ifdef PBI_BB
-		PBI_BB_StateRead();
-#else
-		{
-			int local_bb_enabled;
-			StateSav_ReadINT(&local_bb_enabled,1);
-			if (local_bb_enabled) {
-				Log_print("Cannot read this state file because this version does not support the Black Box.");
-				GZCLOSE(StateFile);
-				StateFile = NULL;
-				return FALSE;
-			}
-		}
-#endif /* PBI_BB */
-#ifdef PBI_XLD
-		PBI_XLD_StateRead();
-#else
-		{
-			int local_xld_enabled;
-			StateSav_ReadINT(&local_xld_enabled,1);
-			if (local_xld_enabled) {
-				Log_print("Cannot read this state file because this version does not support the 1400XL/1450XLD.");
-				GZCLOSE(StateFile);
-				StateFile = NULL;
-				return FALSE;
-			}
-		}
-#endif /* PBI_XLD */
+	if (!ReadState(StateVersion, SaveVerbose)) {
+		GZCLOSE(StateFile);
+		StateFile = NULL;
+		return FALSE;
 	}
 #ifdef DREAMCAST
 	DCStateRead();
@@ -548,6 +593,72 @@ int StateSav_ReadAtariState(const char *filename, const char *mode)
 	return TRUE;
 }
 
+ULONG StateSav_SaveMem(UBYTE **buffer, ULONG *capacity)
+{
+	static const UBYTE header[10] = {
+		'A', 'T', 'A', 'R', 'I', '8', '0', '0', SAVE_VERSION_NUMBER, 0
+	};
+	ULONG size;
+
+	if (StateFile != NULL) {
+		GZCLOSE(StateFile);
+		StateFile = NULL;
+	}
+	nFileError = Z_OK;
+	MemActive = TRUE;
+	MemBuffer = buffer;
+	MemCapacity = *buffer == NULL ? 0 : *capacity;
+	MemOffset = 0;
+
+	/* Same layout as an uncompressed state file, always non-verbose since
+	   the ROMs don't change under a snapshot */
+	StateSav_SaveUBYTE(header, sizeof(header));
+	SaveState(0);
+
+	*capacity = MemCapacity;
+	size = MemOffset;
+	MemActive = FALSE;
+	MemBuffer = NULL;
+
+	if (nFileError != Z_OK)
+		return 0;
+
+	return size;
+}
+
+int StateSav_ReadMem(const UBYTE *buffer, ULONG size)
+{
+	int result;
+
+	if (size < 10 || memcmp(buffer, "ATARI800", 8) != 0
+	 || buffer[8] > SAVE_VERSION_NUMBER || buffer[8] < 3) {
+		Log_print("Not a valid state snapshot.");
+		return FALSE;
+	}
+
+	if (StateFile != NULL) {
+		GZCLOSE(StateFile);
+		StateFile = NULL;
+	}
+	nFileError = Z_OK;
+	MemActive = TRUE;
+	MemReadBuffer = buffer;
+	MemOffset = 10;
+	MemSize = size;
+
+	result = ReadState(buffer[8], buffer[9]);
+
+	MemActive = FALSE;
+	MemReadBuffer = NULL;
+
+	return result && nFileError == Z_OK;
+}
+
+int StateSav_IsMemorySnapshot(void)
+{
+	return MemActive;
+}
+
 
 /* Common definitions for in-memory state save used for DREAMCAST and libatari800
  */
@@ -6,6 +6,16 @@
 int StateSav_SaveAtariState(const char *filename, const char *mode, UBYTE SaveVerbose);
 int StateSav_ReadAtariState(const char *filename, const char *mode);
 
+/* Saves an uncompressed snapshot of the emulator's state into *buffer,
+   growing it (and updating *capacity) as needed. *buffer may be NULL on
+   the first call. Returns the snapshot size, 0 on failure. */
+ULONG StateSav_SaveMem(UBYTE **buffer, ULONG *capacity);
+/* Restores a snapshot made by StateSav_SaveMem. */
+int StateSav_ReadMem(const UBYTE *buffer, ULONG size);
+/* TRUE while a snapshot is being saved or restored, lets the modules skip
+   reloading media that is already in place. */
+int StateSav_IsMemorySnapshot(void);
+
 void StateSav_SaveUBYTE(const UBYTE *data, int num);
 void StateSav_SaveUWORD(const UWORD *data, int num);
 void StateSav_SaveINT(const int *data, int num);
@@ -0,0 +1,204 @@
+/*
+ * tracedump.c - Convert a trace log written by tracelog.c to text
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Usage: tracedump tracefile [textfile]
+ *
+ * Writes one line per instruction: the instruction number, scanline,
+ * xpos, PC, opcode, the registers before the instruction and the
+ * effective address of memory accesses. The text goes to standard
+ * output if no textfile is given.
+ *
+ * Build with: cc -o tracedump tracedump.c -lz
+ * (add -DNO_ZLIB to build without support for compressed traces)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef NO_ZLIB
+#include <zlib.h>
+#endif
+
+static const char * const mnemonic[256] = {
+	"BRK", "ORA", "CIM", "ASO", "NOP", "ORA", "ASL", "ASO", "PHP", "ORA", "ASL", "ANC", "NOP", "ORA", "ASL", "ASO",
+	"BPL", "ORA", "CIM", "ASO", "NOP", "ORA", "ASL", "ASO", "CLC", "ORA", "NOP", "ASO", "NOP", "ORA", "ASL", "ASO",
+	"JSR", "AND", "CIM", "RLA", "BIT", "AND", "ROL", "RLA", "PLP", "AND", "ROL", "ANC", "BIT", "AND", "ROL", "RLA",
+	"BMI", "AND", "CIM", "RLA", "NOP", "AND", "ROL", "RLA", "SEC", "AND", "NOP", "RLA", "NOP", "AND", "ROL", "RLA",
+	"RTI", "EOR", "CIM", "LSE", "NOP", "EOR", "LSR", "LSE", "PHA", "EOR", "LSR", "ALR", "JMP", "EOR", "LSR", "LSE",
+	"BVC", "EOR", "CIM", "LSE", "NOP", "EOR", "LSR", "LSE", "CLI", "EOR", "NOP", "LSE", "NOP", "EOR", "LSR", "LSE",
+	"RTS", "ADC", "CIM", "RRA", "NOP", "ADC", "ROR", "RRA", "PLA", "ADC", "ROR", "ARR", "JMP", "ADC", "ROR", "RRA",
+	"BVS", "ADC", "CIM", "RRA", "NOP", "ADC", "ROR", "RRA", "SEI", "ADC", "NOP", "RRA", "NOP", "ADC", "ROR", "RRA",
+	"NOP", "STA", "NOP", "SAX", "STY", "STA", "STX", "SAX", "DEY", "NOP", "TXA", "ANE", "STY", "STA", "STX", "SAX",
+	"BCC", "STA", "CIM", "SHA", "STY", "STA", "STX", "SAX", "TYA", "STA", "TXS", "SHS", "SHY", "STA", "SHX", "SHA",
+	"LDY", "LDA", "LDX", "LAX", "LDY", "LDA", "LDX", "LAX", "TAY", "LDA", "TAX", "ANX", "LDY", "LDA", "LDX", "LAX",
+	"BCS", "LDA", "CIM", "LAX", "LDY", "LDA", "LDX", "LAX", "CLV", "LDA", "TSX", "LAS", "LDY", "LDA", "LDX", "LAX",
+	"CPY", "CMP", "NOP", "DCM", "CPY", "CMP", "DEC", "DCM", "INY", "CMP", "DEX", "SBX", "CPY", "CMP", "DEC", "DCM",
+	"BNE", "CMP", "ESCRTS", "DCM", "NOP", "CMP", "DEC", "DCM", "CLD", "CMP", "NOP", "DCM", "NOP", "CMP", "DEC", "DCM",
+	"CPX", "SBC", "NOP", "INS", "CPX", "SBC", "INC", "INS", "INX", "SBC", "NOP", "SBC", "CPX", "SBC", "INC", "INS",
+	"BEQ", "SBC", "ESCAPE", "INS", "NOP", "SBC", "INC", "INS", "SED", "SBC", "NOP", "INS", "NOP", "SBC", "INC", "INS",};
+
+static unsigned long GetULONG(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | ((unsigned long) p[2] << 16) | ((unsigned long) p[3] << 24);
+}
+
+/* Decodes one block of N records, returns 0 if it is damaged */
+static int DumpBlock(FILE *out, const unsigned char *p, unsigned long size,
+                     unsigned long n, unsigned long long *count)
+{
+	const unsigned char *end = p + size;
+	unsigned int pc = 0, ypos = 0;
+	unsigned int a = 0, x = 0, y = 0, s = 0, flags = 0;
+
+/* fails the block unless K more bytes are left */
+#define NEED(k) if (end - p < (k)) return 0
+
+	for (; n > 0; n--) {
+		unsigned int mask, opcode, xpos;
+		int i;
+
+		NEED(4);
+		mask = *p++;
+		opcode = *p++;
+		xpos = *p++;
+		if (mask & 0x01) {
+			NEED(2);
+			pc = p[0] | (p[1] << 8);
+			p += 2;
+		}
+		else
+			pc = (pc + (signed char) *p++) & 0xffff;
+		if (mask & 0x02) {
+			NEED(1);
+			a = *p++;
+		}
+		if (mask & 0x04) {
+			NEED(1);
+			x = *p++;
+		}
+		if (mask & 0x08) {
+			NEED(1);
+			y = *p++;
+		}
+		if (mask & 0x10) {
+			NEED(1);
+			s = *p++;
+		}
+		if (mask & 0x20) {
+			NEED(1);
+			flags = *p++;
+		}
+		if (mask & 0x40) {
+			NEED(2);
+			ypos = p[0] | (p[1] << 8);
+			p += 2;
+		}
+		fprintf(out, "%10llu %3u %3u %04X: %02X %-6s A=%02X X=%02X Y=%02X S=%02X P=",
+		        *count, ypos, xpos, pc, opcode, mnemonic[opcode], a, x, y, s);
+		for (i = 0; i < 8; i++)
+			fputc(flags & (0x80 >> i) ? "NV*BDIZC"[i] : '-', out);
+		if (mask & 0x80) {
+			NEED(2);
+			fprintf(out, " EA=%04X", p[0] | (p[1] << 8));
+			p += 2;
+		}
+		fputc('\n', out);
+		(*count)++;
+	}
+	return p == end;
+}
+
+int main(int argc, char *argv[])
+{
+	FILE *in;
+	FILE *out = stdout;
+	unsigned char header[12];
+	unsigned char *encoded = NULL;
+	unsigned char *stored = NULL;
+	unsigned long long count = 0;
+	int compressed;
+
+	if (argc < 2 || argc > 3) {
+		fprintf(stderr, "Usage: %s tracefile [textfile]\n", argv[0]);
+		return 1;
+	}
+	in = fopen(argv[1], "rb");
+	if (in == NULL) {
+		perror(argv[1]);
+		return 1;
+	}
+	if (fread(header, 1, 10, in) != 10 || memcmp(header, "ATARITRC", 8) != 0 || header[8] != 1) {
+		fprintf(stderr, "%s: not a version 1 trace log\n", argv[1]);
+		return 1;
+	}
+	compressed = header[9];
+#ifdef NO_ZLIB
+	if (compressed) {
+		fprintf(stderr, "%s: compressed, and this tracedump was built without zlib\n", argv[1]);
+		return 1;
+	}
+#endif
+	if (argc == 3) {
+		out = fopen(argv[2], "w");
+		if (out == NULL) {
+			perror(argv[2]);
+			return 1;
+		}
+	}
+
+	while (fread(header, 1, 12, in) == 12) {
+		unsigned long n = GetULONG(header);
+		unsigned long size = GetULONG(header + 4);
+		unsigned long stored_size = GetULONG(header + 8);
+
+		stored = (unsigned char *) realloc(stored, stored_size);
+		if (stored == NULL || fread(stored, 1, stored_size, in) != stored_size) {
+			fprintf(stderr, "%s: truncated after %llu instructions\n", argv[1], count);
+			break;
+		}
+		if (compressed) {
+#ifndef NO_ZLIB
+			uLongf unpacked = size;
+
+			encoded = (unsigned char *) realloc(encoded, size);
+			if (encoded == NULL || uncompress(encoded, &unpacked, stored, stored_size) != Z_OK
+			    || unpacked != size) {
+				fprintf(stderr, "%s: damaged block after %llu instructions\n", argv[1], count);
+				break;
+			}
+#endif
+		}
+		if (!DumpBlock(out, compressed ? encoded : stored, size, n, &count)) {
+			fprintf(stderr, "%s: damaged block after %llu instructions\n", argv[1], count);
+			break;
+		}
+	}
+
+	free(encoded);
+	free(stored);
+	fclose(in);
+	if (out != stdout)
+		fclose(out);
+	return 0;
+}
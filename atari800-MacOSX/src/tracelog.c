@@ -0,0 +1,338 @@
+/*
+ * tracelog.c - Stream the executed 6502 instructions to a file
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+
+#include "atari.h"
+#include "log.h"
+#include "tracelog.h"
+#include "util.h"
+
+#define TRACELOG_VERSION 1
+
+/* 64K records take about 20 ms of emulated time at full speed */
+#define BLOCK_RECORDS 65536
+#define NUM_BLOCKS 8
+/* mask, opcode, xpos, PC, A, X, Y, S, P, scanline, address */
+#define MAX_RECORD_SIZE 14
+
+int TRACELOG_active = FALSE;
+TRACELOG_record *TRACELOG_next = NULL;
+TRACELOG_record *TRACELOG_end = NULL;
+uint64_t TRACELOG_count = 0;
+
+static TRACELOG_record *blocks[NUM_BLOCKS];
+static int block_records[NUM_BLOCKS];
+static int fill;			/* block being filled by CPU_GO */
+static int drain;			/* next block for the writer */
+static int queued;			/* full blocks waiting for the writer */
+static int stopping;
+
+static FILE *trace_file = NULL;
+static int compress_blocks;
+static int write_error;
+static UBYTE *encoded = NULL;
+static UBYTE *stored = NULL;
+static ULONG stored_max;
+
+static pthread_t writer;
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_filled = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t queue_drained = PTHREAD_COND_INITIALIZER;
+
+static void PutULONG(UBYTE *p, ULONG value)
+{
+	p[0] = (UBYTE) value;
+	p[1] = (UBYTE) (value >> 8);
+	p[2] = (UBYTE) (value >> 16);
+	p[3] = (UBYTE) (value >> 24);
+}
+
+/* Delta encodes N records into encoded[], returns the size */
+static ULONG Encode(const TRACELOG_record *r, int n)
+{
+	TRACELOG_record prev;
+	UBYTE *p = encoded;
+
+	memset(&prev, 0, sizeof(prev));
+	for (; n > 0; n--, r++) {
+		UBYTE *mask = p;
+		int delta = r->pc - prev.pc;
+
+		*p++ = 0;
+		*p++ = r->opcode;
+		*p++ = r->xpos;
+		if (delta < -128 || delta > 127) {
+			*mask |= 0x01;
+			*p++ = (UBYTE) r->pc;
+			*p++ = (UBYTE) (r->pc >> 8);
+		}
+		else
+			*p++ = (UBYTE) (SBYTE) delta;
+		if (r->a != prev.a) {
+			*mask |= 0x02;
+			*p++ = r->a;
+		}
+		if (r->x != prev.x) {
+			*mask |= 0x04;
+			*p++ = r->x;
+		}
+		if (r->y != prev.y) {
+			*mask |= 0x08;
+			*p++ = r->y;
+		}
+		if (r->s != prev.s) {
+			*mask |= 0x10;
+			*p++ = r->s;
+		}
+		if (r->p != prev.p) {
+			*mask |= 0x20;
+			*p++ = r->p;
+		}
+		if (r->ypos != prev.ypos) {
+			*mask |= 0x40;
+			*p++ = (UBYTE) r->ypos;
+			*p++ = (UBYTE) (r->ypos >> 8);
+		}
+		if (r->has_addr) {
+			*mask |= 0x80;
+			*p++ = (UBYTE) r->addr;
+			*p++ = (UBYTE) (r->addr >> 8);
+		}
+		prev = *r;
+	}
+	return (ULONG) (p - encoded);
+}
+
+static void WriteBlock(const TRACELOG_record *r, int n)
+{
+	UBYTE header[12];
+	ULONG size = Encode(r, n);
+	const UBYTE *data = encoded;
+	ULONG data_size = size;
+
+#ifdef HAVE_LIBZ
+	if (compress_blocks) {
+		uLongf packed = stored_max;
+
+		if (compress2(stored, &packed, encoded, size, 1) == Z_OK) {
+			data = stored;
+			data_size = (ULONG) packed;
+		}
+		else
+			write_error = TRUE;
+	}
+#endif
+	PutULONG(header, (ULONG) n);
+	PutULONG(header + 4, size);
+	PutULONG(header + 8, data_size);
+	if (fwrite(header, 1, sizeof(header), trace_file) != sizeof(header)
+	    || fwrite(data, 1, data_size, trace_file) != data_size)
+		write_error = TRUE;
+}
+
+static void *Writer(void *arg)
+{
+	pthread_mutex_lock(&queue_mutex);
+	for (;;) {
+		int b;
+
+		while (queued == 0 && !stopping)
+			pthread_cond_wait(&queue_filled, &queue_mutex);
+		if (queued == 0)
+			break;
+		b = drain;
+		pthread_mutex_unlock(&queue_mutex);
+
+		WriteBlock(blocks[b], block_records[b]);
+
+		pthread_mutex_lock(&queue_mutex);
+		drain = (drain + 1) % NUM_BLOCKS;
+		queued--;
+		pthread_cond_signal(&queue_drained);
+	}
+	pthread_mutex_unlock(&queue_mutex);
+	return NULL;
+}
+
+/* Queues the records filled so far in the current block */
+static void Queue(void)
+{
+	int n = (int) (TRACELOG_next - blocks[fill]);
+
+	if (n == 0)
+		return;
+	TRACELOG_count += n;
+	pthread_mutex_lock(&queue_mutex);
+	block_records[fill] = n;
+	queued++;
+	pthread_cond_signal(&queue_filled);
+	/* the emulation waits here only if the writer is NUM_BLOCKS behind */
+	while (queued == NUM_BLOCKS)
+		pthread_cond_wait(&queue_drained, &queue_mutex);
+	fill = (fill + 1) % NUM_BLOCKS;
+	pthread_mutex_unlock(&queue_mutex);
+	TRACELOG_next = blocks[fill];
+	TRACELOG_end = blocks[fill] + BLOCK_RECORDS;
+}
+
+void TRACELOG_Flush(void)
+{
+	Queue();
+}
+
+int TRACELOG_Start(const char *filename, int compress)
+{
+	static const char magic[8] = "ATARITRC";
+	UBYTE header[10];
+	int i;
+
+	TRACELOG_Stop();
+#ifndef HAVE_LIBZ
+	compress = FALSE;
+#endif
+	trace_file = fopen(filename, "wb");
+	if (trace_file == NULL)
+		return FALSE;
+	memcpy(header, magic, sizeof(magic));
+	header[8] = TRACELOG_VERSION;
+	header[9] = (UBYTE) (compress ? 1 : 0);
+	if (fwrite(header, 1, sizeof(header), trace_file) != sizeof(header)) {
+		fclose(trace_file);
+		trace_file = NULL;
+		return FALSE;
+	}
+
+	for (i = 0; i < NUM_BLOCKS; i++)
+		if (blocks[i] == NULL)
+			blocks[i] = (TRACELOG_record *) Util_malloc(BLOCK_RECORDS * sizeof(TRACELOG_record));
+	if (encoded == NULL)
+		encoded = (UBYTE *) Util_malloc(BLOCK_RECORDS * MAX_RECORD_SIZE);
+#ifdef HAVE_LIBZ
+	if (compress && stored == NULL) {
+		stored_max = (ULONG) compressBound(BLOCK_RECORDS * MAX_RECORD_SIZE);
+		stored = (UBYTE *) Util_malloc(stored_max);
+	}
+#endif
+	compress_blocks = compress;
+	write_error = FALSE;
+	fill = drain = queued = 0;
+	stopping = FALSE;
+	TRACELOG_count = 0;
+	/* a record is committed at the end of an instruction, so one that is
+	   already running when the trace starts must not leave garbage */
+	memset(blocks[0], 0, sizeof(TRACELOG_record));
+	TRACELOG_next = blocks[0];
+	TRACELOG_end = blocks[0] + BLOCK_RECORDS;
+
+	if (pthread_create(&writer, NULL, Writer, NULL) != 0) {
+		fclose(trace_file);
+		trace_file = NULL;
+		return FALSE;
+	}
+	TRACELOG_active = TRUE;
+	return TRUE;
+}
+
+void TRACELOG_Stop(void)
+{
+	if (trace_file == NULL)
+		return;
+	TRACELOG_active = FALSE;
+	Queue();
+	pthread_mutex_lock(&queue_mutex);
+	stopping = TRUE;
+	pthread_cond_signal(&queue_filled);
+	pthread_mutex_unlock(&queue_mutex);
+	pthread_join(writer, NULL);
+	if (fclose(trace_file) != 0)
+		write_error = TRUE;
+	trace_file = NULL;
+	if (write_error)
+		Log_print("Trace log: error writing the file, the trace is incomplete");
+}
+
+int TRACELOG_Initialise(int *argc, char *argv[])
+{
+	int i;
+	int j;
+	const char *filename = NULL;
+	int compress = TRUE;
+
+	for (i = j = 1; i < *argc; i++) {
+		int i_a = (i + 1 < *argc);		/* is argument available? */
+		int a_m = FALSE;			/* error, argument missing! */
+
+		if (strcmp(argv[i], "-tracelog") == 0) {
+			if (i_a)
+				filename = argv[++i];
+			else a_m = TRUE;
+		}
+		else if (strcmp(argv[i], "-tracelog-raw") == 0)
+			compress = FALSE;
+		else {
+			if (strcmp(argv[i], "-help") == 0) {
+				Log_print("\t-tracelog <file>  Write every executed instruction to a trace file");
+				Log_print("\t-tracelog-raw     Do not compress the trace file");
+			}
+			argv[j++] = argv[i];
+		}
+
+		if (a_m) {
+			Log_print("Missing argument for '%s'", argv[i]);
+			return FALSE;
+		}
+	}
+	*argc = j;
+
+	if (filename != NULL && !TRACELOG_Start(filename, compress))
+		Log_print("Trace log: can not create %s", filename);
+
+	return TRUE;
+}
+
+void TRACELOG_Exit(void)
+{
+	int i;
+
+	TRACELOG_Stop();
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		free(blocks[i]);
+		blocks[i] = NULL;
+	}
+	free(encoded);
+	encoded = NULL;
+	free(stored);
+	stored = NULL;
+}
+
+/*
+vim:ts=4:sw=4:
+*/
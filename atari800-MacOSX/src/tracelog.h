@@ -0,0 +1,53 @@
+#ifndef TRACELOG_H_
+#define TRACELOG_H_
+
+#include <stdint.h>
+#include "atari.h"
+
+/* Streams every executed 6502 instruction to a file. CPU_GO fills blocks
+   of records in memory and a writer thread encodes, compresses and writes
+   them, so the emulation only waits if the disk can not keep up.
+
+   File format (little endian):
+     "ATARITRC", version byte (1), compression byte (0 = none, 1 = zlib)
+     then blocks of: ULONG records, ULONG encoded size, ULONG stored size,
+     and the stored bytes (deflated when compressed).
+   Each record is a mask byte, the opcode and xpos, then the fields the
+   mask marks as changed since the previous record of the block:
+     bit 0: PC, 2 bytes (otherwise a signed byte added to the previous PC)
+     bits 1-5: A, X, Y, S, P, 1 byte each
+     bit 6: scanline, 2 bytes
+     bit 7: effective address, 2 bytes (only for memory accessing opcodes)
+   Blocks start from an all zero state, so each can be decoded alone.
+   tracedump.c converts a trace to text. */
+
+typedef struct TRACELOG_record_t {
+	UWORD pc;
+	UWORD addr;				/* effective address */
+	UWORD ypos;
+	UBYTE xpos;
+	UBYTE opcode;
+	UBYTE a;
+	UBYTE x;
+	UBYTE y;
+	UBYTE s;
+	UBYTE p;
+	UBYTE has_addr;			/* TRUE if addr is valid */
+} TRACELOG_record;
+
+extern int TRACELOG_active;
+/* Next record to fill and the end of the current block */
+extern TRACELOG_record *TRACELOG_next;
+extern TRACELOG_record *TRACELOG_end;
+/* Instructions passed to the writer since the trace was started */
+extern uint64_t TRACELOG_count;
+
+int TRACELOG_Initialise(int *argc, char *argv[]);
+int TRACELOG_Start(const char *filename, int compress);
+void TRACELOG_Stop(void);
+/* Passes the full block to the writer, called by CPU_GO when
+   TRACELOG_next reaches TRACELOG_end */
+void TRACELOG_Flush(void);
+void TRACELOG_Exit(void);
+
+#endif /* TRACELOG_H_ */
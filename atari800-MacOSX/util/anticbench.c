@@ -0,0 +1,188 @@
+/*
+ * anticbench.c - checks the ANTIC vector kernels against the scalar code
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/* Part of atari800-bench, see src/Makefile.bench. Usage:
+     atari800-bench -bench-simd <frames> */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "antic.h"
+#include "antic_simd.h"
+#include "atari.h"
+#include "bench.h"
+#include "cpu.h"
+#include "gtia.h"
+#include "log.h"
+#include "memory.h"
+#include "pokey.h"
+#include "screen.h"
+#include "statesav.h"
+#include "util.h"
+
+int BENCH_simd_frames = 0;
+
+#ifdef ANTIC_SIMD
+/* The -bench-simd test screen: a display list with rows of ANTIC modes 2,
+   3, 4, 5, E and F, each line with its own LMS into 48 byte wide screen
+   data, a character set and single line players and missiles. The CPU is
+   parked in a JMP * loop below the display list with the interrupts off,
+   so nothing but the test writes to this memory or to ANTIC and GTIA. */
+#define SIMD_LOOP 0x3ffd
+#define SIMD_DLIST 0x4000
+#define SIMD_SCREEN 0x5000
+#define SIMD_CHARSET 0x7000
+#define SIMD_PMBASE 0x7800
+#define SIMD_LINE_BYTES 48
+
+static const struct {
+	UBYTE mode;
+	int lines;
+} simd_rows[] = {
+	{ 0x2, 4 }, { 0x3, 2 }, { 0x4, 4 }, { 0x5, 2 }, { 0xe, 40 }, { 0xf, 40 }
+};
+
+static void SetUpSIMDScreen(void)
+{
+	UWORD dl = SIMD_DLIST;
+	UWORD screen = SIMD_SCREEN;
+	int row;
+	int i;
+
+	MEMORY_dPutByte(SIMD_LOOP, 0x4c);
+	MEMORY_dPutByte(SIMD_LOOP + 1, (UBYTE) SIMD_LOOP);
+	MEMORY_dPutByte(SIMD_LOOP + 2, (UBYTE) (SIMD_LOOP >> 8));
+	CPU_regPC = SIMD_LOOP;
+	CPU_GetStatus();
+	CPU_SetI;
+	CPU_PutStatus();
+	ANTIC_PutByte(ANTIC_OFFSET_NMIEN, 0);
+	POKEY_PutByte(POKEY_OFFSET_IRQEN, 0);
+
+	for (i = 0; i < 3; i++)
+		MEMORY_dPutByte(dl++, 0x70);
+	for (row = 0; row < (int) (sizeof(simd_rows) / sizeof(simd_rows[0])); row++) {
+		for (i = 0; i < simd_rows[row].lines; i++) {
+			MEMORY_dPutByte(dl++, 0x40 | simd_rows[row].mode);
+			MEMORY_dPutByte(dl++, (UBYTE) screen);
+			MEMORY_dPutByte(dl++, (UBYTE) (screen >> 8));
+			screen += SIMD_LINE_BYTES;
+		}
+	}
+	MEMORY_dPutByte(dl++, 0x41);
+	MEMORY_dPutByte(dl++, (UBYTE) SIMD_DLIST);
+	MEMORY_dPutByte(dl, (UBYTE) (SIMD_DLIST >> 8));
+
+	ANTIC_PutByte(ANTIC_OFFSET_DLISTL, (UBYTE) SIMD_DLIST);
+	ANTIC_PutByte(ANTIC_OFFSET_DLISTH, (UBYTE) (SIMD_DLIST >> 8));
+	ANTIC_PutByte(ANTIC_OFFSET_CHBASE, SIMD_CHARSET >> 8);
+	ANTIC_PutByte(ANTIC_OFFSET_PMBASE, SIMD_PMBASE >> 8);
+	GTIA_PutByte(GTIA_OFFSET_GRACTL, 3);
+}
+
+/* New random screen data, colours, character set and PMG for a frame.
+   Every other frame the players and missiles are moved off the screen,
+   so that whole lines are drawn by the kernels. */
+static void RandomiseSIMDScreen(int frame)
+{
+	int pmg = frame & 1;
+	int i;
+
+	for (i = SIMD_SCREEN; i < SIMD_CHARSET + 0x1000; i++)
+		MEMORY_dPutByte(i, (UBYTE) rand());
+	/* runs of blank characters as on real screens */
+	for (i = 0; i < 64; i++)
+		memset(MEMORY_mem + SIMD_SCREEN + rand() % (SIMD_CHARSET - SIMD_SCREEN - 32), 0, rand() % 32);
+	/* narrow, normal or wide playfield, players, missiles and the display list */
+	ANTIC_PutByte(ANTIC_OFFSET_DMACTL, (UBYTE) (0x3c | (rand() % 3 + 1)));
+	ANTIC_PutByte(ANTIC_OFFSET_CHACTL, (UBYTE) (rand() & 7));
+	GTIA_PutByte(GTIA_OFFSET_PRIOR, (UBYTE) (rand() & 0x3f));	/* no GTIA modes */
+	for (i = GTIA_OFFSET_COLPM0; i <= GTIA_OFFSET_COLBK; i++)
+		GTIA_PutByte((UWORD) i, (UBYTE) rand());
+	for (i = 0; i < 4; i++) {
+		GTIA_PutByte((UWORD) (GTIA_OFFSET_HPOSP0 + i), (UBYTE) (pmg ? rand() : 0));
+		GTIA_PutByte((UWORD) (GTIA_OFFSET_HPOSM0 + i), (UBYTE) (pmg ? rand() : 0));
+		GTIA_PutByte((UWORD) (GTIA_OFFSET_SIZEP0 + i), (UBYTE) rand());
+	}
+	GTIA_PutByte(GTIA_OFFSET_SIZEM, (UBYTE) rand());
+}
+
+int BENCH_CheckSIMD(void)
+{
+	size_t screen_size = Screen_WIDTH * Screen_HEIGHT;
+	UBYTE *reference = (UBYTE *) Util_malloc(screen_size);
+	UBYTE *state = NULL;
+	ULONG state_capacity = 0;
+	int frames_differed = 0;
+	int f;
+
+	Atari800_turbo = TRUE;
+	/* boot, so that the test starts from a running machine */
+	for (f = 0; f < 200; f++)
+		Atari800_Frame();
+	srand(1);
+	SetUpSIMDScreen();
+
+	for (f = 0; f < BENCH_simd_frames; f++) {
+		ULONG size;
+		ULONG random_counter;
+		size_t i;
+
+		RandomiseSIMDScreen(f);
+		size = StateSav_SaveMem(&state, &state_capacity);
+		random_counter = POKEY_GetRandomCounter();
+		ANTIC_SIMD_enabled = FALSE;
+		Atari800_Frame();
+		memcpy(reference, Screen_atari, screen_size);
+
+		StateSav_ReadMem(state, size);
+		POKEY_SetRandomCounter(random_counter);
+		ANTIC_SIMD_enabled = TRUE;
+		Atari800_Frame();
+		for (i = 0; i < screen_size; i++)
+			if (((UBYTE *) Screen_atari)[i] != reference[i])
+				break;
+		if (i < screen_size) {
+			if (frames_differed++ == 0)
+				Log_print("SIMD check: frame %d differs first at x %d, y %d", f,
+				          (int) (i % Screen_WIDTH), (int) (i / Screen_WIDTH));
+		}
+	}
+	Log_print("SIMD check: %d of %d frames differed", frames_differed, BENCH_simd_frames);
+	Log_flushlog();
+	free(state);
+	free(reference);
+	return frames_differed == 0;
+}
+#else
+int BENCH_CheckSIMD(void)
+{
+	Log_print("-bench-simd: this build has no ANTIC vector kernels");
+	return FALSE;
+}
+#endif /* ANTIC_SIMD */
+
+/*
+vim:ts=4:sw=4:
+*/
@@ -0,0 +1,99 @@
+/*
+ * bankbench.c - times the bank switches of extended memory and cartridges
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/* Part of atari800-bench, see src/Makefile.bench. Usage:
+     atari800-bench -bench-banks <n> [-xe | -ram <kb>] */
+
+#include "config.h"
+#include <stdlib.h>
+
+#include "atari.h"
+#include "bench.h"
+#include "cartridge.h"
+#include "log.h"
+#include "memory.h"
+
+int BENCH_bank_switches = 0;
+
+static void ReportBanks(const char *kind, double time)
+{
+	if (time <= 0.0)
+		time = 1e-9;
+	Log_print("%s: %d bank switches in %.3f s, %.0f switches/s, %.1f ns/switch",
+	          kind, BENCH_bank_switches, time, BENCH_bank_switches / time,
+	          time * 1e9 / BENCH_bank_switches);
+}
+
+void BENCH_Banks(void)
+{
+	double start;
+	int i;
+
+	if (Atari800_machine_type == Atari800_MACHINE_XLXE && MEMORY_ram_size > 64) {
+		/* PORTB as a 130XE demo writes it: OS on, BASIC off, the CPU
+		   through banks 0-3 and ANTIC on main memory */
+		UBYTE portb = 0xff;
+		int bank;
+
+		/* different data in each bank, as a RAM disk would hold */
+		srand(1);
+		for (bank = 0; bank < 4; bank++) {
+			UBYTE new_portb = (UBYTE) (0xe3 | bank << 2);
+
+			MEMORY_HandlePORTB(new_portb, portb);
+			portb = new_portb;
+			for (i = 0x4000; i < 0x8000; i++)
+				MEMORY_mem[i] = (UBYTE) rand();
+		}
+		start = BENCH_Now();
+		for (i = 0; i < BENCH_bank_switches; i++) {
+			UBYTE new_portb = (UBYTE) (0xe3 | (i & 3) << 2);
+
+			MEMORY_HandlePORTB(new_portb, portb);
+			portb = new_portb;
+		}
+		ReportBanks("XE PORTB", BENCH_Now() - start);
+		MEMORY_HandlePORTB(0xff, portb);
+	}
+	else
+		Log_print("XE PORTB: no extended memory, use -xe or -ram 128 and over");
+
+	/* A 1 MB XEGS cartridge of random data, its 8 KB bank at $8000
+	   switched by writes to $D5xx as a streaming game would */
+	if (Atari800_machine_type != Atari800_MACHINE_5200) {
+		CARTRIDGE_Insert_Blank(CARTRIDGE_XEGS_1024);
+		srand(1);
+		for (i = 0; i < CARTRIDGE_main.size * 1024; i++)
+			CARTRIDGE_main.image[i] = (UBYTE) rand();
+		start = BENCH_Now();
+		for (i = 0; i < BENCH_bank_switches; i++)
+			CARTRIDGE_PutByte(0xd500, (UBYTE) (i & 0x7f));
+		ReportBanks("XEGS cartridge", BENCH_Now() - start);
+		CARTRIDGE_Remove();
+	}
+	Log_flushlog();
+}
+
+/*
+vim:ts=4:sw=4:
+*/
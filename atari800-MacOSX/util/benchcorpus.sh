@@ -0,0 +1,79 @@
+#!/bin/sh
+# Runs the headless benchmark over a fixed corpus of programs and checks
+# the frame rates against a baseline, for catching speed regressions in CI.
+#
+# Usage: benchcorpus.sh [-f frames] [-o results] [-b baseline] [-t percent]
+#                       [emulator [corpus]]
+#
+# emulator defaults to ../src/atari800-bench, built with
+# "make -f Makefile.bench" in src. corpus is a file with one program per
+# line, relative to the corpus file, or "-" to boot to the BASIC editor
+# (-basic, as the core disables BASIC by default); it defaults to
+# benchcorpus.txt next to this script. Each line of the results and of the
+# baseline is "<program> <frames/s>". With -b the script fails if a program
+# runs more than percent (default 10) slower than in the baseline. Results
+# are only comparable on the same machine.
+
+here=`dirname "$0"`
+frames=3000
+results=
+baseline=
+tolerance=10
+
+while getopts f:o:b:t: opt; do
+	case $opt in
+	f) frames=$OPTARG ;;
+	o) results=$OPTARG ;;
+	b) baseline=$OPTARG ;;
+	t) tolerance=$OPTARG ;;
+	*) sed -n '4,5p' "$0" >&2; exit 2 ;;
+	esac
+done
+shift `expr $OPTIND - 1`
+emulator=${1:-$here/../src/atari800-bench}
+corpus=${2:-$here/benchcorpus.txt}
+corpus_dir=`dirname "$corpus"`
+
+if [ ! -x "$emulator" ]; then
+	echo "$emulator not found, build it with make -f Makefile.bench in src" >&2
+	exit 2
+fi
+
+out=`mktemp`
+trap 'rm -f "$out"' EXIT
+failed=0
+
+while read -r program; do
+	case $program in
+	''|'#'*) continue ;;
+	-) args=-basic ;;
+	*) args=$corpus_dir/$program ;;
+	esac
+	fps=`"$emulator" -bench "$frames" $args |
+	     sed -n 's/^Benchmark: .*, \([0-9.]*\) frames\/s.*/\1/p'`
+	if [ -z "$fps" ]; then
+		echo "$program: no benchmark result" >&2
+		failed=1
+		continue
+	fi
+	echo "$program $fps" >> "$out"
+
+	expected=
+	if [ -n "$baseline" ]; then
+		expected=`awk -v p="$program" '$1 == p { print $2 }' "$baseline"`
+	fi
+	if [ -z "$expected" ]; then
+		printf '%-24s %10.1f frames/s\n' "$program" "$fps"
+	elif awk -v f="$fps" -v e="$expected" -v t="$tolerance" \
+	         'BEGIN { exit !(f < e * (100 - t) / 100) }'; then
+		printf '%-24s %10.1f frames/s, baseline %.1f: SLOWER\n' "$program" "$fps" "$expected"
+		failed=1
+	else
+		printf '%-24s %10.1f frames/s, baseline %.1f\n' "$program" "$fps" "$expected"
+	fi
+done < "$corpus"
+
+if [ -n "$results" ]; then
+	cp "$out" "$results"
+fi
+exit $failed
@@ -0,0 +1,194 @@
+/*
+ * netsiobench.c - times NetSIO command frames to a stand-in FujiNet
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/* Part of atari800-bench, see src/Makefile.bench. Usage:
+     atari800-bench -bench-netsio <commands> */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "atari.h"
+#include "bench.h"
+#include "log.h"
+#include "util.h"
+#ifdef NETSIO
+#include <errno.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "netsio.h"
+#endif
+
+int BENCH_netsio_commands = 0;
+
+#ifdef NETSIO
+/* The stand-in FujiNet listens on 127.0.0.2 and NetSIO on every address,
+   both on this port. NetSIO answers on the port it is bound to, and the
+   more specific address gets the packets sent to 127.0.0.2. macOS needs
+   "ifconfig lo0 alias 127.0.0.2" first. */
+#define NETSIO_BENCH_PORT 19997
+#define NETSIO_BENCH_HOST "127.0.0.2"
+/* the turnaround FujiNet-PC needs from NetSIO for SIO timing */
+#define NETSIO_BENCH_LIMIT_US 1000.0
+
+static int fujinet_sock = -1;
+static volatile int fujinet_stop;
+
+/* Answers each COMMAND_OFF_SYNC, the end of a command frame, with an ACK
+   the way FujiNet-PC does, and ignores everything else */
+static void *FujiNetStandIn(void *arg)
+{
+	struct sockaddr_in netsio_addr;
+	UBYTE connected = NETSIO_DEVICE_CONNECTED;
+	UBYTE buf[600];
+
+	memset(&netsio_addr, 0, sizeof(netsio_addr));
+	netsio_addr.sin_family = AF_INET;
+	netsio_addr.sin_port = htons(NETSIO_BENCH_PORT);
+	netsio_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sendto(fujinet_sock, &connected, 1, 0, (struct sockaddr *) &netsio_addr, sizeof(netsio_addr));
+
+	while (!fujinet_stop) {
+		ssize_t n = recv(fujinet_sock, buf, sizeof(buf), 0);
+
+		if (n >= 2 && buf[0] == NETSIO_COMMAND_OFF_SYNC) {
+			UBYTE ack[6];
+
+			ack[0] = NETSIO_SYNC_RESPONSE;
+			ack[1] = buf[1];
+			ack[2] = 1;		/* ACK */
+			ack[3] = 'A';
+			ack[4] = ack[5] = 0;
+			sendto(fujinet_sock, ack, sizeof(ack), 0, (struct sockaddr *) &netsio_addr, sizeof(netsio_addr));
+		}
+	}
+	return NULL;
+}
+
+static int CompareDoubles(const void *a, const void *b)
+{
+	double x = *(const double *) a;
+	double y = *(const double *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+int BENCH_NetSIO(void)
+{
+	/* get adapter config, as netsio_test_cmd sends */
+	static const UBYTE command[5] = { 0x70, 0xe8, 0x00, 0x00, 0x59 };
+	struct sockaddr_in addr;
+	struct timeval timeout;
+	pthread_t thread;
+	double *times;
+	double start;
+	int reuse = 1;
+	int lost = 0;
+	int ok;
+	int i;
+
+	fujinet_sock = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fujinet_sock < 0) {
+		Log_print("NetSIO loopback: cannot open a socket");
+		return FALSE;
+	}
+	setsockopt(fujinet_sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+	/* so the thread sees fujinet_stop */
+	timeout.tv_sec = 0;
+	timeout.tv_usec = 100000;
+	setsockopt(fujinet_sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(NETSIO_BENCH_PORT);
+	addr.sin_addr.s_addr = inet_addr(NETSIO_BENCH_HOST);
+	if (bind(fujinet_sock, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		Log_print("NetSIO loopback: cannot bind %s:%d (%s)", NETSIO_BENCH_HOST,
+		          NETSIO_BENCH_PORT, strerror(errno));
+		close(fujinet_sock);
+		return FALSE;
+	}
+
+	if (netsio_init(NETSIO_BENCH_PORT) < 0) {
+		close(fujinet_sock);
+		return FALSE;
+	}
+	fujinet_stop = FALSE;
+	pthread_create(&thread, NULL, FujiNetStandIn, NULL);
+	start = BENCH_Now();
+	while (!netsio_enabled && BENCH_Now() - start < 1.0)
+		usleep(1000);
+
+	times = (double *) Util_malloc(BENCH_netsio_commands * sizeof(double));
+	for (i = 0; i < BENCH_netsio_commands && netsio_enabled; i++) {
+		UBYTE ack;
+
+		start = BENCH_Now();
+		netsio_cmd_on();
+		netsio_send_block(command, sizeof(command));
+		netsio_cmd_off_sync();
+		netsio_wait_for_sync();
+		if (netsio_recv_byte(&ack) < 0 || ack != 'A')
+			lost++;		/* the wait timed out */
+		times[i] = BENCH_Now() - start;
+	}
+
+	fujinet_stop = TRUE;
+	pthread_join(thread, NULL);
+	close(fujinet_sock);
+
+	if (i == 0) {
+		Log_print("NetSIO loopback: the stand-in FujiNet did not connect");
+		ok = FALSE;
+	}
+	else {
+		double median;
+
+		qsort(times, i, sizeof(double), CompareDoubles);
+		median = times[i / 2] * 1e6;
+		Log_print("NetSIO loopback: %d command frames, turnaround min %.0f us, median %.0f us,"
+		          " 99%% %.0f us, max %.0f us, %d lost", i, times[0] * 1e6, median,
+		          times[i * 99 / 100] * 1e6, times[i - 1] * 1e6, lost);
+		ok = lost == 0 && median < NETSIO_BENCH_LIMIT_US;
+		if (!ok)
+			Log_print("NetSIO loopback: FAILED, want no lost frames and a median under %.0f us",
+			          NETSIO_BENCH_LIMIT_US);
+	}
+	free(times);
+	Log_flushlog();
+	return ok;
+}
+#else
+int BENCH_NetSIO(void)
+{
+	Log_print("-bench-netsio needs NetSIO support");
+	return FALSE;
+}
+#endif /* NETSIO */
+
+/*
+vim:ts=4:sw=4:
+*/
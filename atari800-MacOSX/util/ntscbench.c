@@ -0,0 +1,134 @@
+/*
+ * ntscbench.c - Times the NTSC composite filter and checks NTSC_FILTER_Blit
+ *               against atari_ntsc_blit
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/* Build from this directory with:
+     cc -O2 -I../src -I../src/Atari800MacX -o ntscbench ntscbench.c \
+        ../src/ntsc_filter.c ../src/atari_ntsc.c -lpthread -lm
+   Usage: ntscbench [frames [threads]] */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "atari_ntsc.h"
+#include "ntsc_filter.h"
+#include "log.h"
+
+#define IN_WIDTH 336	/* the default width of the Mac front end */
+#define HEIGHT 240
+#define OUT_WIDTH NTSC_FILTER_OUT_WIDTH(IN_WIDTH)
+
+void Log_print(char *format, ...)
+{
+}
+
+static double Now(void)
+{
+	struct timeval tp;
+
+	gettimeofday(&tp, NULL);
+	return tp.tv_sec + 1e-6 * tp.tv_usec;
+}
+
+/* Screens of runs of random colours, like real ones, with noise between */
+static void MakeScreen(UBYTE *screen, int frame)
+{
+	int i = 0;
+
+	srand(frame);
+	while (i < IN_WIDTH * HEIGHT) {
+		int run = rand() % 16 + 1;
+		UBYTE colour = (UBYTE) rand();
+
+		while (run-- > 0 && i < IN_WIDTH * HEIGHT)
+			screen[i++] = rand() % 8 ? colour : (UBYTE) rand();
+	}
+}
+
+int main(int argc, char **argv)
+{
+	static atari_ntsc_t emu;
+	atari_ntsc_setup_t setup;
+	int frames = argc > 1 ? atoi(argv[1]) : 1000;
+	int max_threads = argc > 2 ? atoi(argv[2]) : 4;
+	UBYTE *screens = (UBYTE *) malloc(8 * IN_WIDTH * HEIGHT);
+	UWORD *reference = (UWORD *) malloc(OUT_WIDTH * HEIGHT * sizeof(UWORD));
+	UWORD *out = (UWORD *) malloc(OUT_WIDTH * HEIGHT * sizeof(UWORD));
+	double start;
+	double single;
+	int threads;
+	int i;
+
+	memset(&setup, 0, sizeof(setup));
+	ATARI_NTSC_DEFAULTS_Initialise(&argc, argv, &setup);
+	atari_ntsc_init(&emu, &setup);
+	for (i = 0; i < 8; i++)
+		MakeScreen(screens + i * IN_WIDTH * HEIGHT, i);
+
+	/* The output must not differ in a single pixel */
+	NTSC_FILTER_Initialise(max_threads - 1);
+	NTSC_FILTER_SetKernels(&emu);
+	for (i = 0; i < 8; i++) {
+		int differ = 0;
+		int j;
+
+		atari_ntsc_blit(&emu, screens + i * IN_WIDTH * HEIGHT, IN_WIDTH, OUT_WIDTH, HEIGHT,
+		                reference, OUT_WIDTH * sizeof(UWORD));
+		NTSC_FILTER_Blit(screens + i * IN_WIDTH * HEIGHT, IN_WIDTH, IN_WIDTH, HEIGHT,
+		                 out, OUT_WIDTH * sizeof(UWORD));
+		for (j = 0; j < OUT_WIDTH * HEIGHT; j++)
+			if (out[j] != reference[j])
+				differ++;
+		if (differ) {
+			printf("Screen %d: %d of %d pixels differ from atari_ntsc_blit\n",
+			       i, differ, OUT_WIDTH * HEIGHT);
+			return 1;
+		}
+	}
+
+	printf("%dx%d to %dx%d, %d frames\n", IN_WIDTH, HEIGHT, OUT_WIDTH, HEIGHT, frames);
+	start = Now();
+	for (i = 0; i < frames; i++)
+		atari_ntsc_blit(&emu, screens + (i & 7) * IN_WIDTH * HEIGHT, IN_WIDTH, OUT_WIDTH,
+		                HEIGHT, reference, OUT_WIDTH * sizeof(UWORD));
+	single = Now() - start;
+	printf("atari_ntsc_blit:          %8.3f ms/frame\n", single * 1000.0 / frames);
+	for (threads = 1; threads <= max_threads; threads++) {
+		double t;
+
+		NTSC_FILTER_Initialise(threads - 1);
+		NTSC_FILTER_SetKernels(&emu);
+		start = Now();
+		for (i = 0; i < frames; i++)
+			NTSC_FILTER_Blit(screens + (i & 7) * IN_WIDTH * HEIGHT, IN_WIDTH, IN_WIDTH,
+			                 HEIGHT, out, OUT_WIDTH * sizeof(UWORD));
+		t = Now() - start;
+		printf("NTSC_FILTER_Blit, %d thread%s: %8.3f ms/frame, %.1fx\n", threads,
+		       threads > 1 ? "s" : " ", t * 1000.0 / frames, single / t);
+	}
+	NTSC_FILTER_Exit();
+	return 0;
+}
@@ -0,0 +1,147 @@
+/*
+ * pokeysndbench.c - times rendering the POKEY writes of a program to sound
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/* Part of atari800-bench, see src/Makefile.bench. Usage:
+     atari800-bench -bench-pokey <seconds> [program]
+   pokeytones.xex in this directory keeps all four channels busy. */
+
+#include "config.h"
+#include <stdlib.h>
+
+#include "antic.h"
+#include "atari.h"
+#include "bench.h"
+#include "log.h"
+#include "util.h"
+#ifdef SOUND
+#include "mzpokeysnd.h"
+#include "pokeysnd.h"
+#endif
+
+int BENCH_pokey_seconds = 0;
+
+#if defined(SOUND) && defined(SYNCHRONIZED_SOUND)
+/* A write to a POKEY sound register and the beam position it was made at,
+   which is where the synchronized sound renders up to before applying it */
+typedef struct {
+	int ypos;
+	int xpos;
+	UWORD addr;
+	UBYTE val;
+	UBYTE gain;
+} PokeyWrite;
+
+static PokeyWrite *pokey_writes;
+static int pokey_writes_count;
+static int pokey_writes_size;
+static void (*pokey_update)(UWORD addr, UBYTE val, UBYTE chip, UBYTE gain);
+
+static void RecordPokeyWrite(UWORD addr, UBYTE val, UBYTE chip, UBYTE gain)
+{
+	PokeyWrite *w;
+
+	if (pokey_writes_count == pokey_writes_size) {
+		pokey_writes_size = pokey_writes_size == 0 ? 4096 : pokey_writes_size * 2;
+		pokey_writes = (PokeyWrite *) Util_realloc(pokey_writes, pokey_writes_size * sizeof(PokeyWrite));
+	}
+	w = &pokey_writes[pokey_writes_count++];
+	w->ypos = ANTIC_ypos;
+	w->xpos = ANTIC_XPOS;
+	w->addr = addr;
+	w->val = val;
+	w->gain = gain;
+	pokey_update(addr, val, chip, gain);
+}
+
+/* Renders the recorded writes as the Mac front end does: 16-bit samples
+   at 44.1 kHz, one buffer per frame. With two POKEYs both get every
+   write, as if a stereo program played the same tune on each. */
+static void RenderPokey(int num_pokeys, const int *frame_end, int frames)
+{
+	double start;
+	double time;
+	long samples = 0;
+	int w = 0;
+	int f;
+	UBYTE chip;
+
+	POKEYSND_Init(POKEYSND_FREQ_17_EXACT, 44100, (UBYTE) num_pokeys, POKEYSND_BIT16);
+#ifdef NEW_CYCLE_EXACT
+	/* so that ANTIC_XPOS is the recorded position */
+	ANTIC_cur_screen_pos = ANTIC_NOT_DRAWING;
+#endif
+	start = BENCH_Now();
+	for (f = 0; f < frames; f++) {
+		for (; w < frame_end[f]; w++) {
+			ANTIC_ypos = pokey_writes[w].ypos;
+			ANTIC_xpos = pokey_writes[w].xpos;
+			for (chip = 0; chip < num_pokeys; chip++)
+				POKEYSND_Update(pokey_writes[w].addr, pokey_writes[w].val, chip, pokey_writes[w].gain);
+		}
+		samples += MZPOKEYSND_UpdateProcessBuffer() / num_pokeys;
+	}
+	time = BENCH_Now() - start;
+	if (time <= 0.0)
+		time = 1e-9;
+	Log_print("%s: %ld samples in %.3f s, %.0f samples/s (%.1fx real time), %.1f us/frame",
+	          num_pokeys > 1 ? "Stereo POKEY" : "Mono POKEY", samples, time,
+	          samples / time, samples / time / 44100, time * 1e6 / frames);
+}
+
+void BENCH_Pokey(void)
+{
+	double fps = Atari800_tv_mode == Atari800_TV_PAL ? Atari800_FPS_PAL : Atari800_FPS_NTSC;
+	int frames = (int) (BENCH_pokey_seconds * fps);
+	int *frame_end = (int *) Util_malloc(frames * sizeof(int));
+	int f;
+
+	Atari800_turbo = TRUE;
+	POKEYSND_enable_new_pokey = TRUE;
+	POKEYSND_Init(POKEYSND_FREQ_17_EXACT, 44100, 1, POKEYSND_BIT16);
+	pokey_update = POKEYSND_Update;
+	POKEYSND_Update = RecordPokeyWrite;
+	for (f = 0; f < frames; f++) {
+		Atari800_Frame();
+		frame_end[f] = pokey_writes_count;
+	}
+	POKEYSND_Update = pokey_update;
+	Log_print("Recorded %d POKEY writes in %d frames", pokey_writes_count, frames);
+
+	RenderPokey(1, frame_end, frames);
+	RenderPokey(2, frame_end, frames);
+	Log_flushlog();
+	free(frame_end);
+	free(pokey_writes);
+	pokey_writes = NULL;
+	pokey_writes_count = pokey_writes_size = 0;
+}
+#else
+void BENCH_Pokey(void)
+{
+	Log_print("-bench-pokey needs the synchronized mzpokeysnd sound");
+}
+#endif /* defined(SOUND) && defined(SYNCHRONIZED_SOUND) */
+
+/*
+vim:ts=4:sw=4:
+*/
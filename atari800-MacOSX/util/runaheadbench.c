@@ -0,0 +1,119 @@
+/*
+ * runaheadbench.c - times the snapshot and restore of run-ahead
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/* Part of atari800-bench, see src/Makefile.bench. Usage:
+     atari800-bench -bench <frames> -bench-runahead <n> [program] */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "antic.h"
+#include "atari.h"
+#include "bench.h"
+#include "devices.h"
+#include "esc.h"
+#include "gtia.h"
+#include "log.h"
+#include "pokey.h"
+#include "statesav.h"
+#ifdef SOUND
+#include "mzpokeysnd.h"
+#endif
+
+int BENCH_runahead_frames = 0;
+
+static UBYTE *runahead_state = NULL;
+static UBYTE *runahead_check = NULL;
+static ULONG runahead_state_capacity = 0;
+static ULONG runahead_check_capacity = 0;
+static double runahead_time[3];		/* save, frames, restore */
+static int runahead_count;
+static int runahead_differed;
+
+void BENCH_RunAheadStart(void)
+{
+	memset(runahead_time, 0, sizeof(runahead_time));
+	runahead_count = runahead_differed = 0;
+}
+
+void BENCH_RunAhead(void)
+{
+	double t0, t1, t2, t3;
+	ULONG size;
+	ULONG random_counter;
+	int i;
+
+	t0 = BENCH_Now();
+	size = StateSav_SaveMem(&runahead_state, &runahead_state_capacity);
+	if (size == 0)
+		return;
+	random_counter = POKEY_GetRandomCounter();
+#if defined(SOUND) && defined(SYNCHRONIZED_SOUND)
+	MZPOKEYSND_SaveSoundState();
+#endif
+	t1 = BENCH_Now();
+	ESC_hold = TRUE;
+	for (i = 1; i <= BENCH_runahead_frames; i++) {
+		Devices_Frame();
+		GTIA_Frame();
+		ANTIC_Frame(i == BENCH_runahead_frames || Atari800_collisions_in_skipped_frames);
+		POKEY_Frame();
+#if defined(SOUND) && defined(SYNCHRONIZED_SOUND)
+		MZPOKEYSND_DiscardProcessBuffer();
+#endif
+	}
+	ESC_hold = FALSE;
+	t2 = BENCH_Now();
+	StateSav_ReadMem(runahead_state, size);
+	POKEY_SetRandomCounter(random_counter);
+#if defined(SOUND) && defined(SYNCHRONIZED_SOUND)
+	MZPOKEYSND_RestoreSoundState();
+#endif
+	t3 = BENCH_Now();
+
+	runahead_time[0] += t1 - t0;
+	runahead_time[1] += t2 - t1;
+	runahead_time[2] += t3 - t2;
+	runahead_count++;
+
+	/* the restored machine must be the one that was saved */
+	if (StateSav_SaveMem(&runahead_check, &runahead_check_capacity) != size
+	 || memcmp(runahead_check, runahead_state, size) != 0)
+		runahead_differed++;
+}
+
+void BENCH_RunAheadReport(void)
+{
+	if (runahead_count > 0)
+		Log_print("  run-ahead: %.1f us/frame: save %.1f us, %d frames %.1f us, restore %.1f us;"
+		          " %d of %d restores differed",
+		          (runahead_time[0] + runahead_time[1] + runahead_time[2]) * 1e6 / runahead_count,
+		          runahead_time[0] * 1e6 / runahead_count, BENCH_runahead_frames,
+		          runahead_time[1] * 1e6 / runahead_count, runahead_time[2] * 1e6 / runahead_count,
+		          runahead_differed, runahead_count);
+}
+
+/*
+vim:ts=4:sw=4:
+*/